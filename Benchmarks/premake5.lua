@@ -0,0 +1,26 @@
+project "Benchmarks"
+    kind "ConsoleApp"
+    language "C++"
+    cppdialect "C++20"
+    targetdir ("../bin/%{prj.name}")
+    objdir ("../obj/%{prj.name}")
+    files {
+        "src/*.h",
+        "src/*.cpp",
+        "../vendors/glad/src/glad.c",
+    }
+    includedirs {
+        "%{IncludeDirs.GLAD}",
+        "%{IncludeDirs.GLM}",
+        "../include",
+    }
+    vpaths {
+        ["Source Files"] = { "**.cpp", "**.c" },
+        ["Header Files"] = "**.h",
+    }
+    filter "configurations:Debug"
+        defines "DEBUG"
+        symbols "On"
+    filter "configurations:Release"
+        defines "NDEBUG"
+        optimize "On"
@@ -0,0 +1,219 @@
+#include <JobSystem.hpp>
+#include <MaskedOcclusionCulling.hpp>
+#include <Primitives.hpp>
+#include <TiledLightCulling.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+constexpr auto NEAR_PLANE = .1f;
+constexpr auto FAR_PLANE = 100.f;
+// Binning runs this many times per case after one warm up run
+constexpr auto ITERATIONS = 50;
+
+struct Resolution {
+    const char* name;
+    int width;
+    int height;
+};
+
+// Lights scattered over a wide area in front of the camera, a tenth of them spot lights
+static void generateLights(size_t count, std::vector<phong::PointLight>& pointLights, std::vector<phong::SpotLight>& spotLights) {
+    // Attenuations with ranges of about 7, 13 and 20 units at the lights' brightness
+    static constexpr float ATTENUATIONS[3][2] = { { .7f, 1.8f }, { .35f, .44f }, { .22f, .2f } };
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> unit(-1.f, 1.f);
+    std::uniform_int_distribution<int> attenuation(0, 2);
+    pointLights.clear();
+    spotLights.clear();
+    for (size_t i = 0; i < count; i++) {
+        glm::vec3 position{ unit(rng) * 100.f, unit(rng) * 10.f, -55.f + unit(rng) * 50.f };
+        const float* a = ATTENUATIONS[attenuation(rng)];
+        if (i % 10 == 9) {
+            phong::SpotLight light{};
+            light.diffuse = light.specular = glm::vec3(.18f);
+            light.position = position;
+            light.direction = glm::normalize(glm::vec3(unit(rng), -1.f, unit(rng)));
+            light.innerCutoff = glm::cos(glm::radians(20.f));
+            light.outerCutoff = glm::cos(glm::radians(30.f));
+            light.linear = a[0];
+            light.quadratic = a[1];
+            spotLights.push_back(light);
+        }
+        else {
+            phong::PointLight light{};
+            light.diffuse = light.specular = glm::vec3(.18f);
+            light.position = position;
+            light.constant = 1.f;
+            light.linear = a[0];
+            light.quadratic = a[1];
+            pointLights.push_back(light);
+        }
+    }
+}
+
+// Average milliseconds of a Bin call
+static double benchmark(TiledLightCulling& culling, const Resolution& resolution, const std::vector<phong::PointLight>& pointLights, const std::vector<phong::SpotLight>& spotLights, JobSystem* jobSystem) {
+    glm::mat4 view = glm::lookAt(glm::vec3(0.f, 5.f, 5.f), glm::vec3(0.f, 0.f, -20.f), glm::vec3(0.f, 1.f, 0.f));
+    glm::mat4 proj = glm::perspective(glm::radians(45.f), (float)resolution.width / resolution.height, NEAR_PLANE, FAR_PLANE);
+    auto bin = [&]() {
+        culling.Bin(view, proj, NEAR_PLANE, FAR_PLANE, resolution.width, resolution.height, pointLights.data(), pointLights.size(), spotLights.data(), spotLights.size(), jobSystem);
+    };
+    bin();
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < ITERATIONS; i++) {
+        bin();
+    }
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / ITERATIONS;
+}
+
+// Samples points inside every light's bounding sphere and checks that the tile each visible one lands in lists the
+// light, the rectangle and sphere tests may keep too many lights but never drop one. Returns the number of misses.
+static size_t checkTiledCulling(int tileSize, const Resolution& resolution, const std::vector<phong::PointLight>& pointLights, const std::vector<phong::SpotLight>& spotLights) {
+    static constexpr int SAMPLES_PER_LIGHT = 64;
+    glm::mat4 view = glm::lookAt(glm::vec3(0.f, 5.f, 5.f), glm::vec3(0.f, 0.f, -20.f), glm::vec3(0.f, 1.f, 0.f));
+    glm::mat4 proj = glm::perspective(glm::radians(45.f), (float)resolution.width / resolution.height, NEAR_PLANE, FAR_PLANE);
+    TiledLightCulling culling(tileSize);
+    culling.Bin(view, proj, NEAR_PLANE, FAR_PLANE, resolution.width, resolution.height, pointLights.data(), pointLights.size(), spotLights.data(), spotLights.size());
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> unit(-1.f, 1.f);
+    size_t misses = 0;
+    for (size_t light = 0; light < pointLights.size() + spotLights.size(); light++) {
+        glm::vec3 center;
+        float radius;
+        if (light < pointLights.size()) {
+            center = pointLights[light].position;
+            radius = pointLights[light].InfluenceRadius();
+        }
+        else {
+            radius = TiledLightCulling::SpotBoundingSphere(spotLights[light - pointLights.size()], center);
+        }
+        for (int i = 0; i < SAMPLES_PER_LIGHT; i++) {
+            glm::vec3 offset{ unit(rng), unit(rng), unit(rng) };
+            if (glm::length(offset) > 1.f) {
+                continue;
+            }
+            // Kept off the sphere's surface, which is where the float rounding of the tests decides
+            glm::vec4 clip = proj * view * glm::vec4(center + offset * radius * .99f, 1.f);
+            if (clip.w <= 0.f || std::abs(clip.x) >= clip.w || std::abs(clip.y) >= clip.w || std::abs(clip.z) >= clip.w) {
+                continue;
+            }
+            int x = (int)((clip.x / clip.w * .5f + .5f) * resolution.width) / tileSize;
+            int y = (int)((clip.y / clip.w * .5f + .5f) * resolution.height) / tileSize;
+            uint32_t count;
+            const uint32_t* lights = culling.GetTileLights(x, y, count);
+            if (std::find(lights, lights + count, (uint32_t)light) == lights + count) {
+                misses++;
+            }
+        }
+    }
+    return misses;
+}
+
+// Rows of walls in front of a grid of boxes, the walls occlude the boxes behind them and each other
+static void benchmarkOcclusion(JobSystem& jobSystem) {
+    static constexpr auto cube = primitives::Cube();
+    static constexpr int WALL_COUNT = 64;
+    static constexpr int BOX_COUNT = 10000;
+    glm::mat4 viewProj = glm::perspective(glm::radians(45.f), 16.f / 9.f, NEAR_PLANE, FAR_PLANE) *
+        glm::lookAt(glm::vec3(0.f, 2.f, 5.f), glm::vec3(0.f, 0.f, -20.f), glm::vec3(0.f, 1.f, 0.f));
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> unit(-1.f, 1.f);
+    std::vector<glm::mat4> walls, boxes;
+    for (int i = 0; i < WALL_COUNT; i++) {
+        glm::mat4 wall = glm::translate(glm::mat4(1.f), glm::vec3(unit(rng) * 15.f, unit(rng) * 2.f, -10.f + unit(rng) * 6.f));
+        walls.push_back(glm::scale(glm::rotate(wall, unit(rng) * .5f, glm::vec3(0.f, 1.f, 0.f)), glm::vec3(4.f, 3.f, .2f)));
+    }
+    for (int i = 0; i < BOX_COUNT; i++) {
+        boxes.push_back(glm::translate(glm::mat4(1.f), glm::vec3(unit(rng) * 40.f, unit(rng) * 5.f, -40.f + unit(rng) * 20.f)));
+    }
+    MaskedOcclusionCulling culling;
+    std::vector<MaskedOcclusionCulling::Result> results(BOX_COUNT);
+    auto run = [&](JobSystem* jobs) {
+        culling.Clear();
+        for (const glm::mat4& wall : walls) {
+            culling.AddOccluder(reinterpret_cast<const float*>(cube.vertices.data()), sizeof(primitives::Vertex) / sizeof(float), cube.indices.data(),
+                cube.INDEX_COUNT, viewProj * wall);
+        }
+        culling.Rasterize(jobs);
+        // Tests only read the buffer, so they split across threads as well
+        auto test = [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                results[i] = culling.TestBox(glm::vec3(-.5f), glm::vec3(.5f), viewProj * boxes[i]);
+            }
+        };
+        if (jobs != nullptr) {
+            jobs->ParallelFor(BOX_COUNT, 0, test);
+        }
+        else {
+            test(0, BOX_COUNT);
+        }
+    };
+    auto time = [&](JobSystem* jobs) {
+        run(jobs);
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < ITERATIONS; i++) {
+            run(jobs);
+        }
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        return elapsed.count() / ITERATIONS;
+    };
+    double single = time(nullptr);
+    double parallel = time(&jobSystem);
+    size_t counts[3] = {};
+    for (MaskedOcclusionCulling::Result result : results) {
+        counts[result]++;
+    }
+    printf("\nMasked occlusion culling, %d walls and %d boxes at %dx%d, average of %d runs (%s)\n", WALL_COUNT, BOX_COUNT,
+        culling.GetTilesX() * MaskedOcclusionCulling::TILE_WIDTH, culling.GetTilesY() * MaskedOcclusionCulling::TILE_HEIGHT, ITERATIONS,
+#if defined(MASKED_OCCLUSION_CULLING_AVX2)
+        "avx2");
+#elif defined(MASKED_OCCLUSION_CULLING_SSE)
+        "sse");
+#else
+        "scalar");
+#endif
+    printf("%12s %12s %10s %10s %10s\n", "1 thread ms", "jobs ms", "visible", "occluded", "outside");
+    printf("%12.3f %12.3f %10zu %10zu %10zu\n", single, parallel, counts[MaskedOcclusionCulling::VISIBLE], counts[MaskedOcclusionCulling::OCCLUDED],
+        counts[MaskedOcclusionCulling::VIEW_CULLED]);
+}
+
+int main() {
+    static constexpr Resolution RESOLUTIONS[2] = { { "1080p", 1920, 1080 }, { "4K", 3840, 2160 } };
+    static constexpr size_t LIGHT_COUNTS[2] = { 1000, 10000 };
+    static constexpr int TILE_SIZES[2] = { 16, 32 };
+    JobSystem jobSystem;
+    std::vector<phong::PointLight> pointLights;
+    std::vector<phong::SpotLight> spotLights;
+    size_t misses = 0;
+    for (size_t lightCount : LIGHT_COUNTS) {
+        generateLights(lightCount, pointLights, spotLights);
+        for (int tileSize : TILE_SIZES) {
+            misses += checkTiledCulling(tileSize, RESOLUTIONS[0], pointLights, spotLights);
+        }
+    }
+    printf("Tiled light binning check: %zu samples in tiles missing their light\n", misses);
+    printf("Tiled light binning, average of %d runs (%zu threads)\n", ITERATIONS, jobSystem.GetThreadCount());
+    printf("%-8s %-7s %-5s %12s %12s %12s\n", "lights", "screen", "tile", "1 thread ms", "jobs ms", "lights/tile");
+    for (size_t lightCount : LIGHT_COUNTS) {
+        generateLights(lightCount, pointLights, spotLights);
+        for (const Resolution& resolution : RESOLUTIONS) {
+            for (int tileSize : TILE_SIZES) {
+                TiledLightCulling culling(tileSize);
+                double single = benchmark(culling, resolution, pointLights, spotLights, nullptr);
+                double parallel = benchmark(culling, resolution, pointLights, spotLights, &jobSystem);
+                double perTile = (double)culling.GetIndexCount() / ((size_t)culling.GetTilesX() * culling.GetTilesY());
+                printf("%-8zu %-7s %-5d %12.3f %12.3f %12.1f\n", lightCount, resolution.name, tileSize, single, parallel, perTile);
+            }
+        }
+    }
+    benchmarkOcclusion(jobSystem);
+    return misses == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
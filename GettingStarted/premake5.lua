@@ -17,6 +17,7 @@ project "GettingStarted"
 		"%{IncludeDirs.GLAD}",
 		"%{IncludeDirs.STB}",
 		"%{IncludeDirs.GLM}",
+		"../include",
 	}
 	vpaths {
 		["Source Files"] = { "**.cpp", "**.c" },
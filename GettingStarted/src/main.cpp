@@ -5,7 +5,9 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <Primitives.hpp>
 
+#include <cstddef>
 #include <cstdlib>
 #include <cstdio>
 #include <fstream>
@@ -157,6 +159,16 @@ static void processInputs(GLFWwindow* window) {
 	}
 }
 
+// The vertex of the rectangle: position, texture coordinates and a color in place of the normal
+struct ColoredVertex {
+	float position[3]{};
+	float texCoord[2]{};
+	float color[3]{ 1.0f, 1.0f, 1.0f };
+	constexpr ColoredVertex() = default;
+	constexpr ColoredVertex(const primitives::Vertex& vertex)
+		: position{ vertex.position[0], vertex.position[1], vertex.position[2] }, texCoord{ vertex.texCoord[0], vertex.texCoord[1] } {}
+};
+
 int main(int argc, char** argv) {
 	// Initialize glfw library
 	glfwInit();
@@ -179,19 +191,23 @@ int main(int argc, char** argv) {
 		exit(EXIT_FAILURE);
 	}
 
-	// Specifying the vertices for the rectangle
-	float vertices[] = {
-		-.5f, 0.5f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f, 0.0f,
-		-.5f, -.5f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f,
-		0.5f, -.5f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f,
-		0.5f, 0.5f, 0.0f, 1.0f, 1.0f, 1.0f, 0.0f, 0.0f,
-	};
-
-	// Specifying the order of vertices of the rectangle
-	unsigned int indices[] = {
-		0, 1, 2,
-		2, 3, 0,
-	};
+	// Generating the rectangle at compile time, each corner gets its own color
+	static constexpr auto rectangle = [] {
+		auto plane = primitives::Plane<1, ColoredVertex>();
+		// In the plane's vertex order: bottom left, bottom right, top left, top right
+		constexpr float colors[4][3] = {
+			{ 0.0f, 1.0f, 0.0f },
+			{ 0.0f, 0.0f, 1.0f },
+			{ 1.0f, 1.0f, 0.0f },
+			{ 1.0f, 0.0f, 0.0f },
+		};
+		for (size_t i = 0; i < plane.VERTEX_COUNT; i++) {
+			for (size_t j = 0; j < 3; j++) {
+				plane.vertices[i].color[j] = colors[i][j];
+			}
+		}
+		return plane;
+	}();
 
 	// Transfering the rectangle data to the gpu
 	GLuint vao, vbo, ebo;
@@ -201,20 +217,20 @@ int main(int argc, char** argv) {
 	// Transfering the vertex data
 	glGenBuffers(1, &vbo);
 	glBindBuffer(GL_ARRAY_BUFFER, vbo);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(rectangle.vertices), rectangle.vertices.data(), GL_STATIC_DRAW);
 
 	// Specifying the layout of the vertices
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(float) * 8, 0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(ColoredVertex), (void*)offsetof(ColoredVertex, position));
 	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(float) * 8, (void*)(sizeof(float) * 3));
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(ColoredVertex), (void*)offsetof(ColoredVertex, texCoord));
 	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(float) * 8, (void*)(sizeof(float) * 5));
+	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(ColoredVertex), (void*)offsetof(ColoredVertex, color));
 	glEnableVertexAttribArray(2);
 
 	// Transfering the indices data
 	glGenBuffers(1, &ebo);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(rectangle.indices), rectangle.indices.data(), GL_STATIC_DRAW);
 
 	// Scoped so destructor is automatically called
 	{
@@ -253,7 +269,7 @@ int main(int argc, char** argv) {
 			// Binding the rectangle object
 			glBindVertexArray(vao);
 			// Drawing the rectangle using the currently active shader
-			glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, nullptr);
+			glDrawElements(GL_TRIANGLES, rectangle.INDEX_COUNT, GL_UNSIGNED_INT, nullptr);
 			// Swapping the buffer beeing rendered
 			glfwSwapBuffers(window);
 		}
@@ -0,0 +1,11 @@
+#version 330 core
+layout (location = 0) out float oLuminance;
+uniform sampler2D uAverageLogLuminance;
+uniform sampler2D uPreviousLuminance;
+// Fraction of the way to the scene's luminance covered this frame
+uniform float uAdaptation;
+void main() {
+    float average = exp(texelFetch(uAverageLogLuminance, ivec2(0), 0).r);
+    float previous = texelFetch(uPreviousLuminance, ivec2(0), 0).r;
+    oLuminance = mix(previous, average, uAdaptation);
+}
@@ -0,0 +1,132 @@
+#version 330 core
+layout (location = 0) out vec4 oFragColor;
+in vec3 Position;
+in vec2 TexCoord;
+in vec3 Normal;
+uniform struct Material {
+    sampler2D diffuse;
+    sampler2D specular;
+    float shininess;
+} uMaterial;
+uniform struct DirectionalLight {
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+    vec3 direction;
+} uDirectionalLight;
+uniform struct FlashLight {
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+    vec3 position;
+    vec3 direction;
+    float innerCutoff;
+    float outerCutoff;
+    // Attenuation
+    float constant;
+    float linear;
+    float quadratic;
+} uFlashLight;
+uniform vec3 uCamPos;
+uniform mat4 uView;
+// Light clusters (see LightClusters.hpp)
+uniform usamplerBuffer uClusterGrid;
+uniform usamplerBuffer uClusterLightIndices;
+uniform samplerBuffer uClusterLights;
+uniform ivec3 uClusterDims;
+uniform vec2 uClusterTileSize;
+uniform float uClusterDepthScale;
+uniform float uClusterDepthBias;
+// Cascaded shadow maps (see CascadedShadowMaps.hpp)
+uniform sampler2DArrayShadow uShadowMap;
+uniform mat4 uShadowMatrices[4];
+uniform vec4 uCascadeSplits;
+uniform int uCascadeCount;
+// Fraction of the directional light reaching a point, 1 beyond the last cascade
+float CalculateShadow(in vec3 position, in vec3 normal, in float viewDepth) {
+    int cascade = 0;
+    while (cascade < uCascadeCount && viewDepth > uCascadeSplits[cascade]) {
+        cascade++;
+    }
+    if (cascade == uCascadeCount) {
+        return 1.;
+    }
+    // Looking up a little off the surface against self shadowing acne
+    vec4 coord = uShadowMatrices[cascade] * vec4(position + normal * .02, 1.);
+    return texture(uShadowMap, vec4(coord.xy, float(cascade), coord.z));
+}
+vec3 CalculateDirectionalLight(in vec3 diffuseFragColor, in vec3 specularFragColor) {
+    vec3 ambient = uDirectionalLight.ambient * diffuseFragColor;
+    // Diffuse light calculation
+    vec3 lightDir = normalize(-uDirectionalLight.direction);
+    float diff = max(dot(Normal, lightDir), 0.);
+    vec3 diffuse = diff * uDirectionalLight.diffuse * diffuseFragColor;
+    // Specular reflection calculation
+    vec3 camDir = normalize(uCamPos - Position);
+    vec3 reflectDir = reflect(-lightDir, Normal);
+    float spec = pow(max(dot(camDir, reflectDir), 0.), uMaterial.shininess);
+    vec3 specular = spec * uDirectionalLight.specular * specularFragColor;
+    float shadow = CalculateShadow(Position, Normal, -(uView * vec4(Position, 1.)).z);
+    return ambient + shadow * (diffuse + specular);
+}
+vec3 CalculatePointLight(in int index, in vec3 diffuseFragColor, in vec3 specularFragColor) {
+    // Each light takes up 4 texels: (position, radius) (ambient, constant) (diffuse, linear) (specular, quadratic)
+    vec4 positionRadius = texelFetch(uClusterLights, index * 4);
+    vec4 ambientConstant = texelFetch(uClusterLights, index * 4 + 1);
+    vec4 diffuseLinear = texelFetch(uClusterLights, index * 4 + 2);
+    vec4 specularQuadratic = texelFetch(uClusterLights, index * 4 + 3);
+    float dist = distance(positionRadius.xyz, Position);
+    float attenuation = ambientConstant.w + (diffuseLinear.w * dist) + (specularQuadratic.w * (dist * dist));
+    attenuation = 1. / attenuation;
+
+    vec3 ambient = ambientConstant.rgb * diffuseFragColor;
+
+    vec3 lightDir = normalize(positionRadius.xyz - Position);
+    float diff = max(dot(Normal, lightDir), 0.);
+    vec3 diffuse = diff * diffuseLinear.rgb * diffuseFragColor;
+
+    vec3 camDir = normalize(uCamPos - Position);
+    vec3 reflectDir = reflect(-lightDir, Normal);
+    float spec = pow(max(dot(camDir, reflectDir), 0.), uMaterial.shininess);
+    vec3 specular = spec * specularQuadratic.rgb * specularFragColor;
+    return attenuation * (ambient + diffuse + specular);
+}
+vec3 CalculateSpotLight(in vec3 diffuseFragColor, in vec3 specularFragColor) {
+    vec3 lightDir = normalize(uFlashLight.position - Position);
+    float theta = dot(lightDir, normalize(-uFlashLight.direction));
+    vec3 ambient = uFlashLight.ambient * diffuseFragColor;
+    if (theta > uFlashLight.outerCutoff) {
+        float dist = length(uFlashLight.position - Position);
+        float attenuation = uFlashLight.constant + (uFlashLight.linear * dist) + (uFlashLight.quadratic * (dist * dist));
+        attenuation = 1. / attenuation;
+        float epsilon = uFlashLight.innerCutoff - uFlashLight.outerCutoff;
+        float intensity = clamp((theta - uFlashLight.outerCutoff) / epsilon, 0., 1.);
+
+        float diff = max(dot(Normal, lightDir), 0.);
+        vec3 diffuse = intensity * diff * uFlashLight.diffuse * diffuseFragColor;
+
+        vec3 camDir = normalize(uCamPos - Position);
+        vec3 reflectDir = reflect(-lightDir, Normal);
+        float spec = pow(max(dot(camDir, reflectDir), 0.), uMaterial.shininess);
+        vec3 specular = intensity * spec * uFlashLight.specular * specularFragColor;
+        return ambient + attenuation * (diffuse + specular);
+    }
+    return ambient;
+}
+void main() {
+    vec3 diffuseFragColor = texture2D(uMaterial.diffuse, TexCoord).rgb;
+    vec3 specularFragColor = texture2D(uMaterial.specular, TexCoord).rgb;
+    // Summation lights in the scene
+    vec3 color = CalculateDirectionalLight(diffuseFragColor, specularFragColor);
+    // Only the lights of the fragment's cluster are evaluated
+    float depth = -(uView * vec4(Position, 1.)).z;
+    ivec3 cluster = ivec3(ivec2(gl_FragCoord.xy / uClusterTileSize), int(log(depth) * uClusterDepthScale - uClusterDepthBias));
+    cluster = clamp(cluster, ivec3(0), uClusterDims - 1);
+    uvec2 lights = texelFetch(uClusterGrid, (cluster.z * uClusterDims.y + cluster.y) * uClusterDims.x + cluster.x).xy;
+    for (uint i = 0u; i < lights.y; i++) {
+        int index = int(texelFetch(uClusterLightIndices, int(lights.x + i)).x);
+        color += CalculatePointLight(index, diffuseFragColor, specularFragColor);
+    }
+    color += CalculateSpotLight(diffuseFragColor, specularFragColor);
+    oFragColor = vec4(color, 1.);
+}
@@ -0,0 +1,71 @@
+#version 330 core
+layout (location = 0) out vec4 oFragColor;
+uniform sampler2D uGAlbedoSpecular;
+uniform sampler2D uGNormalShininess;
+uniform sampler2D uGDepth;
+uniform vec2 uScreenSize;
+uniform mat4 uInvViewProj;
+uniform struct DirectionalLight {
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+    vec3 direction;
+} uDirectionalLight;
+// Ambient term of the flash light, it does not depend on the light's volume
+uniform vec3 uFlashLightAmbient;
+uniform vec3 uCamPos;
+uniform mat4 uView;
+// Cascaded shadow maps (see CascadedShadowMaps.hpp)
+uniform sampler2DArrayShadow uShadowMap;
+uniform mat4 uShadowMatrices[4];
+uniform vec4 uCascadeSplits;
+uniform int uCascadeCount;
+vec2 SignNotZero(in vec2 v) {
+    return vec2(v.x >= 0. ? 1. : -1., v.y >= 0. ? 1. : -1.);
+}
+vec3 OctahedralDecode(in vec2 e) {
+    e = e * 2. - 1.;
+    vec3 n = vec3(e, 1. - abs(e.x) - abs(e.y));
+    if (n.z < 0.) {
+        n.xy = (1. - abs(n.yx)) * SignNotZero(n.xy);
+    }
+    return normalize(n);
+}
+// Fraction of the directional light reaching a point, 1 beyond the last cascade
+float CalculateShadow(in vec3 position, in vec3 normal, in float viewDepth) {
+    int cascade = 0;
+    while (cascade < uCascadeCount && viewDepth > uCascadeSplits[cascade]) {
+        cascade++;
+    }
+    if (cascade == uCascadeCount) {
+        return 1.;
+    }
+    // Looking up a little off the surface against self shadowing acne
+    vec4 coord = uShadowMatrices[cascade] * vec4(position + normal * .02, 1.);
+    return texture(uShadowMap, vec4(coord.xy, float(cascade), coord.z));
+}
+void main() {
+    vec2 uv = gl_FragCoord.xy / uScreenSize;
+    float depth = texture(uGDepth, uv).r;
+    // Nothing was drawn here
+    if (depth == 1.) {
+        discard;
+    }
+    vec4 position = uInvViewProj * vec4(vec3(uv, depth) * 2. - 1., 1.);
+    position /= position.w;
+    vec4 albedoSpecular = texture(uGAlbedoSpecular, uv);
+    vec4 normalShininess = texture(uGNormalShininess, uv);
+    vec3 normal = OctahedralDecode(normalShininess.rg);
+    float shininess = exp2(normalShininess.b * 11.);
+
+    vec3 ambient = (uDirectionalLight.ambient + uFlashLightAmbient) * albedoSpecular.rgb;
+    vec3 lightDir = normalize(-uDirectionalLight.direction);
+    float diff = max(dot(normal, lightDir), 0.);
+    vec3 diffuse = diff * uDirectionalLight.diffuse * albedoSpecular.rgb;
+    vec3 camDir = normalize(uCamPos - position.xyz);
+    vec3 reflectDir = reflect(-lightDir, normal);
+    float spec = pow(max(dot(camDir, reflectDir), 0.), shininess);
+    vec3 specular = spec * uDirectionalLight.specular * albedoSpecular.a;
+    float shadow = CalculateShadow(position.xyz, normal, -(uView * position).z);
+    oFragColor = vec4(ambient + shadow * (diffuse + specular), 1.);
+}
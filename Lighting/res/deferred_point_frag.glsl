@@ -0,0 +1,93 @@
+#version 330 core
+layout (location = 0) out vec4 oFragColor;
+flat in vec4 LightPositionRadius;
+flat in vec4 LightAmbientConstant;
+flat in vec4 LightDiffuseLinear;
+flat in vec4 LightSpecularQuadratic;
+flat in float LightShadowSlot;
+uniform sampler2D uGAlbedoSpecular;
+uniform sampler2D uGNormalShininess;
+uniform sampler2D uGDepth;
+uniform vec2 uScreenSize;
+uniform mat4 uInvViewProj;
+uniform vec3 uCamPos;
+// Cube shadow maps (see PointShadowAtlas.hpp)
+uniform sampler2DArrayShadow uPointShadowMap;
+uniform float uPointShadowResolution;
+vec2 SignNotZero(in vec2 v) {
+    return vec2(v.x >= 0. ? 1. : -1., v.y >= 0. ? 1. : -1.);
+}
+vec3 OctahedralDecode(in vec2 e) {
+    e = e * 2. - 1.;
+    vec3 n = vec3(e, 1. - abs(e.x) - abs(e.y));
+    if (n.z < 0.) {
+        n.xy = (1. - abs(n.yx)) * SignNotZero(n.xy);
+    }
+    return normalize(n);
+}
+// Fraction of the light reaching a point, looked up in the cube face of the light's slot that the point falls in,
+// bias is in world units
+float CalculatePointShadow(in vec3 toPoint, in float bias) {
+    if (LightShadowSlot < 0.) {
+        return 1.;
+    }
+    // Face selection and coordinates follow the cube map conventions
+    vec3 a = abs(toPoint);
+    float face;
+    float ma;
+    vec2 st;
+    if (a.x >= a.y && a.x >= a.z) {
+        ma = a.x;
+        face = toPoint.x > 0. ? 0. : 1.;
+        st = vec2(toPoint.x > 0. ? -toPoint.z : toPoint.z, -toPoint.y);
+    }
+    else if (a.y >= a.z) {
+        ma = a.y;
+        face = toPoint.y > 0. ? 2. : 3.;
+        st = vec2(toPoint.x, toPoint.y > 0. ? toPoint.z : -toPoint.z);
+    }
+    else {
+        ma = a.z;
+        face = toPoint.z > 0. ? 4. : 5.;
+        st = vec2(toPoint.z > 0. ? toPoint.x : -toPoint.x, -toPoint.y);
+    }
+    vec2 uv = st / ma * .5 + .5;
+    return texture(uPointShadowMap, vec4(uv, LightShadowSlot * 6. + face, (length(toPoint) - bias) / LightPositionRadius.w));
+}
+void main() {
+    vec2 uv = gl_FragCoord.xy / uScreenSize;
+    float depth = texture(uGDepth, uv).r;
+    // The back faces of the volume are drawn, the scene has to be in front of them to be inside
+    if (gl_FragCoord.z < depth) {
+        discard;
+    }
+    vec4 position = uInvViewProj * vec4(vec3(uv, depth) * 2. - 1., 1.);
+    position /= position.w;
+    float dist = distance(LightPositionRadius.xyz, position.xyz);
+    // The volume is a box around the sphere, the corners are outside of the light's reach
+    if (depth == 1. || dist > LightPositionRadius.w) {
+        discard;
+    }
+    vec4 albedoSpecular = texture(uGAlbedoSpecular, uv);
+    vec4 normalShininess = texture(uGNormalShininess, uv);
+    vec3 normal = OctahedralDecode(normalShininess.rg);
+    float shininess = exp2(normalShininess.b * 11.);
+
+    float attenuation = LightAmbientConstant.w + (LightDiffuseLinear.w * dist) + (LightSpecularQuadratic.w * (dist * dist));
+    attenuation = 1. / attenuation;
+    vec3 ambient = LightAmbientConstant.rgb * albedoSpecular.rgb;
+    vec3 lightDir = normalize(LightPositionRadius.xyz - position.xyz);
+    float diff = max(dot(normal, lightDir), 0.);
+    vec3 diffuse = diff * LightDiffuseLinear.rgb * albedoSpecular.rgb;
+    vec3 camDir = normalize(uCamPos - position.xyz);
+    vec3 reflectDir = reflect(-lightDir, normal);
+    float spec = pow(max(dot(camDir, reflectDir), 0.), shininess);
+    vec3 specular = spec * LightSpecularQuadratic.rgb * albedoSpecular.a;
+    // Looking up a little off the surface against self shadowing acne, the bias covers the depth a shadow map texel
+    // spans on the surface, which grows with the distance to the light and the slope of the surface
+    float texelSize = 2. * dist / uPointShadowResolution;
+    float cosTheta = max(dot(normal, lightDir), .05);
+    float slope = min(sqrt(1. - cosTheta * cosTheta) / cosTheta, 4.);
+    float shadow = CalculatePointShadow(position.xyz + normal * .02 - LightPositionRadius.xyz, texelSize * (.5 + slope));
+    oFragColor = vec4(attenuation * (ambient + shadow * (diffuse + specular)), 1.);
+}
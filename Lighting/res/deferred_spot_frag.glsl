@@ -0,0 +1,66 @@
+#version 330 core
+layout (location = 0) out vec4 oFragColor;
+flat in vec4 LightPositionRadius;
+uniform sampler2D uGAlbedoSpecular;
+uniform sampler2D uGNormalShininess;
+uniform sampler2D uGDepth;
+uniform vec2 uScreenSize;
+uniform mat4 uInvViewProj;
+uniform struct FlashLight {
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+    vec3 position;
+    vec3 direction;
+    float innerCutoff;
+    float outerCutoff;
+    // Attenuation
+    float constant;
+    float linear;
+    float quadratic;
+} uFlashLight;
+uniform vec3 uCamPos;
+vec2 SignNotZero(in vec2 v) {
+    return vec2(v.x >= 0. ? 1. : -1., v.y >= 0. ? 1. : -1.);
+}
+vec3 OctahedralDecode(in vec2 e) {
+    e = e * 2. - 1.;
+    vec3 n = vec3(e, 1. - abs(e.x) - abs(e.y));
+    if (n.z < 0.) {
+        n.xy = (1. - abs(n.yx)) * SignNotZero(n.xy);
+    }
+    return normalize(n);
+}
+void main() {
+    vec2 uv = gl_FragCoord.xy / uScreenSize;
+    float depth = texture(uGDepth, uv).r;
+    // The back faces of the volume are drawn, the scene has to be in front of them to be inside
+    if (depth == 1. || gl_FragCoord.z < depth) {
+        discard;
+    }
+    vec4 position = uInvViewProj * vec4(vec3(uv, depth) * 2. - 1., 1.);
+    position /= position.w;
+    vec4 albedoSpecular = texture(uGAlbedoSpecular, uv);
+    vec3 lightDir = normalize(uFlashLight.position - position.xyz);
+    float theta = dot(lightDir, normalize(-uFlashLight.direction));
+    float dist = length(uFlashLight.position - position.xyz);
+    // The ambient term reaches everything, the directional pass adds it
+    if (theta <= uFlashLight.outerCutoff || dist > LightPositionRadius.w) {
+        discard;
+    }
+    vec4 normalShininess = texture(uGNormalShininess, uv);
+    vec3 normal = OctahedralDecode(normalShininess.rg);
+    float shininess = exp2(normalShininess.b * 11.);
+
+    float attenuation = uFlashLight.constant + (uFlashLight.linear * dist) + (uFlashLight.quadratic * (dist * dist));
+    attenuation = 1. / attenuation;
+    float epsilon = uFlashLight.innerCutoff - uFlashLight.outerCutoff;
+    float intensity = clamp((theta - uFlashLight.outerCutoff) / epsilon, 0., 1.);
+    float diff = max(dot(normal, lightDir), 0.);
+    vec3 diffuse = intensity * diff * uFlashLight.diffuse * albedoSpecular.rgb;
+    vec3 camDir = normalize(uCamPos - position.xyz);
+    vec3 reflectDir = reflect(-lightDir, normal);
+    float spec = pow(max(dot(camDir, reflectDir), 0.), shininess);
+    vec3 specular = intensity * spec * uFlashLight.specular * albedoSpecular.a;
+    oFragColor = vec4(attenuation * (diffuse + specular), 1.);
+}
@@ -0,0 +1,8 @@
+#version 330 core
+layout (location = 0) in vec3 aPosition;
+// Per instance model matrix (takes up locations 3 to 6)
+layout (location = 3) in mat4 aModel;
+uniform mat4 uLightViewProj;
+void main() {
+    gl_Position = uLightViewProj * aModel * vec4(aPosition, 1.);
+}
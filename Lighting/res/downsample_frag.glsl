@@ -0,0 +1,8 @@
+#version 330 core
+layout (location = 0) out float oValue;
+// Twice the target size, sampling between 2x2 texels with bilinear filtering averages them
+uniform sampler2D uSource;
+uniform vec2 uTargetSize;
+void main() {
+    oValue = texture(uSource, gl_FragCoord.xy / uTargetSize).r;
+}
@@ -0,0 +1,6 @@
+#version 330 core
+// Draws a triangle covering the screen from 3 vertices without any vertex data
+void main() {
+    vec2 position = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    gl_Position = vec4(position * 2. - 1., 0., 1.);
+}
@@ -0,0 +1,28 @@
+#version 330 core
+// Albedo in rgb, specular intensity in a
+layout (location = 0) out vec4 oAlbedoSpecular;
+// Octahedral encoded normal in rg, log2(shininess) / 11 in b
+layout (location = 1) out vec4 oNormalShininess;
+in vec3 Position;
+in vec2 TexCoord;
+in vec3 Normal;
+uniform struct Material {
+    sampler2D diffuse;
+    sampler2D specular;
+    float shininess;
+} uMaterial;
+vec2 SignNotZero(in vec2 v) {
+    return vec2(v.x >= 0. ? 1. : -1., v.y >= 0. ? 1. : -1.);
+}
+// Maps the unit sphere to the unit square by folding an octahedron
+vec2 OctahedralEncode(in vec3 n) {
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 e = n.z >= 0. ? n.xy : (1. - abs(n.yx)) * SignNotZero(n.xy);
+    return e * .5 + .5;
+}
+void main() {
+    vec3 diffuseFragColor = texture(uMaterial.diffuse, TexCoord).rgb;
+    vec3 specularFragColor = texture(uMaterial.specular, TexCoord).rgb;
+    oAlbedoSpecular = vec4(diffuseFragColor, dot(specularFragColor, vec3(.2126, .7152, .0722)));
+    oNormalShininess = vec4(OctahedralEncode(normalize(Normal)), log2(uMaterial.shininess) / 11., 0.);
+}
@@ -0,0 +1,30 @@
+#version 330 core
+layout (location = 0) in vec3 aPosition;
+layout (location = 1) in vec2 aTexCoord;
+// Octahedral encoded normal in [-1, 1]^2
+layout (location = 2) in vec2 aNormal;
+// Per instance model matrix (takes up locations 3 to 6)
+layout (location = 3) in mat4 aModel;
+out vec3 Position;
+out vec2 TexCoord;
+out vec3 Normal;
+uniform mat4 uProj;
+uniform mat4 uView;
+// Matches the depth pre-pass (see prepass_vert.glsl)
+invariant gl_Position;
+vec2 SignNotZero(in vec2 v) {
+    return vec2(v.x >= 0. ? 1. : -1., v.y >= 0. ? 1. : -1.);
+}
+vec3 OctahedralDecode(in vec2 e) {
+    vec3 n = vec3(e, 1. - abs(e.x) - abs(e.y));
+    if (n.z < 0.) {
+        n.xy = (1. - abs(n.yx)) * SignNotZero(n.xy);
+    }
+    return normalize(n);
+}
+void main() {
+    Position = vec3(aModel * vec4(aPosition, 1.));
+    TexCoord = aTexCoord;
+    Normal = normalize(mat3(transpose(inverse(aModel))) * OctahedralDecode(aNormal));
+    gl_Position = uProj * uView * vec4(Position, 1.);
+}
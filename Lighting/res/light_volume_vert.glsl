@@ -0,0 +1,27 @@
+#version 330 core
+// Unit cube
+layout (location = 0) in vec3 aPosition;
+// Per instance light: (position, radius) (ambient, constant) (diffuse, linear) (specular, quadratic)
+layout (location = 3) in vec4 aPositionRadius;
+layout (location = 4) in vec4 aAmbientConstant;
+layout (location = 5) in vec4 aDiffuseLinear;
+layout (location = 6) in vec4 aSpecularQuadratic;
+// Slot of the light's shadows in the point shadow atlas, negative without shadows
+layout (location = 7) in float aShadowSlot;
+flat out vec4 LightPositionRadius;
+flat out vec4 LightAmbientConstant;
+flat out vec4 LightDiffuseLinear;
+flat out vec4 LightSpecularQuadratic;
+flat out float LightShadowSlot;
+uniform mat4 uProj;
+uniform mat4 uView;
+void main() {
+    LightPositionRadius = aPositionRadius;
+    LightAmbientConstant = aAmbientConstant;
+    LightDiffuseLinear = aDiffuseLinear;
+    LightSpecularQuadratic = aSpecularQuadratic;
+    LightShadowSlot = aShadowSlot;
+    // The cube is scaled to enclose the light's sphere of influence
+    vec3 position = aPositionRadius.xyz + aPosition * 2. * aPositionRadius.w;
+    gl_Position = uProj * uView * vec4(position, 1.);
+}
@@ -0,0 +1,59 @@
+#version 330 core
+layout (location = 0) out vec4 oFragColor;
+in vec3 Position;
+in vec2 TexCoord;
+in vec3 Normal;
+in vec2 LightmapCoord;
+uniform struct Material {
+    sampler2D diffuse;
+    sampler2D specular;
+    float shininess;
+} uMaterial;
+uniform struct FlashLight {
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+    vec3 position;
+    vec3 direction;
+    float innerCutoff;
+    float outerCutoff;
+    // Attenuation
+    float constant;
+    float linear;
+    float quadratic;
+} uFlashLight;
+uniform vec3 uCamPos;
+// The diffuse lighting of the static lights (see LightmapBaker.hpp)
+uniform sampler2D uLightmap;
+uniform float uLightmapScale;
+// The flash light moves with the camera so it is still evaluated per fragment
+vec3 CalculateSpotLight(in vec3 normal, in vec3 diffuseFragColor, in vec3 specularFragColor) {
+    vec3 lightDir = normalize(uFlashLight.position - Position);
+    float theta = dot(lightDir, normalize(-uFlashLight.direction));
+    vec3 ambient = uFlashLight.ambient * diffuseFragColor;
+    if (theta > uFlashLight.outerCutoff) {
+        float dist = length(uFlashLight.position - Position);
+        float attenuation = uFlashLight.constant + (uFlashLight.linear * dist) + (uFlashLight.quadratic * (dist * dist));
+        attenuation = 1. / attenuation;
+        float epsilon = uFlashLight.innerCutoff - uFlashLight.outerCutoff;
+        float intensity = clamp((theta - uFlashLight.outerCutoff) / epsilon, 0., 1.);
+
+        float diff = max(dot(normal, lightDir), 0.);
+        vec3 diffuse = intensity * diff * uFlashLight.diffuse * diffuseFragColor;
+
+        vec3 camDir = normalize(uCamPos - Position);
+        vec3 reflectDir = reflect(-lightDir, normal);
+        float spec = pow(max(dot(camDir, reflectDir), 0.), uMaterial.shininess);
+        vec3 specular = intensity * spec * uFlashLight.specular * specularFragColor;
+        return ambient + attenuation * (diffuse + specular);
+    }
+    return ambient;
+}
+void main() {
+    vec3 normal = normalize(Normal);
+    vec3 diffuseFragColor = texture(uMaterial.diffuse, TexCoord).rgb;
+    vec3 specularFragColor = texture(uMaterial.specular, TexCoord).rgb;
+    vec3 color = texture(uLightmap, LightmapCoord).rgb * uLightmapScale * diffuseFragColor;
+    color += CalculateSpotLight(normal, diffuseFragColor, specularFragColor);
+    oFragColor = vec4(color, 1.);
+}
@@ -0,0 +1,19 @@
+#version 330 core
+layout (location = 0) in vec3 aPosition;
+layout (location = 1) in vec2 aTexCoord;
+layout (location = 2) in vec3 aNormal;
+layout (location = 3) in vec2 aLightmapCoord;
+out vec3 Position;
+out vec2 TexCoord;
+out vec3 Normal;
+out vec2 LightmapCoord;
+uniform mat4 uProj;
+uniform mat4 uView;
+void main() {
+    // The baked geometry is already in world space
+    Position = aPosition;
+    TexCoord = aTexCoord;
+    Normal = aNormal;
+    LightmapCoord = aLightmapCoord;
+    gl_Position = uProj * uView * vec4(Position, 1.);
+}
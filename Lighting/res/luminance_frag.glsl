@@ -0,0 +1,16 @@
+#version 330 core
+layout (location = 0) out float oLogLuminance;
+uniform sampler2D uScene;
+uniform vec2 uTargetSize;
+float LogLuminance(in vec2 uv) {
+    vec3 color = texture(uScene, uv).rgb;
+    return log(max(dot(color, vec3(.2126, .7152, .0722)), 1e-4));
+}
+void main() {
+    // A texel covers a few scene texels, 4 taps spread over its quarters sample them
+    vec2 uv = gl_FragCoord.xy / uTargetSize;
+    vec2 offset = .25 / uTargetSize;
+    float sum = LogLuminance(uv + vec2(-offset.x, -offset.y)) + LogLuminance(uv + vec2(offset.x, -offset.y))
+        + LogLuminance(uv + vec2(-offset.x, offset.y)) + LogLuminance(uv + vec2(offset.x, offset.y));
+    oLogLuminance = sum * .25;
+}
@@ -0,0 +1,30 @@
+#version 330 core
+// Positions quantized to the mesh's bounds (see StaticMesh.hpp)
+layout (location = 0) in vec3 aPosition;
+layout (location = 1) in vec2 aTexCoord;
+// Octahedral encoded normal in [-1, 1]^2
+layout (location = 2) in vec2 aNormal;
+out vec3 Position;
+out vec2 TexCoord;
+out vec3 Normal;
+uniform mat4 uProj;
+uniform mat4 uView;
+uniform mat4 uModel;
+uniform vec3 uPositionScale;
+uniform vec3 uPositionOffset;
+vec2 SignNotZero(in vec2 v) {
+    return vec2(v.x >= 0. ? 1. : -1., v.y >= 0. ? 1. : -1.);
+}
+vec3 OctahedralDecode(in vec2 e) {
+    vec3 n = vec3(e, 1. - abs(e.x) - abs(e.y));
+    if (n.z < 0.) {
+        n.xy = (1. - abs(n.yx)) * SignNotZero(n.xy);
+    }
+    return normalize(n);
+}
+void main() {
+    Position = vec3(uModel * vec4(aPosition * uPositionScale + uPositionOffset, 1.));
+    TexCoord = aTexCoord;
+    Normal = normalize(mat3(transpose(inverse(uModel))) * OctahedralDecode(aNormal));
+    gl_Position = uProj * uView * vec4(Position, 1.);
+}
@@ -1,5 +1,5 @@
 #version 330 core
-#define POINT_LIGHT_COUNT 3
+#define MAX_OBJECT_LIGHTS 8
 layout (location = 0) out vec4 oFragColor;
 in vec3 Position;
 in vec2 TexCoord;
@@ -15,15 +15,6 @@ uniform struct DirectionalLight {
     vec3 specular;
     vec3 direction;
 } uDirectionalLight;
-uniform struct PointLight {
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-    vec3 position;
-    float constant;
-    float linear;
-    float quadratic;
-} uPointLights[POINT_LIGHT_COUNT];
 uniform struct FlashLight {
     vec3 ambient;
     vec3 diffuse;
@@ -38,7 +29,29 @@ uniform struct FlashLight {
     float quadratic;
 } uFlashLight;
 uniform vec3 uCamPos;
-uniform int uPointLightCount;
+uniform mat4 uView;
+// The lights picked for the object being drawn (see LightAssignment.hpp)
+uniform samplerBuffer uLights;
+uniform int uLightIndices[MAX_OBJECT_LIGHTS];
+uniform int uLightCount;
+// Cascaded shadow maps (see CascadedShadowMaps.hpp)
+uniform sampler2DArrayShadow uShadowMap;
+uniform mat4 uShadowMatrices[4];
+uniform vec4 uCascadeSplits;
+uniform int uCascadeCount;
+// Fraction of the directional light reaching a point, 1 beyond the last cascade
+float CalculateShadow(in vec3 position, in vec3 normal, in float viewDepth) {
+    int cascade = 0;
+    while (cascade < uCascadeCount && viewDepth > uCascadeSplits[cascade]) {
+        cascade++;
+    }
+    if (cascade == uCascadeCount) {
+        return 1.;
+    }
+    // Looking up a little off the surface against self shadowing acne
+    vec4 coord = uShadowMatrices[cascade] * vec4(position + normal * .02, 1.);
+    return texture(uShadowMap, vec4(coord.xy, float(cascade), coord.z));
+}
 vec3 CalculateDirectionalLight(in vec3 diffuseFragColor, in vec3 specularFragColor) {
     vec3 ambient = uDirectionalLight.ambient * diffuseFragColor;
     // Diffuse light calculation
@@ -50,23 +63,29 @@ vec3 CalculateDirectionalLight(in vec3 diffuseFragColor, in vec3 specularFragCol
     vec3 reflectDir = reflect(-lightDir, Normal);
     float spec = pow(max(dot(camDir, reflectDir), 0.), uMaterial.shininess);
     vec3 specular = spec * uDirectionalLight.specular * specularFragColor;
-    return ambient + diffuse + specular;
+    float shadow = CalculateShadow(Position, Normal, -(uView * vec4(Position, 1.)).z);
+    return ambient + shadow * (diffuse + specular);
 }
 vec3 CalculatePointLight(in int index, in vec3 diffuseFragColor, in vec3 specularFragColor) {
-    float dist = distance(uPointLights[index].position, Position);
-    float attenuation = uPointLights[index].constant + (uPointLights[index].linear * dist) + (uPointLights[index].quadratic * (dist * dist));
+    // Each light takes up 4 texels: (position, radius) (ambient, constant) (diffuse, linear) (specular, quadratic)
+    vec4 positionRadius = texelFetch(uLights, index * 4);
+    vec4 ambientConstant = texelFetch(uLights, index * 4 + 1);
+    vec4 diffuseLinear = texelFetch(uLights, index * 4 + 2);
+    vec4 specularQuadratic = texelFetch(uLights, index * 4 + 3);
+    float dist = distance(positionRadius.xyz, Position);
+    float attenuation = ambientConstant.w + (diffuseLinear.w * dist) + (specularQuadratic.w * (dist * dist));
     attenuation = 1. / attenuation;
 
-    vec3 ambient = uPointLights[index].ambient * diffuseFragColor;
+    vec3 ambient = ambientConstant.rgb * diffuseFragColor;
 
-    vec3 lightDir = normalize(uPointLights[index].position - Position);
+    vec3 lightDir = normalize(positionRadius.xyz - Position);
     float diff = max(dot(Normal, lightDir), 0.);
-    vec3 diffuse = diff * uPointLights[index].diffuse * diffuseFragColor;
+    vec3 diffuse = diff * diffuseLinear.rgb * diffuseFragColor;
 
     vec3 camDir = normalize(uCamPos - Position);
     vec3 reflectDir = reflect(-lightDir, Normal);
     float spec = pow(max(dot(camDir, reflectDir), 0.), uMaterial.shininess);
-    vec3 specular = spec * uPointLights[index].specular * specularFragColor;
+    vec3 specular = spec * specularQuadratic.rgb * specularFragColor;
     return attenuation * (ambient + diffuse + specular);
 }
 vec3 CalculateSpotLight(in vec3 diffuseFragColor, in vec3 specularFragColor) {
@@ -96,9 +115,9 @@ void main() {
     vec3 specularFragColor = texture2D(uMaterial.specular, TexCoord).rgb;
     // Summation lights in the scene
     vec3 color = CalculateDirectionalLight(diffuseFragColor, specularFragColor);
-    int size = min(uPointLightCount, POINT_LIGHT_COUNT);
+    int size = min(uLightCount, MAX_OBJECT_LIGHTS);
     for (int i = 0; i < size; i++) {
-        color += CalculatePointLight(i, diffuseFragColor, specularFragColor);
+        color += CalculatePointLight(uLightIndices[i], diffuseFragColor, specularFragColor);
     }
     color += CalculateSpotLight(diffuseFragColor, specularFragColor);
     oFragColor = vec4(color, 1.);
@@ -0,0 +1,8 @@
+#version 330 core
+in vec3 Position;
+uniform vec3 uLightPosition;
+uniform float uLightRadius;
+void main() {
+    // Linear distance so every face compares the same way
+    gl_FragDepth = distance(Position, uLightPosition) / uLightRadius;
+}
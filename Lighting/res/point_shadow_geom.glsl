@@ -0,0 +1,24 @@
+#version 330 core
+layout (triangles) in;
+layout (triangle_strip, max_vertices = 18) out;
+out vec3 Position;
+// View projection of each cube face (+x -x +y -y +z -z)
+uniform mat4 uFaceViewProj[6];
+// Faces being rendered, one bit per face
+uniform int uFaceMask;
+// Layer of the light's +x face in the atlas
+uniform int uFirstLayer;
+void main() {
+    for (int face = 0; face < 6; face++) {
+        if ((uFaceMask & (1 << face)) == 0) {
+            continue;
+        }
+        for (int i = 0; i < 3; i++) {
+            gl_Layer = uFirstLayer + face;
+            Position = gl_in[i].gl_Position.xyz;
+            gl_Position = uFaceViewProj[face] * gl_in[i].gl_Position;
+            EmitVertex();
+        }
+        EndPrimitive();
+    }
+}
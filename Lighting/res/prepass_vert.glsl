@@ -0,0 +1,12 @@
+#version 330 core
+layout (location = 0) in vec3 aPosition;
+// Per instance model matrix (takes up locations 3 to 6)
+layout (location = 3) in mat4 aModel;
+uniform mat4 uProj;
+uniform mat4 uView;
+// Computed exactly like instanced_vert.glsl so the shading pass can test depth with GL_EQUAL
+invariant gl_Position;
+void main() {
+    vec3 position = vec3(aModel * vec4(aPosition, 1.));
+    gl_Position = uProj * uView * vec4(position, 1.);
+}
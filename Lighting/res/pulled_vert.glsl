@@ -0,0 +1,27 @@
+#version 330 core
+// Same as instanced_vert.glsl but the attributes are pulled from buffer textures (see VertexPuller), the
+// decoder providing PullAttribute and PullInstanceMatrix is inserted above when the shader is loaded
+out vec3 Position;
+out vec2 TexCoord;
+out vec3 Normal;
+uniform mat4 uProj;
+uniform mat4 uView;
+// Matches the depth pre-pass (see prepass_vert.glsl)
+invariant gl_Position;
+vec2 SignNotZero(in vec2 v) {
+    return vec2(v.x >= 0. ? 1. : -1., v.y >= 0. ? 1. : -1.);
+}
+vec3 OctahedralDecode(in vec2 e) {
+    vec3 n = vec3(e, 1. - abs(e.x) - abs(e.y));
+    if (n.z < 0.) {
+        n.xy = (1. - abs(n.yx)) * SignNotZero(n.xy);
+    }
+    return normalize(n);
+}
+void main() {
+    mat4 model = PullInstanceMatrix();
+    Position = vec3(model * vec4(PullAttribute(0).xyz, 1.));
+    TexCoord = PullAttribute(1).xy;
+    Normal = normalize(mat3(transpose(inverse(model))) * OctahedralDecode(PullAttribute(2).xy));
+    gl_Position = uProj * uView * vec4(Position, 1.);
+}
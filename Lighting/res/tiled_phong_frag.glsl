@@ -0,0 +1,104 @@
+#version 330 core
+layout (location = 0) out vec4 oFragColor;
+in vec3 Position;
+in vec2 TexCoord;
+in vec3 Normal;
+uniform struct Material {
+    sampler2D diffuse;
+    sampler2D specular;
+    float shininess;
+} uMaterial;
+uniform struct DirectionalLight {
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+    vec3 direction;
+} uDirectionalLight;
+uniform vec3 uCamPos;
+uniform mat4 uView;
+// Light tiles (see TiledLightCulling.hpp)
+uniform usamplerBuffer uTileGrid;
+uniform usamplerBuffer uTileLightIndices;
+uniform samplerBuffer uTileLights;
+uniform int uTileSize;
+uniform int uTilesX;
+// The spot lights' ambient terms reach past the tiles they are binned to
+uniform vec3 uSpotAmbient;
+// Cascaded shadow maps (see CascadedShadowMaps.hpp)
+uniform sampler2DArrayShadow uShadowMap;
+uniform mat4 uShadowMatrices[4];
+uniform vec4 uCascadeSplits;
+uniform int uCascadeCount;
+// Fraction of the directional light reaching a point, 1 beyond the last cascade
+float CalculateShadow(in vec3 position, in vec3 normal, in float viewDepth) {
+    int cascade = 0;
+    while (cascade < uCascadeCount && viewDepth > uCascadeSplits[cascade]) {
+        cascade++;
+    }
+    if (cascade == uCascadeCount) {
+        return 1.;
+    }
+    // Looking up a little off the surface against self shadowing acne
+    vec4 coord = uShadowMatrices[cascade] * vec4(position + normal * .02, 1.);
+    return texture(uShadowMap, vec4(coord.xy, float(cascade), coord.z));
+}
+vec3 CalculateDirectionalLight(in vec3 diffuseFragColor, in vec3 specularFragColor) {
+    vec3 ambient = uDirectionalLight.ambient * diffuseFragColor;
+    // Diffuse light calculation
+    vec3 lightDir = normalize(-uDirectionalLight.direction);
+    float diff = max(dot(Normal, lightDir), 0.);
+    vec3 diffuse = diff * uDirectionalLight.diffuse * diffuseFragColor;
+    // Specular reflection calculation
+    vec3 camDir = normalize(uCamPos - Position);
+    vec3 reflectDir = reflect(-lightDir, Normal);
+    float spec = pow(max(dot(camDir, reflectDir), 0.), uMaterial.shininess);
+    vec3 specular = spec * uDirectionalLight.specular * specularFragColor;
+    float shadow = CalculateShadow(Position, Normal, -(uView * vec4(Position, 1.)).z);
+    return ambient + shadow * (diffuse + specular);
+}
+vec3 CalculateLight(in int index, in vec3 diffuseFragColor, in vec3 specularFragColor) {
+    // Each light takes up 6 texels: (position, radius) (ambient, constant) (diffuse, linear) (specular, quadratic)
+    // (direction, innerCutoff) (outerCutoff, isSpot, 0, 0)
+    vec4 positionRadius = texelFetch(uTileLights, index * 6);
+    vec4 ambientConstant = texelFetch(uTileLights, index * 6 + 1);
+    vec4 diffuseLinear = texelFetch(uTileLights, index * 6 + 2);
+    vec4 specularQuadratic = texelFetch(uTileLights, index * 6 + 3);
+    vec4 directionInnerCutoff = texelFetch(uTileLights, index * 6 + 4);
+    vec4 spot = texelFetch(uTileLights, index * 6 + 5);
+    float dist = distance(positionRadius.xyz, Position);
+    float attenuation = ambientConstant.w + (diffuseLinear.w * dist) + (specularQuadratic.w * (dist * dist));
+    attenuation = 1. / attenuation;
+
+    vec3 ambient = ambientConstant.rgb * diffuseFragColor;
+
+    vec3 lightDir = normalize(positionRadius.xyz - Position);
+    float diff = max(dot(Normal, lightDir), 0.);
+    vec3 diffuse = diff * diffuseLinear.rgb * diffuseFragColor;
+
+    vec3 camDir = normalize(uCamPos - Position);
+    vec3 reflectDir = reflect(-lightDir, Normal);
+    float spec = pow(max(dot(camDir, reflectDir), 0.), uMaterial.shininess);
+    vec3 specular = spec * specularQuadratic.rgb * specularFragColor;
+    if (spot.y == 0.) {
+        return attenuation * (ambient + diffuse + specular);
+    }
+    // Spot lights fade their diffuse and specular between the cutoffs, their unattenuated ambient is in uSpotAmbient
+    float theta = dot(lightDir, normalize(-directionInnerCutoff.xyz));
+    float epsilon = directionInnerCutoff.w - spot.x;
+    float intensity = clamp((theta - spot.x) / epsilon, 0., 1.);
+    return attenuation * intensity * (diffuse + specular);
+}
+void main() {
+    vec3 diffuseFragColor = texture2D(uMaterial.diffuse, TexCoord).rgb;
+    vec3 specularFragColor = texture2D(uMaterial.specular, TexCoord).rgb;
+    // Summation lights in the scene
+    vec3 color = CalculateDirectionalLight(diffuseFragColor, specularFragColor) + uSpotAmbient * diffuseFragColor;
+    // Only the lights binned into the fragment's screen tile are evaluated
+    ivec2 tile = ivec2(gl_FragCoord.xy) / uTileSize;
+    uvec2 lights = texelFetch(uTileGrid, tile.y * uTilesX + tile.x).xy;
+    for (uint i = 0u; i < lights.y; i++) {
+        int index = int(texelFetch(uTileLightIndices, int(lights.x + i)).x);
+        color += CalculateLight(index, diffuseFragColor, specularFragColor);
+    }
+    oFragColor = vec4(color, 1.);
+}
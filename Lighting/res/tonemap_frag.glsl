@@ -0,0 +1,16 @@
+#version 330 core
+layout (location = 0) out vec4 oFragColor;
+uniform sampler2D uScene;
+uniform sampler2D uAdaptedLuminance;
+// The middle grey the adapted luminance is exposed to
+uniform float uKey;
+// Narkowicz's fit of the ACES filmic curve
+vec3 Aces(in vec3 x) {
+    return clamp((x * (2.51 * x + .03)) / (x * (2.43 * x + .59) + .14), 0., 1.);
+}
+void main() {
+    vec3 color = texelFetch(uScene, ivec2(gl_FragCoord.xy), 0).rgb;
+    // Limits keep very dark or very bright scenes from being pushed too far
+    float exposure = clamp(uKey / texelFetch(uAdaptedLuminance, ivec2(0), 0).r, .1, 10.);
+    oFragColor = vec4(Aces(color * exposure), 1.);
+}
@@ -1,22 +1,111 @@
 #define MULTI_LIGHT_SOURCE 3 // Comment this line out to have the basic light model
+#define CLUSTERED_SHADING // Comment this line out to bin the lights into screen tiles, or without TILED_SHADING to give every container its own light list and generated shader
+#define TILED_SHADING // Bins the lights into screen tiles instead when CLUSTERED_SHADING is commented out
+#define DEFERRED_SHADING // Comment this line out to shade while drawing the geometry (forward shading)
+#define HDR_RENDERING // Comment this line out to draw straight to the window without exposure and tonemapping
+// #define BAKED_LIGHTING // Uncomment to stop the containers and light them from a lightmap baked on the first run (overrides the shading toggles)
+// #define VERTEX_PULLING // Uncomment to have the container shader fetch its vertices and instance matrices from buffer textures
+#define OCCLUSION_CULLING // Comment this line out to draw the containers hidden behind other containers too
+#define OCCLUSION_QUERIES // Comment this line out to draw the containers of the geometry pass instanced instead of one by one under occlusion queries
+#define STATIC_MESH // Comment this line out to leave out the sphere loaded from a converted mesh file
+#ifdef BAKED_LIGHTING
+#undef CLUSTERED_SHADING
+#undef TILED_SHADING
+#undef DEFERRED_SHADING
+#endif
+#if !defined(MULTI_LIGHT_SOURCE) || !(defined(DEFERRED_SHADING) || defined(CLUSTERED_SHADING) || defined(TILED_SHADING))
+// The other paths load their container shaders on their own
+#undef VERTEX_PULLING
+#endif
+#if !defined(MULTI_LIGHT_SOURCE) || defined(BAKED_LIGHTING)
+// The baked containers are drawn in one piece
+#undef OCCLUSION_CULLING
+#endif
+#if !defined(MULTI_LIGHT_SOURCE) || !defined(DEFERRED_SHADING) || defined(VERTEX_PULLING)
+// Only the geometry pass is queried, the depth pre-pass of forward shading would draw the hidden containers before their boxes are tested
+#undef OCCLUSION_QUERIES
+#endif
+#if !defined(MULTI_LIGHT_SOURCE) || !defined(DEFERRED_SHADING)
+// The converted mesh has its own vertex layout, only the geometry pass has a shader for it
+#undef STATIC_MESH
+#endif
 #include <glad/glad.h>
 #include <glfw/glfw3.h>
 #include <Shader.hpp>
 #include <Texture.hpp>
 #include <Camera.hpp>
+#include <JobSystem.hpp>
+#include <SceneGraph.hpp>
+#include <EntityRegistry.hpp>
+#include <LightClusters.hpp>
+#include <TiledLightCulling.hpp>
+#include <LightAssignment.hpp>
+#include <CascadedShadowMaps.hpp>
+#include <PointShadowAtlas.hpp>
+#include <LightmapBaker.hpp>
+#include <LightShaderGenerator.hpp>
+#include <GBuffer.hpp>
+#include <StreamBuffer.hpp>
+#include <GpuTimer.hpp>
+#include <HdrPipeline.hpp>
+#include <VertexFormat.hpp>
+#include <GeometryArena.hpp>
+#include <Primitives.hpp>
+#include <VertexPuller.hpp>
+#include <MaskedOcclusionCulling.hpp>
+#include <OcclusionQueries.hpp>
+#include <MeshFile.hpp>
+#include <MeshOptimizer.hpp>
+#include <StaticMesh.hpp>
+#include <LodSelector.hpp>
+#include <MeshletCuller.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include <algorithm>
+#include <cstddef>
 #include <cstdlib>
 #include <cstdio>
+#include <cstring>
 #include <fstream>
+#include <random>
 #include <sstream>
 #include <thread>
+#include <vector>
 
 constexpr auto CAMERA_SPEED = 2.5f;
+constexpr auto WINDOW_WIDTH = 800;
+constexpr auto WINDOW_HEIGHT = 600;
+constexpr auto NEAR_PLANE = .1f;
+constexpr auto FAR_PLANE = 100.f;
+// Bytes of per-frame dynamic data (instance matrices...) that can be streamed to the gpu each frame
+constexpr auto STREAM_BUFFER_FRAME_SIZE = 1 << 20;
+// Vertices and indices the geometry arenas start with, they grow when meshes do not fit
+constexpr auto GEOMETRY_VERTEX_CAPACITY = 1 << 16;
+constexpr auto GEOMETRY_INDEX_CAPACITY = 1 << 18;
+// First of the two texture units the vertex puller binds its buffer textures to, 0 to 5 hold materials, light lists and shadows
+constexpr auto VERTEX_PULLING_TEXTURE_UNIT = 6;
+// Resolution of the cpu occlusion buffer, a quarter of the window in each direction
+constexpr auto OCCLUSION_BUFFER_WIDTH = WINDOW_WIDTH / 4;
+constexpr auto OCCLUSION_BUFFER_HEIGHT = WINDOW_HEIGHT / 4;
+// Tessellation of the sphere converted to res/sphere.mesh, fine enough for its levels of detail to matter
+constexpr auto STATIC_MESH_RINGS = 64;
+constexpr auto STATIC_MESH_SECTORS = 128;
+
+// Components of the scene's entities
+// The node holding the entity's transform
+struct SceneNode {
+    SceneGraph::NodeHandle handle;
+};
+// Spins the entity around the container axis over time starting at baseAngle
+struct Spin {
+    float baseAngle;
+};
 
 static struct UserPointer {
     Camera* cameraPtr = nullptr;
     float deltaTime{ 0.f };
+    // Whether the forward shading paths lay down depth before shading (toggled with P)
+    bool depthPrepass{ false };
 } userPtr;
 
 // Process keyboard inputs
@@ -89,6 +178,13 @@ static void cursorPosFn(GLFWwindow* window, double xpos, double ypos) {
     }
 }
 
+static void keyFn(GLFWwindow* window, int key, int, int action, int) {
+    UserPointer* userPtr = (UserPointer*)glfwGetWindowUserPointer(window);
+    if (userPtr != nullptr && key == GLFW_KEY_P && action == GLFW_PRESS) {
+        userPtr->depthPrepass = !userPtr->depthPrepass;
+    }
+}
+
 int main(int argc, char** argv) {
     // Initialize glfw library
     glfwInit();
@@ -98,7 +194,7 @@ int main(int argc, char** argv) {
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
     glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
     // Create the window
-    GLFWwindow* window = glfwCreateWindow(800, 600, "Lighting", nullptr, nullptr);
+    GLFWwindow* window = glfwCreateWindow(WINDOW_WIDTH, WINDOW_HEIGHT, "Lighting", nullptr, nullptr);
     if (window == nullptr) {
         exit(EXIT_FAILURE);
     }
@@ -107,91 +203,34 @@ int main(int argc, char** argv) {
     // Setting the window's userpointer
     glfwSetWindowUserPointer(window, &userPtr);
     glfwSetCursorPosCallback(window, cursorPosFn);
+    glfwSetKeyCallback(window, keyFn);
     // Set vsync to be on
     glfwSwapInterval(1);
     // Load opengl function pointers through glad
     if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
         exit(EXIT_FAILURE);
     }
+    // Buffer storage is core in 4.4, on older contexts load it from the extension when the driver exposes it
+    if (glBufferStorage == nullptr && glfwExtensionSupported("GL_ARB_buffer_storage")) {
+        glad_glBufferStorage = (PFNGLBUFFERSTORAGEPROC)glfwGetProcAddress("glBufferStorage");
+    }
 
-    // Specifying the vertices for the cube
-    float vertices[] = {
-        // FRONT
-        -.5f, 0.5f, -.5f, 0.0f, 1.0f, 0.0f, 0.0f, -1.f,
-        0.5f, 0.5f, -.5f, 1.0f, 1.0f, 0.0f, 0.0f, -1.f,
-        0.5f, -.5f, -.5f, 1.0f, 0.0f, 0.0f, 0.0f, -1.f,
-        -.5f, -.5f, -.5f, 0.0f, 0.0f, 0.0f, 0.0f, -1.f,
-        // BACK
-        -.5f, 0.5f, 0.5f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f,
-        0.5f, 0.5f, 0.5f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f,
-        0.5f, -.5f, 0.5f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f,
-        -.5f, -.5f, 0.5f, 1.0f, 1.0f, 0.0f, 0.0f, 1.0f,
-        // TOP
-        -.5f, 0.5f, 0.5f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f,
-        0.5f, 0.5f, 0.5f, 1.0f, 1.0f, 0.0f, 1.0f, 0.0f,
-        0.5f, 0.5f, -.5f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f,
-        -.5f, 0.5f, -.5f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f,
-        // BOTTOM
-        -.5f, -.5f, -.5f, 0.0f, 1.0f, 0.0f, -1.f, 0.0f,
-        0.5f, -.5f, -.5f, 1.0f, 1.0f, 0.0f, -1.f, 0.0f,
-        0.5f, -.5f, 0.5f, 1.0f, 0.0f, 0.0f, -1.f, 0.0f,
-        -.5f, -.5f, 0.5f, 0.0f, 0.0f, 0.0f, -1.f, 0.0f,
-        // LEFT
-        -.5f, 0.5f, -.5f, 0.0f, 1.0f, -1.f, 0.0f, 0.0f,
-        -.5f, 0.5f, 0.5f, 1.0f, 1.0f, -1.f, 0.0f, 0.0f,
-        -.5f, -.5f, 0.5f, 1.0f, 0.0f, -1.f, 0.0f, 0.0f,
-        -.5f, -.5f, -.5f, 0.0f, 0.0f, -1.f, 0.0f, 0.0f,
-        // RIGHT
-        0.5f, 0.5f, 0.5f, 0.0f, 1.0f, 1.0f, 0.0f, 0.0f,
-        0.5f, 0.5f, -.5f, 1.0f, 1.0f, 1.0f, 0.0f, 0.0f,
-        0.5f, -.5f, -.5f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f,
-        0.5f, -.5f, 0.5f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f,
-    };
-
-    // Specifying the order of vertices of the cube
-    unsigned int indices[] = {
-        //Front Face
-         0, 1, 2,
-         2, 3, 0,
-        // Back Face
-         4, 5, 6,
-         6, 7, 4,
-        // Top Face
-         8, 9,10,
-        10,11, 8,
-        // Bottom Face
-        12,13,14,
-        14,15,12,
-        // Left Face
-        16,17,18,
-        18,19,16,
-        // Right Face
-        20,21,22,
-        22,23,20,
-    };
-
-    // Transfering the cube data to the gpu
-    GLuint vao, vbo, ebo;
-    glGenVertexArrays(1, &vao);
-    glBindVertexArray(vao);
-
-    // Transfering the vertex data
-    glGenBuffers(1, &vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-
-    // Specifying the layout of the vertices
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(float) * 8, 0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(float) * 8, (void*)(sizeof(float) * 3));
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(float) * 8, (void*)(sizeof(float) * 5));
-    glEnableVertexAttribArray(2);
+    // The unit cube, generated at compile time into read-only memory
+    static constexpr auto cubeMesh = primitives::Cube();
 
-    // Transfering the indices data
-    glGenBuffers(1, &ebo);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+    // The cube is stored compressed on the gpu, 16 bytes a vertex instead of 32: half float positions (exact for
+    // the cube's corners), 16 bit unorm texture coordinates and octahedral normals in 2x16 bit snorm which the vertex
+    // shaders decode with OctahedralDecode.
+    VertexFormat cubeFormat;
+    cubeFormat.Add(0, 3, GL_HALF_FLOAT).Add(1, 2, GL_UNSIGNED_SHORT, true).Add(2, 2, GL_SHORT, true);
+    std::vector<char> cubeVertices(cubeFormat.GetStride() * cubeMesh.VERTEX_COUNT);
+    for (size_t i = 0; i < cubeMesh.VERTEX_COUNT; i++) {
+        const primitives::Vertex& vertex = cubeMesh.vertices[i];
+        glm::vec2 normal = vertexcompression::OctahedralEncode({ vertex.normal[0], vertex.normal[1], vertex.normal[2] });
+        cubeFormat.Pack(cubeVertices.data(), i, 0, vertex.position);
+        cubeFormat.Pack(cubeVertices.data(), i, 1, vertex.texCoord);
+        cubeFormat.Pack(cubeVertices.data(), i, 2, &normal.x);
+    }
 
     // Enabling depth testing
     glEnable(GL_DEPTH_TEST);
@@ -199,6 +238,10 @@ int main(int argc, char** argv) {
 
     // Scoped so destructor is automatically called
     {
+        // Transfering the cube data to the gpu, all meshes of the cube's format share the arena's buffers and vertex
+        // array and are drawn with a base vertex (16 bit indices)
+        GeometryArena geometry = GeometryArena::Create(cubeFormat, GEOMETRY_VERTEX_CAPACITY, GEOMETRY_INDEX_CAPACITY);
+        GeometryArena::MeshHandle cube = geometry.Add(cubeVertices.data(), cubeMesh.VERTEX_COUNT, cubeMesh.indices.data(), cubeMesh.INDEX_COUNT);
         // Loading the shaders
 #ifndef MULTI_LIGHT_SOURCE
         // Shader containerShader = Shader::LoadFromFile("res/vert.glsl", "res/basic_phong_frag.glsl");
@@ -224,39 +267,66 @@ int main(int argc, char** argv) {
             { 1.5f, .2f, -1.5f },
             {-1.3f, 1.f, -1.5f },
         };
+        // The axis the containers are rotated around
+        const glm::vec3 containerAxis = glm::normalize(glm::vec3(1.f, .3f, .5f));
+        // The containers are children of a single node so their world matrices are contiguous
+        SceneGraph scene;
+        SceneGraph::NodeHandle containerRoot = scene.AddNode();
+        // Every object and light of the scene is an entity
+        EntityRegistry registry;
+        for (int i = 0; i < 10; i++) {
+            float angle = glm::radians(i * 20.f);
+            SceneNode node{ scene.AddNode(containerRoot, containerPositions[i], glm::angleAxis(angle, containerAxis)) };
+#ifndef BAKED_LIGHTING
+            // Every third container spins over time
+            if ((i + 1) % 3 == 0) {
+                registry.Create(node, Spin{ angle });
+                continue;
+            }
+#endif
+            registry.Create(node);
+        }
         phong::DirectionalLight directionalLight;
         directionalLight.ambient = glm::vec3(.1f);
         directionalLight.diffuse = glm::vec3(.5f);
         directionalLight.specular = glm::vec3(1.f);
         directionalLight.direction = glm::vec3(-1.f);
-        phong::PointLight pointLights[3];
+        registry.Create(directionalLight);
 #if (MULTI_LIGHT_SOURCE > 0)
-        for (int i = 0; i < glm::min(MULTI_LIGHT_SOURCE, 3); i++) {
-            pointLights[i].ambient = glm::vec3(.1f);
-            pointLights[i].diffuse = glm::vec3(.5f);
-            pointLights[i].specular = glm::vec3(1.f);
-            pointLights[i].constant = 1.f;
+        // Lights past the first three are small colored lights scattered around the containers
+        std::mt19937 random{ 42 };
+        std::uniform_real_distribution<float> unit{ 0.f, 1.f };
+        for (int i = 0; i < MULTI_LIGHT_SOURCE; i++) {
+            phong::PointLight pointLight;
+            pointLight.ambient = glm::vec3(.1f);
+            pointLight.diffuse = glm::vec3(.5f);
+            pointLight.specular = glm::vec3(1.f);
+            pointLight.constant = 1.f;
             switch (i) {
             case 0:
-                pointLights[i].position = glm::vec3(.35f, .4f,-1.f) * 3.f;
-                pointLights[i].quadratic = .44f;
-                pointLights[i].linear = .35f;
+                pointLight.position = glm::vec3(.35f, .4f,-1.f) * 3.f;
+                pointLight.quadratic = .44f;
+                pointLight.linear = .35f;
                 break;
             case 1:
-                pointLights[i].position = glm::vec3(-1.f,.3f, .25f) * 6.f;
-                pointLights[i].quadratic = .2f;
-                pointLights[i].linear = .22f;
+                pointLight.position = glm::vec3(-1.f,.3f, .25f) * 6.f;
+                pointLight.quadratic = .2f;
+                pointLight.linear = .22f;
                 break;
             case 2:
-                pointLights[i].position = glm::vec3(-1.4f, 1.f, -3.3f) * 4.f;
-                pointLights[i].quadratic = .0075f;
-                pointLights[i].linear = .045f;
+                pointLight.position = glm::vec3(-1.4f, 1.f, -3.3f) * 4.f;
+                pointLight.quadratic = .0075f;
+                pointLight.linear = .045f;
                 break;
             default:
-                pointLights[i].position = glm::vec3(0.f);
-                pointLights[i].quadratic = 0.f; 
-                pointLights[i].linear = 0.f;
+                pointLight.position = glm::vec3(unit(random) * 12.f - 6.f, unit(random) * 10.f - 4.f, unit(random) * -18.f + 2.f);
+                pointLight.ambient = glm::vec3(0.f);
+                pointLight.diffuse = glm::vec3(unit(random), unit(random), unit(random)) * .5f;
+                pointLight.specular = pointLight.diffuse;
+                pointLight.quadratic = 1.8f;
+                pointLight.linear = .7f;
             }
+            registry.Create(pointLight);
         }
 #endif
         phong::FlashLight flashLight;
@@ -267,14 +337,197 @@ int main(int argc, char** argv) {
         flashLight.outerCutoff = glm::cos(glm::radians(20.f));
         flashLight.linear = .7f;
         flashLight.quadratic = 1.8f;
-        Shader containerShader = Shader::LoadFromFile("res/vert.glsl", "res/multi_light_phong_frag.glsl");
+        registry.Create(flashLight);
+#ifdef VERTEX_PULLING
+        // The containers are drawn from a buffer texture with an empty vertex array, the arena still serves the other passes
+        VertexPuller vertexPuller = VertexPuller::Create(GEOMETRY_VERTEX_CAPACITY * cubeFormat.GetStride(), GEOMETRY_INDEX_CAPACITY);
+        uint32_t pulledCubeFormat = vertexPuller.AddFormat(cubeFormat);
+        VertexPuller::MeshHandle pulledCube = vertexPuller.Add(pulledCubeFormat, cubeVertices.data(), cubeMesh.VERTEX_COUNT,
+            cubeMesh.indices.data(), cubeMesh.INDEX_COUNT);
+#endif
+#if defined(BAKED_LIGHTING)
+        Shader containerShader = Shader::LoadFromFile("res/lightmap_vert.glsl", "res/lightmap_frag.glsl");
+#elif defined(DEFERRED_SHADING)
+#ifdef VERTEX_PULLING
+        Shader containerShader = vertexPuller.LoadShader("res/pulled_vert.glsl", "res/gbuffer_frag.glsl");
+#else
+        Shader containerShader = Shader::LoadFromFile("res/instanced_vert.glsl", "res/gbuffer_frag.glsl");
+#endif
+        Shader directionalLightShader = Shader::LoadFromFile("res/fullscreen_vert.glsl", "res/deferred_directional_frag.glsl");
+        Shader pointLightShader = Shader::LoadFromFile("res/light_volume_vert.glsl", "res/deferred_point_frag.glsl");
+        Shader spotLightShader = Shader::LoadFromFile("res/light_volume_vert.glsl", "res/deferred_spot_frag.glsl");
+        GBuffer gBuffer = GBuffer::Create(WINDOW_WIDTH, WINDOW_HEIGHT);
+        // Cube shadows of the point lights, only a few faces are updated every frame
+        Shader pointShadowShader = Shader::LoadFromFile("res/point_shadow_vert.glsl", "res/point_shadow_geom.glsl", "res/point_shadow_frag.glsl");
+        PointShadowAtlas pointShadows = PointShadowAtlas::Create();
+        // Fullscreen passes generate their vertices but a vertex array still has to be bound
+        GLuint emptyVao;
+        glGenVertexArrays(1, &emptyVao);
+#elif defined(CLUSTERED_SHADING)
+#ifdef VERTEX_PULLING
+        Shader containerShader = vertexPuller.LoadShader("res/pulled_vert.glsl", "res/clustered_phong_frag.glsl");
+#else
+        Shader containerShader = Shader::LoadFromFile("res/instanced_vert.glsl", "res/clustered_phong_frag.glsl");
+#endif
+        LightClusters lightClusters = LightClusters::Create();
+#elif defined(TILED_SHADING)
+#ifdef VERTEX_PULLING
+        Shader containerShader = vertexPuller.LoadShader("res/pulled_vert.glsl", "res/tiled_phong_frag.glsl");
+#else
+        Shader containerShader = Shader::LoadFromFile("res/instanced_vert.glsl", "res/tiled_phong_frag.glsl");
+#endif
+        TiledLightCulling lightTiles;
+        // The flash light is binned with the point lights
+        std::vector<phong::SpotLight> spotLights;
+#else
+        // Every container gets a shader specialized to its lights, the default configuration (no point lights)
+        // receives the uniforms shared by all of them
+        LightShaderGenerator lightShaders{ "res/instanced_vert.glsl" };
+        Shader& containerShader = lightShaders.Get({});
+        LightAssignment lightAssignment = LightAssignment::Create();
+        // Bounding spheres of the containers
+        std::vector<glm::vec4> containerBounds;
+#endif
+        // The point lights gathered for upload every frame
+        std::vector<phong::PointLight> pointLights;
+        // The container model matrices are streamed to the gpu every frame as instance data
+        StreamBuffer instanceBuffer = StreamBuffer::Create(GL_ARRAY_BUFFER, STREAM_BUFFER_FRAME_SIZE);
+#ifdef OCCLUSION_CULLING
+        // The containers occlude each other, the camera passes only draw the ones in front
+        MaskedOcclusionCulling occlusionCulling{ OCCLUSION_BUFFER_WIDTH, OCCLUSION_BUFFER_HEIGHT };
+        std::vector<bool> containerVisible;
+#endif
+#ifdef OCCLUSION_QUERIES
+        // Each container is its own query object, the queries test the unit cube, its bounding box
+        OcclusionQueries containerQueries = OcclusionQueries::Create(scene.GetSubtreeSize(containerRoot) - 1);
+        Shader boxShader = Shader::LoadFromFile("res/prepass_vert.glsl", "res/depth_frag.glsl");
+#endif
+#ifdef STATIC_MESH
+        // The sphere stands in for a model converted offline with MeshConverter, it goes through the same conversion
+        // on the first run so the demo does not need assimp, delete res/sphere.mesh after changing it
+        if (!std::ifstream("res/sphere.mesh")) {
+            primitives::MeshData<primitives::Vertex> sphere = primitives::UvSphere(STATIC_MESH_RINGS, STATIC_MESH_SECTORS);
+            meshfile::MeshData sphereData;
+            for (const primitives::Vertex& vertex : sphere.vertices) {
+                sphereData.positions.push_back({ vertex.position[0], vertex.position[1], vertex.position[2] });
+                sphereData.texCoords.push_back({ vertex.texCoord[0], vertex.texCoord[1] });
+                sphereData.normals.push_back({ vertex.normal[0], vertex.normal[1], vertex.normal[2] });
+            }
+            sphereData.indices = sphere.indices;
+            meshfile::Submesh submesh{};
+            submesh.indexCount = (uint32_t)sphereData.indices.size();
+            sphereData.submeshes.push_back(submesh);
+            meshopt::Optimize(sphereData, meshopt::DEFAULT_LOD_COUNT);
+            MeshFile::Write("res/sphere.mesh", sphereData);
+        }
+        // Mapped only while it is uploaded
+        StaticMesh sphereMesh = StaticMesh::Create(MeshFile::Map("res/sphere.mesh"));
+        Shader meshShader = Shader::LoadFromFile("res/mesh_vert.glsl", "res/gbuffer_frag.glsl");
+        constexpr float SPHERE_SCALE = 2.f;
+        glm::mat4 sphereModel = glm::scale(glm::translate(glm::mat4(1.f), glm::vec3(3.f, -1.5f, -6.f)), glm::vec3(SPHERE_SCALE));
+        // The level is picked from the sphere's bounds in world space every frame
+        glm::vec3 sphereCenter = glm::vec3(sphereModel * glm::vec4((sphereMesh.GetBoundsMin() + sphereMesh.GetBoundsMax()) * .5f, 1.f));
+        float sphereRadius = glm::length(sphereMesh.GetBoundsMax() - sphereMesh.GetBoundsMin()) * .5f * SPHERE_SCALE;
+        LodSelector lodSelector(glm::radians(45.f), WINDOW_HEIGHT);
+        uint32_t sphereLod = 0;
+        // Drops the meshlets of the sphere's far side and outside the view
+        MeshletCuller meshletCuller;
+#endif
+        geometry.Bind();
+        for (int i = 0; i < 4; i++) {
+            glEnableVertexAttribArray(3 + i);
+            glVertexAttribDivisor(3 + i, 1);
+        }
+#if !defined(DEFERRED_SHADING) && !defined(BAKED_LIGHTING)
+        // The depth pre-pass only reads the positions of the cube, from their own tightly packed buffer
+        Shader prepassShader = Shader::LoadFromFile("res/prepass_vert.glsl", "res/depth_frag.glsl");
+        static constexpr auto prepassMesh = primitives::Cube<1, primitives::PositionVertex>();
+        // Same position format as the cube so both passes compute the same depth
+        VertexFormat prepassFormat;
+        prepassFormat.Add(0, 3, GL_HALF_FLOAT);
+        std::vector<char> prepassPositions(prepassFormat.GetStride() * prepassMesh.VERTEX_COUNT);
+        for (size_t i = 0; i < prepassMesh.VERTEX_COUNT; i++) {
+            prepassFormat.Pack(prepassPositions.data(), i, 0, prepassMesh.vertices[i].position);
+        }
+        GeometryArena prepassGeometry = GeometryArena::Create(prepassFormat, GEOMETRY_VERTEX_CAPACITY, GEOMETRY_INDEX_CAPACITY);
+        GeometryArena::MeshHandle prepassCube = prepassGeometry.Add(prepassPositions.data(), prepassMesh.VERTEX_COUNT,
+            prepassMesh.indices.data(), prepassMesh.INDEX_COUNT);
+        prepassGeometry.Bind();
+        for (int i = 0; i < 4; i++) {
+            glEnableVertexAttribArray(3 + i);
+            glVertexAttribDivisor(3 + i, 1);
+        }
+        geometry.Bind();
+        // Gpu times of the pre-pass and the shading pass, reported every second to see whether the pre-pass pays off
+        GpuTimer prepassTimer = GpuTimer::Create();
+        GpuTimer shadingTimer = GpuTimer::Create();
+        bool timedDepthPrepass = userPtr.depthPrepass;
+        double timerReportTime = glfwGetTime();
+#endif
+#ifndef BAKED_LIGHTING
+        // Shadows of the directional light, only the spinning containers are dynamic casters
+        Shader depthShader = Shader::LoadFromFile("res/depth_vert.glsl", "res/depth_frag.glsl");
+        CascadedShadowMaps shadowMaps = CascadedShadowMaps::Create();
+#endif
+#ifdef HDR_RENDERING
+        // The scene is lit in hdr and exposed to the window by its average luminance
+        HdrPipeline hdrPipeline = HdrPipeline::Create(WINDOW_WIDTH, WINDOW_HEIGHT);
+        Shader luminanceShader = Shader::LoadFromFile("res/fullscreen_vert.glsl", "res/luminance_frag.glsl");
+        Shader downsampleShader = Shader::LoadFromFile("res/fullscreen_vert.glsl", "res/downsample_frag.glsl");
+        Shader adaptShader = Shader::LoadFromFile("res/fullscreen_vert.glsl", "res/adapt_frag.glsl");
+        Shader tonemapShader = Shader::LoadFromFile("res/fullscreen_vert.glsl", "res/tonemap_frag.glsl");
+#endif
 #endif
         Shader lightShader = Shader::LoadFromFile("res/vert.glsl", "res/light_frag.glsl");
         // Loading the textures
         Texture diffuseContainer = Texture::LoadFromFile("res/container.png");
         Texture specularContainer = Texture::LoadFromFile("res/container_specular.png");
+        // Worker threads for the per-frame cpu work
+        JobSystem jobSystem;
+#if defined(MULTI_LIGHT_SOURCE) && defined(BAKED_LIGHTING)
+        // The containers never move so their lighting is computed once, delete res/lightmap.png after changing the scene
+        scene.Update(&jobSystem);
+        LightmapBaker lightmapBaker;
+        for (size_t i = 0; i < scene.GetSubtreeSize(containerRoot) - 1; i++) {
+            lightmapBaker.AddMesh(reinterpret_cast<const float*>(cubeMesh.vertices.data()), sizeof(primitives::Vertex) / sizeof(float), cubeMesh.indices.data(),
+                cubeMesh.INDEX_COUNT, scene.GetWorldMatrices()[scene.GetIndex(containerRoot) + 1 + i]);
+        }
+        lightmapBaker.Unwrap();
+        if (!std::ifstream("res/lightmap.png")) {
+            std::vector<phong::DirectionalLight> bakedDirectionalLights;
+            registry.Each<phong::DirectionalLight>([&](Entity, phong::DirectionalLight& light) {
+                bakedDirectionalLights.push_back(light);
+            });
+            std::vector<phong::PointLight> bakedPointLights;
+            registry.Each<phong::PointLight>([&](Entity, phong::PointLight& light) {
+                bakedPointLights.push_back(light);
+            });
+            double bakeStart = glfwGetTime();
+            lightmapBaker.Bake(bakedDirectionalLights.data(), bakedDirectionalLights.size(), bakedPointLights.data(), bakedPointLights.size(), jobSystem, 1);
+            lightmapBaker.Write("res/lightmap.png");
+            printf("Baked %zu lightmap texels in %.2fs\n", lightmapBaker.GetTexelCount(), glfwGetTime() - bakeStart);
+        }
+        Texture lightmap = Texture::LoadFromFile("res/lightmap.png");
+        // The baked containers are unindexed world space triangles drawn at once
+        const std::vector<LightmapBaker::Vertex>& bakedVertices = lightmapBaker.GetVertices();
+        GLuint bakedVao, bakedVbo;
+        glGenVertexArrays(1, &bakedVao);
+        glBindVertexArray(bakedVao);
+        glGenBuffers(1, &bakedVbo);
+        glBindBuffer(GL_ARRAY_BUFFER, bakedVbo);
+        glBufferData(GL_ARRAY_BUFFER, bakedVertices.size() * sizeof(LightmapBaker::Vertex), bakedVertices.data(), GL_STATIC_DRAW);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(LightmapBaker::Vertex), (void*)offsetof(LightmapBaker::Vertex, position));
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(LightmapBaker::Vertex), (void*)offsetof(LightmapBaker::Vertex, texCoord));
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(LightmapBaker::Vertex), (void*)offsetof(LightmapBaker::Vertex, normal));
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, sizeof(LightmapBaker::Vertex), (void*)offsetof(LightmapBaker::Vertex, lightmapCoord));
+        glEnableVertexAttribArray(3);
+        geometry.Bind();
+#endif
         // The projection matrix
-        glm::mat4 proj = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 100.0f);
+        glm::mat4 proj = glm::perspective(glm::radians(45.0f), (float)WINDOW_WIDTH / WINDOW_HEIGHT, NEAR_PLANE, FAR_PLANE);
         // The view matrix will be generated by the camera
         Camera camera{ { -1.f, .79f, 1.2f }, -3.2f, 309.f };
         userPtr.cameraPtr = &camera;
@@ -323,9 +576,9 @@ int main(int argc, char** argv) {
             containerShader.SetMatrix4("uModel", model);
 
             // Binding the rectangle object
-            glBindVertexArray(vao);
+            geometry.Bind();
             // Drawing the rectangle using the currently active shader
-            glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, nullptr);
+            geometry.Draw(cube);
 
             // Drawing the light source
             lightShader.UseProgram();
@@ -333,10 +586,133 @@ int main(int argc, char** argv) {
             lightShader.SetMatrix4("uView", camera.GetViewMatrix());
             lightShader.SetMatrix4("uModel", lightModel);
             lightShader.SetFloat3("color", lightColor);
-            glBindVertexArray(vbo);
-            glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, nullptr);
+            geometry.Bind();
+            geometry.Draw(cube);
 
 #else
+            glm::mat4 view = camera.GetViewMatrix();
+            // The flash light follows the camera
+            registry.Each<phong::FlashLight>([&](Entity, phong::FlashLight& light) {
+                light.position = camera.GetPosition();
+                light.direction = camera.GetFront();
+            });
+            // Only the spinning containers get their world matrices recomputed
+            registry.Each<SceneNode, Spin>([&](Entity, SceneNode& node, Spin& spin) {
+                scene.SetRotation(node.handle, glm::angleAxis(spin.baseAngle + (float)now, containerAxis));
+            });
+            scene.Update(&jobSystem);
+            pointLights.clear();
+            registry.ForEachChunk<phong::PointLight>([&](size_t count, const Entity*, phong::PointLight* lights) {
+                pointLights.insert(pointLights.end(), lights, lights + count);
+            });
+            // Streaming this frame's instance data
+            instanceBuffer.BeginFrame();
+            size_t containerCount = scene.GetSubtreeSize(containerRoot) - 1;
+            // 16 byte aligned so the vertex puller can read the matrices as vec4 texels
+            StreamBuffer::Allocation containerModels = instanceBuffer.Allocate(sizeof(glm::mat4) * containerCount);
+            if (containerModels) {
+                memcpy(containerModels.data, &scene.GetWorldMatrices()[scene.GetIndex(containerRoot) + 1], containerModels.size);
+            }
+#ifdef OCCLUSION_CULLING
+            // The shadow passes still draw every container, the camera passes draw the ones left in visibleModels
+            const glm::mat4* containerWorldMatrices = &scene.GetWorldMatrices()[scene.GetIndex(containerRoot) + 1];
+            glm::mat4 viewProj = proj * view;
+            occlusionCulling.Clear();
+            for (size_t i = 0; i < containerCount; i++) {
+                occlusionCulling.AddOccluder(reinterpret_cast<const float*>(cubeMesh.vertices.data()), sizeof(primitives::Vertex) / sizeof(float),
+                    cubeMesh.indices.data(), cubeMesh.INDEX_COUNT, viewProj * containerWorldMatrices[i]);
+            }
+            occlusionCulling.Rasterize(&jobSystem);
+            containerVisible.assign(containerCount, false);
+            size_t visibleCount = 0;
+            for (size_t i = 0; i < containerCount; i++) {
+                // The unit cube is its own bounding box, a container never occludes itself
+                containerVisible[i] = occlusionCulling.TestBox(glm::vec3(-.5f), glm::vec3(.5f), viewProj * containerWorldMatrices[i]) == MaskedOcclusionCulling::VISIBLE;
+                visibleCount += containerVisible[i] ? 1 : 0;
+            }
+            StreamBuffer::Allocation visibleModels = instanceBuffer.Allocate(sizeof(glm::mat4) * visibleCount);
+            if (visibleModels) {
+                glm::mat4* model = static_cast<glm::mat4*>(visibleModels.data);
+                for (size_t i = 0; i < containerCount; i++) {
+                    if (containerVisible[i]) {
+                        *model++ = containerWorldMatrices[i];
+                    }
+                }
+            }
+#elif !defined(BAKED_LIGHTING) && !defined(OCCLUSION_QUERIES)
+            StreamBuffer::Allocation visibleModels = containerModels;
+            size_t visibleCount = containerCount;
+#endif
+#ifdef DEFERRED_SHADING
+            // Light volumes use the same 4 vec4 instance layout as the model matrices
+            StreamBuffer::Allocation pointLightVolumes = instanceBuffer.Allocate<glm::mat4>(pointLights.size());
+            if (pointLightVolumes) {
+                glm::vec4* volume = static_cast<glm::vec4*>(pointLightVolumes.data);
+                for (const phong::PointLight& light : pointLights) {
+                    *volume++ = glm::vec4(light.position, light.InfluenceRadius());
+                    *volume++ = glm::vec4(light.ambient, light.constant);
+                    *volume++ = glm::vec4(light.diffuse, light.linear);
+                    *volume++ = glm::vec4(light.specular, light.quadratic);
+                }
+            }
+            pointShadows.Update(camera.GetPosition(), pointLights.data(), pointLights.size());
+            StreamBuffer::Allocation pointLightShadowSlots = instanceBuffer.Allocate<float>(pointLights.size());
+            if (pointLightShadowSlots) {
+                float* slot = static_cast<float*>(pointLightShadowSlots.data);
+                for (size_t i = 0; i < pointLights.size(); i++) {
+                    *slot++ = (float)pointShadows.GetLightSlot(i);
+                }
+            }
+            StreamBuffer::Allocation flashLightVolume = instanceBuffer.Allocate<glm::mat4>(1);
+            if (flashLightVolume) {
+                registry.Each<phong::FlashLight>([&](Entity, phong::FlashLight& light) {
+                    *static_cast<glm::vec4*>(flashLightVolume.data) = glm::vec4(light.position, light.InfluenceRadius());
+                });
+            }
+#endif
+            instanceBuffer.Flush();
+            instanceBuffer.Bind();
+            geometry.Bind();
+#ifndef BAKED_LIGHTING
+            // Points the instance attributes at an allocation
+            auto bindInstances = [](const StreamBuffer::Allocation& allocation) {
+                for (int i = 0; i < 4; i++) {
+                    glVertexAttribPointer(3 + i, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(allocation.offset + sizeof(glm::vec4) * i));
+                }
+            };
+            // Shadow pass: only the cascades that are not cached are rendered
+            registry.Each<SceneNode, Spin>([&](Entity, SceneNode& node, Spin&) {
+                shadowMaps.AddDynamicCaster(glm::vec4(glm::vec3(scene.GetWorldMatrix(node.handle)[3]), .87f));
+            });
+            registry.Each<phong::DirectionalLight>([&](Entity, phong::DirectionalLight& light) {
+                shadowMaps.Update(camera, glm::radians(45.f), (float)WINDOW_WIDTH / WINDOW_HEIGHT, NEAR_PLANE, FAR_PLANE, light.direction);
+            });
+            if (containerModels) {
+                depthShader.UseProgram();
+                bindInstances(containerModels);
+                for (int i = 0; i < shadowMaps.GetCascadeCount(); i++) {
+                    if (shadowMaps.NeedsRender(i)) {
+                        shadowMaps.BeginCascade(i);
+                        depthShader.SetMatrix4("uLightViewProj", shadowMaps.GetLightViewProj(i));
+                        geometry.Draw(cube, (GLsizei)containerCount);
+                    }
+                }
+                shadowMaps.EndCascades(WINDOW_WIDTH, WINDOW_HEIGHT);
+#ifdef DEFERRED_SHADING
+                pointShadowShader.UseProgram();
+                for (int i = 0; i < pointShadows.GetSlotCount(); i++) {
+                    if (pointShadows.GetFaceMask(i) != 0) {
+                        pointShadows.BeginSlot(i, pointShadowShader);
+                        geometry.Draw(cube, (GLsizei)containerCount);
+                    }
+                }
+                pointShadows.End(WINDOW_WIDTH, WINDOW_HEIGHT);
+#endif
+            }
+#endif
+#ifdef HDR_RENDERING
+            hdrPipeline.BindSceneTarget();
+#endif
             containerShader.UseProgram();
             diffuseContainer.Bind(0);
             specularContainer.Bind(1);
@@ -344,45 +720,307 @@ int main(int argc, char** argv) {
             containerShader.SetInt("uMaterial.specular", 1);
             containerShader.SetFloat("uMaterial.shininess", 32.f);
             containerShader.SetMatrix4("uProj", proj);
-            containerShader.SetMatrix4("uView", camera.GetViewMatrix());
+            containerShader.SetMatrix4("uView", view);
+#ifdef DEFERRED_SHADING
+            // Geometry pass: only surface attributes are written
+            gBuffer.BindGeometryPass();
+#ifdef STATIC_MESH
+            // Drawn first so it hides the containers behind it, from the occlusion queries too
+            meshShader.UseProgram();
+            meshShader.SetInt("uMaterial.diffuse", 0);
+            meshShader.SetInt("uMaterial.specular", 1);
+            meshShader.SetFloat("uMaterial.shininess", 32.f);
+            meshShader.SetMatrix4("uProj", proj);
+            meshShader.SetMatrix4("uView", view);
+            meshShader.SetMatrix4("uModel", sphereModel);
+            meshShader.SetFloat3("uPositionScale", sphereMesh.GetPositionScale());
+            meshShader.SetFloat3("uPositionOffset", sphereMesh.GetPositionOffset());
+            sphereLod = lodSelector.Select(sphereLod, sphereMesh.GetLodErrors(), sphereCenter, sphereRadius, camera.GetPosition(), SPHERE_SCALE);
+            sphereMesh.DrawCulled(meshletCuller, sphereLod, sphereModel, proj * view, camera.GetPosition());
+            geometry.Bind();
+            containerShader.UseProgram();
+#endif
+#ifdef OCCLUSION_QUERIES
+            if (containerModels) {
+                // Results of the earlier frames decide which containers are drawn, none is waited for
+                containerQueries.BeginFrame();
+                for (size_t i = 0; i < containerCount; i++) {
+                    StreamBuffer::Allocation containerModel = containerModels;
+                    containerModel.offset += sizeof(glm::mat4) * i;
+                    // From inside its box a container cannot be queried
+                    glm::vec3 local = glm::abs(glm::vec3(glm::inverse(scene.GetWorldMatrices()[scene.GetIndex(containerRoot) + 1 + i]) * glm::vec4(camera.GetPosition(), 1.f)));
+                    if (std::max(local.x, std::max(local.y, local.z)) < .5f + NEAR_PLANE * 2.f) {
+                        containerQueries.MarkVisible(i);
+                    }
+#ifdef OCCLUSION_CULLING
+                    // Culled on the cpu, drawn right away once it comes out again
+                    if (!containerVisible[i]) {
+                        containerQueries.MarkVisible(i);
+                        continue;
+                    }
+#endif
+                    containerQueries.Draw(i, [&]() {
+                        bindInstances(containerModel);
+                        geometry.Draw(cube, 1);
+                    });
+                }
+                // The boxes of the hidden containers against the depth of the drawn ones
+                boxShader.UseProgram();
+                boxShader.SetMatrix4("uProj", proj);
+                boxShader.SetMatrix4("uView", view);
+                containerQueries.QueryHidden([&](size_t i) {
+                    StreamBuffer::Allocation containerModel = containerModels;
+                    containerModel.offset += sizeof(glm::mat4) * i;
+                    bindInstances(containerModel);
+                    geometry.Draw(cube, 1);
+                });
+            }
+#else
+            if (visibleModels) {
+#ifdef VERTEX_PULLING
+                vertexPuller.Bind(containerShader, VERTEX_PULLING_TEXTURE_UNIT, instanceBuffer.GetBufferObject(), visibleModels.offset);
+                vertexPuller.Draw(pulledCube, (GLsizei)visibleCount);
+                geometry.Bind();
+#else
+                bindInstances(visibleModels);
+                geometry.Draw(cube, (GLsizei)visibleCount);
+#endif
+            }
+#endif
+            // Lighting passes: every light adds its contribution to the pixels it covers
+            gBuffer.BindLightingPass();
+            glDepthMask(GL_FALSE);
+            glEnable(GL_BLEND);
+            glBlendFunc(GL_ONE, GL_ONE);
+            glm::mat4 invViewProj = glm::inverse(proj * view);
+            // The accumulation target has no depth, the lighting passes test the sampled depth themselves
+            glDisable(GL_DEPTH_TEST);
+            // The directional light reaches every pixel, so does the flash light's ambient term
+            directionalLightShader.UseProgram();
+            gBuffer.BindTextures(directionalLightShader, 2);
+            shadowMaps.Bind(directionalLightShader, 5);
+            directionalLightShader.SetMatrix4("uView", view);
+            directionalLightShader.SetMatrix4("uInvViewProj", invViewProj);
+            directionalLightShader.SetFloat3("uCamPos", camera.GetPosition());
+            registry.Each<phong::FlashLight>([&](Entity, phong::FlashLight& light) {
+                directionalLightShader.SetFloat3("uFlashLightAmbient", light.ambient);
+            });
+            registry.Each<phong::DirectionalLight>([&](Entity, phong::DirectionalLight& light) {
+                directionalLightShader.SetLight("uDirectionalLight", light);
+                glBindVertexArray(emptyVao);
+                glDrawArrays(GL_TRIANGLES, 0, 3);
+            });
+            // Point and spot lights draw the back faces of their volumes and keep the pixels where the scene is in
+            // front of them (tested in the shaders), this also covers the camera being inside of a volume. Volumes
+            // reaching past the far plane would lose their back faces, depth clamping flattens them onto it instead
+            geometry.Bind();
+            glEnable(GL_CULL_FACE);
+            glCullFace(GL_FRONT);
+            glEnable(GL_DEPTH_CLAMP);
+            if (flashLightVolume) {
+                spotLightShader.UseProgram();
+                gBuffer.BindTextures(spotLightShader, 2);
+                spotLightShader.SetMatrix4("uProj", proj);
+                spotLightShader.SetMatrix4("uView", view);
+                spotLightShader.SetMatrix4("uInvViewProj", invViewProj);
+                spotLightShader.SetFloat3("uCamPos", camera.GetPosition());
+                registry.Each<phong::FlashLight>([&](Entity, phong::FlashLight& light) {
+                    spotLightShader.SetLight("uFlashLight", light);
+                });
+                bindInstances(flashLightVolume);
+                geometry.Draw(cube, 1);
+            }
+            if (pointLightVolumes && pointLightShadowSlots) {
+                pointLightShader.UseProgram();
+                gBuffer.BindTextures(pointLightShader, 2);
+                pointLightShader.SetMatrix4("uProj", proj);
+                pointLightShader.SetMatrix4("uView", view);
+                pointLightShader.SetMatrix4("uInvViewProj", invViewProj);
+                pointLightShader.SetFloat3("uCamPos", camera.GetPosition());
+                pointShadows.Bind(pointLightShader, 5);
+                bindInstances(pointLightVolumes);
+                // The shadow slots are an extra instance attribute only the point lights have
+                glEnableVertexAttribArray(7);
+                glVertexAttribDivisor(7, 1);
+                glVertexAttribPointer(7, 1, GL_FLOAT, GL_FALSE, sizeof(float), (void*)pointLightShadowSlots.offset);
+                geometry.Draw(cube, (GLsizei)pointLights.size());
+                glDisableVertexAttribArray(7);
+            }
+            glDisable(GL_DEPTH_CLAMP);
+            glDisable(GL_CULL_FACE);
+            glCullFace(GL_BACK);
+            glEnable(GL_DEPTH_TEST);
+            glDisable(GL_BLEND);
+            glDepthMask(GL_TRUE);
+#ifdef HDR_RENDERING
+            gBuffer.BlitTo(hdrPipeline.GetSceneFramebuffer());
+#else
+            gBuffer.BlitTo();
+#endif
+#else
             containerShader.SetFloat3("uCamPos", camera.GetPosition());
-            containerShader.SetLight("uDirectionalLight", directionalLight);
-            containerShader.SetLights("uPointLights", pointLights, glm::min(MULTI_LIGHT_SOURCE, 3));
-            containerShader.SetInt("uPointLightCount", glm::min(MULTI_LIGHT_SOURCE, 3));
-            flashLight.position = camera.GetPosition();
-            flashLight.direction = camera.GetFront();
-            containerShader.SetLight("uFlashLight", flashLight);
-            glBindVertexArray(vao);
-            for (int i = 0; i < 10; i++) {
-                glm::mat4 containerModel{ 1.f };
-                containerModel = glm::translate(containerModel, containerPositions[i]);
-                containerModel = glm::rotate(containerModel, glm::radians(i * 20.f) + (float)((i + 1) % 3 == 0 ? now : 0), { 1.f, .3f, .5f });
-                containerShader.SetMatrix4("uModel", containerModel);
-                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, nullptr);
+#if defined(BAKED_LIGHTING)
+            lightmap.Bind(2);
+            containerShader.SetInt("uLightmap", 2);
+            containerShader.SetFloat("uLightmapScale", LightmapBaker::LIGHTMAP_SCALE);
+#else
+            // Uploading the lights
+            registry.Each<phong::DirectionalLight>([&](Entity, phong::DirectionalLight& light) {
+                containerShader.SetLight("uDirectionalLight", light);
+            });
+            shadowMaps.Bind(containerShader, 5);
+#ifdef CLUSTERED_SHADING
+            lightClusters.Build(view, proj, NEAR_PLANE, FAR_PLANE, pointLights.data(), pointLights.size(), jobSystem);
+            lightClusters.Bind(containerShader, 2, { (float)WINDOW_WIDTH, (float)WINDOW_HEIGHT });
+#elif defined(TILED_SHADING)
+            spotLights.clear();
+            registry.ForEachChunk<phong::SpotLight>([&](size_t count, const Entity*, phong::SpotLight* lights) {
+                spotLights.insert(spotLights.end(), lights, lights + count);
+            });
+            lightTiles.Bin(view, proj, NEAR_PLANE, FAR_PLANE, WINDOW_WIDTH, WINDOW_HEIGHT, pointLights.data(), pointLights.size(), spotLights.data(), spotLights.size(), &jobSystem);
+            lightTiles.Upload();
+            lightTiles.Bind(containerShader, 2);
+#else
+            containerBounds.clear();
+            for (size_t i = 0; i < containerCount; i++) {
+                // The unit cube fits in a sphere of radius sqrt(3) / 2
+                containerBounds.push_back(glm::vec4(glm::vec3(scene.GetWorldMatrices()[scene.GetIndex(containerRoot) + 1 + i][3]), .87f));
+            }
+            lightAssignment.Assign(pointLights.data(), pointLights.size(), containerBounds.data(), containerBounds.size(), &jobSystem);
+            lightAssignment.Bind(containerShader, 2);
+#endif
+#endif
+            registry.Each<phong::FlashLight>([&](Entity, phong::FlashLight& light) {
+                containerShader.SetLight("uFlashLight", light);
+            });
+#if defined(BAKED_LIGHTING)
+            glBindVertexArray(bakedVao);
+            glDrawArrays(GL_TRIANGLES, 0, (GLsizei)bakedVertices.size());
+            geometry.Bind();
+#else
+            if (containerModels && visibleModels) {
+                if (userPtr.depthPrepass) {
+                    // Depth only, the shading pass then runs the light shader once per pixel on the visible surface
+                    prepassTimer.Begin();
+                    prepassShader.UseProgram();
+                    prepassShader.SetMatrix4("uProj", proj);
+                    prepassShader.SetMatrix4("uView", view);
+                    prepassGeometry.Bind();
+                    bindInstances(visibleModels);
+                    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+                    prepassGeometry.Draw(prepassCube, (GLsizei)visibleCount);
+                    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+                    prepassTimer.End();
+                    glDepthFunc(GL_EQUAL);
+                    glDepthMask(GL_FALSE);
+                    geometry.Bind();
+                    containerShader.UseProgram();
+                }
+                shadingTimer.Begin();
+#if defined(CLUSTERED_SHADING) || defined(TILED_SHADING)
+#ifdef VERTEX_PULLING
+                vertexPuller.Bind(containerShader, VERTEX_PULLING_TEXTURE_UNIT, instanceBuffer.GetBufferObject(), visibleModels.offset);
+                vertexPuller.Draw(pulledCube, (GLsizei)visibleCount);
+                geometry.Bind();
+#else
+                bindInstances(visibleModels);
+                geometry.Draw(cube, (GLsizei)visibleCount);
+#endif
+#else
+                // Every container is drawn on its own with its own light list and a shader specialized to those lights
+                auto setLightUniforms = [&](Shader& shader) {
+                    shader.SetInt("uMaterial.diffuse", 0);
+                    shader.SetInt("uMaterial.specular", 1);
+                    shader.SetFloat("uMaterial.shininess", 32.f);
+                    shader.SetMatrix4("uProj", proj);
+                    shader.SetMatrix4("uView", view);
+                    shader.SetFloat3("uCamPos", camera.GetPosition());
+                    registry.Each<phong::DirectionalLight>([&](Entity, phong::DirectionalLight& light) {
+                        shader.SetLight("uDirectionalLight", light);
+                    });
+                    shadowMaps.Bind(shader, 5);
+                    lightAssignment.Bind(shader, 2);
+                    registry.Each<phong::FlashLight>([&](Entity, phong::FlashLight& light) {
+                        shader.SetLight("uFlashLight", light);
+                    });
+                };
+                const Shader* activeShader = &containerShader;
+                for (size_t i = 0; i < containerCount; i++) {
+#ifdef OCCLUSION_CULLING
+                    if (!containerVisible[i]) {
+                        continue;
+                    }
+#endif
+                    int lightCount;
+                    const int* lightIndices = lightAssignment.GetObjectLights(i, lightCount);
+                    LightShaderGenerator::Configuration configuration;
+                    configuration.pointCount = lightCount;
+                    for (int j = 0; j < lightCount; j++) {
+                        if (pointLights[lightIndices[j]].specular != glm::vec3(0.f)) {
+                            configuration.pointSpecularMask |= 1u << j;
+                        }
+                    }
+                    Shader& shader = lightShaders.Get(configuration);
+                    if (&shader != activeShader) {
+                        shader.UseProgram();
+                        setLightUniforms(shader);
+                        activeShader = &shader;
+                    }
+                    StreamBuffer::Allocation containerModel = containerModels;
+                    containerModel.offset += sizeof(glm::mat4) * i;
+                    bindInstances(containerModel);
+                    lightAssignment.SetObjectLights(shader, i);
+                    geometry.Draw(cube, 1);
+                }
+#endif
+                shadingTimer.End();
+                glDepthFunc(GL_LESS);
+                glDepthMask(GL_TRUE);
+            }
+            if (timedDepthPrepass != userPtr.depthPrepass) {
+                prepassTimer.Reset();
+                shadingTimer.Reset();
+                timedDepthPrepass = userPtr.depthPrepass;
+                timerReportTime = now;
             }
+            else if (now - timerReportTime >= 1.) {
+                printf("Depth pre-pass %s: pre-pass %.3f ms, shading %.3f ms (gpu)\n", timedDepthPrepass ? "on" : "off", prepassTimer.GetAverageMs(), shadingTimer.GetAverageMs());
+                prepassTimer.Reset();
+                shadingTimer.Reset();
+                timerReportTime = now;
+            }
+#endif
+#endif
             lightShader.UseProgram();
             lightShader.SetMatrix4("uProj", proj);
-            lightShader.SetMatrix4("uView", camera.GetViewMatrix());
-#if (MULTI_LIGHT_SOURCE > 0)
-            for (int i = 0; i < glm::min(MULTI_LIGHT_SOURCE, 3); i++) {
+            lightShader.SetMatrix4("uView", view);
+            registry.Each<phong::PointLight>([&](Entity, phong::PointLight& light) {
                 glm::mat4 lightModel = glm::mat4(1.f);
-                lightModel = glm::translate(lightModel, pointLights[i].position);
+                lightModel = glm::translate(lightModel, light.position);
                 lightModel = glm::scale(lightModel, glm::vec3(.2f));
                 lightShader.SetMatrix4("uModel", lightModel);
-                lightShader.SetFloat3("color", pointLights[i].specular);
-                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, nullptr);
-            }
+                lightShader.SetFloat3("color", light.specular);
+                geometry.Draw(cube);
+            });
+#ifdef HDR_RENDERING
+            hdrPipeline.Tonemap(tonemapShader);
+            // The delta time is stored as past - now
+            hdrPipeline.MeasureLuminance(luminanceShader, downsampleShader, adaptShader, -userPtr.deltaTime);
 #endif
+            instanceBuffer.EndFrame();
 #endif // !MULTI_LIGHT_SOURCE
 
             // Swapping the buffer beeing rendered
             glfwSwapBuffers(window);
         }
+#if defined(MULTI_LIGHT_SOURCE) && defined(DEFERRED_SHADING)
+        glDeleteVertexArrays(1, &emptyVao);
+#endif
+#if defined(MULTI_LIGHT_SOURCE) && defined(BAKED_LIGHTING)
+        glDeleteBuffers(1, &bakedVbo);
+        glDeleteVertexArrays(1, &bakedVao);
+#endif
     }
-    // Cleaning up the opengl objects
-    glDeleteBuffers(1, &ebo);
-    glDeleteBuffers(1, &vbo);
-    glDeleteVertexArrays(1, &vao);
     // Cleaning up glfw
     glfwDestroyWindow(window);
     glfwTerminate();
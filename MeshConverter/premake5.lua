@@ -0,0 +1,39 @@
+project "MeshConverter"
+    kind "ConsoleApp"
+    language "C++"
+    cppdialect "C++20"
+    targetdir ("../bin/%{prj.name}")
+    objdir ("../obj/%{prj.name}")
+    files {
+        "src/*.h",
+        "src/*.cpp",
+    }
+    includedirs {
+        "%{IncludeDirs.ASSIMP}",
+        -- config.h is generated by assimp's CMake into its build directory
+        "../vendors/assimp/build/include",
+        "%{IncludeDirs.GLAD}",
+        "%{IncludeDirs.GLM}",
+        "../include",
+    }
+    vpaths {
+        ["Source Files"] = "**.cpp",
+        ["Header Files"] = "**.h",
+    }
+    -- assimp is built with its own CMake into vendors/assimp/build
+    -- (cmake -S vendors/assimp -B vendors/assimp/build -DBUILD_SHARED_LIBS=OFF -DASSIMP_BUILD_TESTS=OFF),
+    -- the project is only part of the workspace when premake runs with --with-meshconverter
+    libdirs {
+        "../vendors/assimp/build/lib",
+        "../vendors/assimp/build/lib/%{cfg.buildcfg}",
+    }
+    filter "system:windows"
+        links { "assimp-vc143-mt", "zlibstatic" }
+    filter "system:not windows"
+        links { "assimp", "z" }
+    filter "configurations:Debug"
+        defines "DEBUG"
+        symbols "On"
+    filter "configurations:Release"
+        defines "NDEBUG"
+        optimize "On"
@@ -0,0 +1,139 @@
+#include <MeshFile.hpp>
+#include <MeshOptimizer.hpp>
+#include <MeshletCuller.hpp>
+#include <assimp/Importer.hpp>
+#include <assimp/postprocess.h>
+#include <assimp/scene.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+// Flattens every mesh of the scene into one vertex and index buffer, one submesh per assimp mesh
+static meshfile::MeshData convert(const aiScene& scene) {
+    meshfile::MeshData mesh;
+    bool texCoords = true, normals = true;
+    for (unsigned int i = 0; i < scene.mNumMeshes; i++) {
+        texCoords &= scene.mMeshes[i]->HasTextureCoords(0);
+        normals &= scene.mMeshes[i]->HasNormals();
+    }
+    for (unsigned int i = 0; i < scene.mNumMeshes; i++) {
+        const aiMesh& source = *scene.mMeshes[i];
+        uint32_t baseVertex = (uint32_t)mesh.positions.size();
+        meshfile::Submesh submesh{};
+        submesh.firstIndex = (uint32_t)mesh.indices.size();
+        submesh.materialIndex = source.mMaterialIndex;
+        for (unsigned int v = 0; v < source.mNumVertices; v++) {
+            mesh.positions.push_back({ source.mVertices[v].x, source.mVertices[v].y, source.mVertices[v].z });
+            if (texCoords) {
+                mesh.texCoords.push_back({ source.mTextureCoords[0][v].x, source.mTextureCoords[0][v].y });
+            }
+            if (normals) {
+                mesh.normals.push_back({ source.mNormals[v].x, source.mNormals[v].y, source.mNormals[v].z });
+            }
+        }
+        for (unsigned int f = 0; f < source.mNumFaces; f++) {
+            const aiFace& face = source.mFaces[f];
+            // Points and lines left after triangulation are dropped
+            if (face.mNumIndices != 3) {
+                continue;
+            }
+            for (int k = 0; k < 3; k++) {
+                mesh.indices.push_back(baseVertex + face.mIndices[k]);
+            }
+        }
+        submesh.indexCount = (uint32_t)mesh.indices.size() - submesh.firstIndex;
+        if (submesh.indexCount > 0) {
+            mesh.submeshes.push_back(submesh);
+        }
+    }
+    return mesh;
+}
+
+// Converts a model to the binary mesh format offline, so the demos only map the result instead of parsing
+// the model with assimp at startup.
+// Usage: MeshConverter <model> <output.mesh>
+int main(int argc, char** argv) {
+    if (argc != 3) {
+        fprintf(stderr, "usage: %s <model> <output.mesh>\n", argv[0]);
+        return 1;
+    }
+    auto start = std::chrono::steady_clock::now();
+    Assimp::Importer importer;
+    // Node transforms are baked into the vertices, the format has no hierarchy
+    // Duplicate vertices are welded by MeshOptimizer across the whole scene rather than per assimp mesh
+    const aiScene* scene = importer.ReadFile(argv[1], aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_PreTransformVertices | aiProcess_SortByPType | aiProcess_ValidateDataStructure);
+    if (scene == nullptr || scene->mNumMeshes == 0) {
+        fprintf(stderr, "cannot import %s: %s\n", argv[1], importer.GetErrorString());
+        return 1;
+    }
+    meshfile::MeshData mesh = convert(*scene);
+    double importMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    size_t importedVertexCount = mesh.positions.size();
+    meshopt::VertexCacheStatistics before = meshopt::AnalyzeVertexCache(mesh.indices.data(), mesh.indices.size(), mesh.positions.size());
+    start = std::chrono::steady_clock::now();
+    int lodCount = meshopt::Optimize(mesh, meshopt::DEFAULT_LOD_COUNT);
+    double optimizeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    // Per level triangle counts and errors, the full detail level leads the index buffer
+    std::vector<size_t> lodIndexCounts(lodCount, 0);
+    std::vector<float> lodErrors(lodCount, 0.f);
+    for (const meshfile::Submesh& submesh : mesh.submeshes) {
+        lodIndexCounts[submesh.lod] += submesh.indexCount;
+        lodErrors[submesh.lod] = std::max(lodErrors[submesh.lod], submesh.lodError);
+    }
+    meshopt::VertexCacheStatistics after = meshopt::AnalyzeVertexCache(mesh.indices.data(), lodIndexCounts[0], mesh.positions.size());
+    if (!MeshFile::Write(argv[2], mesh)) {
+        return 1;
+    }
+    // Reading the result back checks it the same way the demos do
+    start = std::chrono::steady_clock::now();
+    MeshFile file = MeshFile::Map(argv[2]);
+    if (!file.IsValid()) {
+        return 1;
+    }
+    double mapMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    printf("%s: %zu vertices, %zu triangles, %zu submeshes%s%s\n", argv[2], mesh.positions.size(), lodIndexCounts[0] / 3, mesh.submeshes.size() / lodCount,
+        mesh.texCoords.empty() ? "" : ", texture coordinates", mesh.normals.empty() ? "" : ", normals");
+    const meshfile::Header& header = file.GetHeader();
+    printf("%.1f bytes per vertex, %u bit indices\n", header.vertexCount > 0 ? (double)header.vertexDataSize / header.vertexCount : 0., header.indexSize * 8);
+    printf("welded %zu vertices into %zu\n", importedVertexCount, mesh.positions.size());
+    for (int lod = 1; lod < lodCount; lod++) {
+        printf("lod %d: %zu triangles, error %g\n", lod, lodIndexCounts[lod] / 3, lodErrors[lod]);
+    }
+    printf("vertex cache (fifo of %u): acmr %.3f -> %.3f, atvr %.3f -> %.3f\n", meshopt::STATISTICS_CACHE_SIZE, before.acmr, after.acmr, before.atvr, after.atvr);
+    // Meshlets of the full detail level, and the share the cone test drops for cameras all around the mesh
+    size_t meshletCount = 0, coneCount = 0;
+    size_t meshletTriangles = 0, backfacingSamples = 0;
+    constexpr int VIEW_SAMPLES = 64;
+    glm::vec3 boundsMin{ header.boundsMin[0], header.boundsMin[1], header.boundsMin[2] };
+    glm::vec3 boundsMax{ header.boundsMax[0], header.boundsMax[1], header.boundsMax[2] };
+    glm::vec3 center = (boundsMin + boundsMax) * .5f;
+    float distance = glm::length(boundsMax - boundsMin) * 2.f;
+    for (const meshfile::Submesh& submesh : mesh.submeshes) {
+        if (submesh.lod != 0) {
+            continue;
+        }
+        for (uint32_t i = submesh.firstMeshlet; i < submesh.firstMeshlet + submesh.meshletCount; i++) {
+            const meshfile::Meshlet& meshlet = mesh.meshlets[i];
+            meshletCount++;
+            meshletTriangles += meshlet.indexCount / 3;
+            coneCount += meshlet.coneCutoff < 1.f;
+            // Fibonacci sphere of view directions
+            for (int s = 0; s < VIEW_SAMPLES; s++) {
+                float y = 1.f - 2.f * (s + .5f) / VIEW_SAMPLES;
+                float angle = 2.39996323f * s;
+                float r = std::sqrt(1.f - y * y);
+                glm::vec3 camera = center + glm::vec3(std::cos(angle) * r, y, std::sin(angle) * r) * distance;
+                backfacingSamples += MeshletCuller::IsBackfacing(meshlet, camera);
+            }
+        }
+    }
+    if (meshletCount > 0) {
+        printf("%zu meshlets, %.1f triangles each, %zu with a usable normal cone, %.1f%% culled by cones on average\n", meshletCount,
+            (double)meshletTriangles / meshletCount, coneCount, 100. * backfacingSamples / ((double)meshletCount * VIEW_SAMPLES));
+    }
+    printf("assimp import %.2f ms, optimization %.2f ms, mapping the converted file %.3f ms\n", importMs, optimizeMs, mapMs);
+    return 0;
+}
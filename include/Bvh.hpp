@@ -0,0 +1,172 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// The bounding volume hierarchy class
+// Accelerates ray casts against a static triangle soup. Nodes are split at the median of the triangle centroids
+// along their longest axis and stored depth first in one array, so a node's left child directly follows it.
+class Bvh {
+public:
+    // Triangles per leaf
+    static constexpr uint32_t LEAF_SIZE = 4;
+    struct Hit {
+        uint32_t triangle;
+        // Barycentric coordinates of the hit point for the second and third vertex
+        float u;
+        float v;
+        float t;
+    };
+    /// <summary>Builds the hierarchy over triangles given as three consecutive positions each</summary>
+    /// <param name="positions">The corners of the triangles, triangle i uses positions 3i to 3i + 2</param>
+    void Build(const glm::vec3* positions, size_t triangleCount) {
+        m_Triangles.resize(triangleCount);
+        m_Order.resize(triangleCount);
+        std::vector<glm::vec3> centroids(triangleCount);
+        for (size_t i = 0; i < triangleCount; i++) {
+            const glm::vec3* p = positions + i * 3;
+            m_Triangles[i] = { p[0], p[1] - p[0], p[2] - p[0] };
+            centroids[i] = (p[0] + p[1] + p[2]) / 3.f;
+            m_Order[i] = (uint32_t)i;
+        }
+        m_Nodes.clear();
+        m_Nodes.reserve(triangleCount * 2);
+        if (triangleCount > 0) {
+            BuildNode(positions, centroids, 0, (uint32_t)triangleCount);
+        }
+    }
+    // Finds the closest hit along the ray closer than tMax, direction does not have to be normalized
+    bool Intersect(const glm::vec3& origin, const glm::vec3& direction, float tMax, Hit& hit) const {
+        hit.t = tMax;
+        return Traverse<false>(origin, direction, hit);
+    }
+    // Whether anything is hit along the ray closer than tMax (faster than Intersect as it stops at the first hit)
+    bool Occluded(const glm::vec3& origin, const glm::vec3& direction, float tMax) const {
+        Hit hit;
+        hit.t = tMax;
+        return Traverse<true>(origin, direction, hit);
+    }
+    size_t GetNodeCount() const {
+        return m_Nodes.size();
+    }
+private:
+    struct Node {
+        glm::vec3 min;
+        // Leaves: first index into m_Order, inner nodes: index of the right child
+        uint32_t offset;
+        glm::vec3 max;
+        // Triangles of a leaf, 0 for inner nodes
+        uint32_t count;
+    };
+    struct Triangle {
+        glm::vec3 p0;
+        glm::vec3 e1;
+        glm::vec3 e2;
+    };
+    uint32_t BuildNode(const glm::vec3* positions, const std::vector<glm::vec3>& centroids, uint32_t begin, uint32_t end) {
+        uint32_t index = (uint32_t)m_Nodes.size();
+        m_Nodes.push_back({});
+        glm::vec3 min{ INFINITY }, max{ -INFINITY }, centroidMin{ INFINITY }, centroidMax{ -INFINITY };
+        for (uint32_t i = begin; i < end; i++) {
+            const glm::vec3* p = positions + m_Order[i] * 3;
+            min = glm::min(min, glm::min(p[0], glm::min(p[1], p[2])));
+            max = glm::max(max, glm::max(p[0], glm::max(p[1], p[2])));
+            centroidMin = glm::min(centroidMin, centroids[m_Order[i]]);
+            centroidMax = glm::max(centroidMax, centroids[m_Order[i]]);
+        }
+        m_Nodes[index].min = min;
+        m_Nodes[index].max = max;
+        glm::vec3 extent = centroidMax - centroidMin;
+        if (end - begin <= LEAF_SIZE || glm::max(extent.x, glm::max(extent.y, extent.z)) == 0.f) {
+            m_Nodes[index].offset = begin;
+            m_Nodes[index].count = end - begin;
+            return index;
+        }
+        int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+        uint32_t middle = begin + (end - begin) / 2;
+        std::nth_element(m_Order.begin() + begin, m_Order.begin() + middle, m_Order.begin() + end, [&](uint32_t a, uint32_t b) {
+            return centroids[a][axis] < centroids[b][axis];
+        });
+        BuildNode(positions, centroids, begin, middle);
+        uint32_t right = BuildNode(positions, centroids, middle, end);
+        m_Nodes[index].offset = right;
+        m_Nodes[index].count = 0;
+        return index;
+    }
+    template<bool ANY_HIT>
+    bool Traverse(const glm::vec3& origin, const glm::vec3& direction, Hit& hit) const {
+        if (m_Nodes.empty()) {
+            return false;
+        }
+        glm::vec3 invDirection = 1.f / direction;
+        bool found = false;
+        uint32_t stack[64];
+        int top = 0;
+        stack[top++] = 0;
+        while (top > 0) {
+            const Node& node = m_Nodes[stack[--top]];
+            if (!IntersectBox(node, origin, invDirection, hit.t)) {
+                continue;
+            }
+            if (node.count == 0) {
+                // The left child directly follows its parent
+                stack[top++] = node.offset;
+                stack[top++] = (uint32_t)(&node - m_Nodes.data()) + 1;
+                continue;
+            }
+            for (uint32_t i = node.offset; i < node.offset + node.count; i++) {
+                if (IntersectTriangle(m_Triangles[m_Order[i]], origin, direction, hit)) {
+                    hit.triangle = m_Order[i];
+                    found = true;
+                    if (ANY_HIT) {
+                        return true;
+                    }
+                }
+            }
+        }
+        return found;
+    }
+    static bool IntersectBox(const Node& node, const glm::vec3& origin, const glm::vec3& invDirection, float tMax) {
+        glm::vec3 t0 = (node.min - origin) * invDirection;
+        glm::vec3 t1 = (node.max - origin) * invDirection;
+        glm::vec3 tNear = glm::min(t0, t1), tFar = glm::max(t0, t1);
+        float enter = glm::max(glm::max(tNear.x, tNear.y), glm::max(tNear.z, 0.f));
+        float exit = glm::min(glm::min(tFar.x, tFar.y), glm::min(tFar.z, tMax));
+        return enter <= exit;
+    }
+    // Moller-Trumbore, updates hit when the triangle is closer than hit.t
+    static bool IntersectTriangle(const Triangle& triangle, const glm::vec3& origin, const glm::vec3& direction, Hit& hit) {
+        glm::vec3 p = glm::cross(direction, triangle.e2);
+        float det = glm::dot(triangle.e1, p);
+        if (std::abs(det) < 1e-12f) {
+            return false;
+        }
+        float invDet = 1.f / det;
+        glm::vec3 s = origin - triangle.p0;
+        float u = glm::dot(s, p) * invDet;
+        if (u < 0.f || u > 1.f) {
+            return false;
+        }
+        glm::vec3 q = glm::cross(s, triangle.e1);
+        float v = glm::dot(direction, q) * invDet;
+        if (v < 0.f || u + v > 1.f) {
+            return false;
+        }
+        float t = glm::dot(triangle.e2, q) * invDet;
+        if (t <= 0.f || t >= hit.t) {
+            return false;
+        }
+        hit.u = u;
+        hit.v = v;
+        hit.t = t;
+        return true;
+    }
+private:
+    std::vector<Node> m_Nodes;
+    std::vector<Triangle> m_Triangles;
+    // Triangle indices, every leaf owns a contiguous range
+    std::vector<uint32_t> m_Order;
+};
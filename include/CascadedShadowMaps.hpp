@@ -0,0 +1,226 @@
+#pragma once
+
+#include <Camera.hpp>
+#include <Shader.hpp>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+// The cascaded shadow maps class
+// Splits the camera frustum into depth ranges and renders a shadow map of the directional light for each into the
+// layers of a depth texture array. Every cascade covers the bounding sphere of its frustum slice so its size never
+// changes with the camera's rotation, and its center is snapped to whole shadow map texels so the shadows do not
+// shimmer while the camera moves.
+// Cascades from firstCachedCascade on are cached: they cover a margin around their slice and are only re-rendered
+// when the slice leaves the covered region, the light turns, Invalidate is called (static geometry changed) or a
+// dynamic caster touches them. Dynamic casters are reported every frame with AddDynamicCaster.
+// Usage every frame:
+//     AddDynamicCaster... Update, then for every cascade where NeedsRender: BeginCascade and draw the casters with
+//     GetLightViewProj, EndCascades, and finally Bind to the lighting shader.
+// Shader side:
+//     uShadowMap         sampler2DArrayShadow, one layer per cascade
+//     uShadowMatrices    mat4[MAX_CASCADES], world to shadow map texture space of each cascade
+//     uCascadeSplits     vec4, view depth where each cascade ends
+//     uCascadeCount      int
+class CascadedShadowMaps {
+public:
+    static constexpr int MAX_CASCADES = 4;
+    // Blend between logarithmic (1) and uniform (0) split distances
+    static constexpr float SPLIT_LAMBDA = .75f;
+    // Extra radius around the frustum slice that cached cascades cover so the camera can move without re-rendering them
+    static constexpr float CACHE_MARGIN = .25f;
+    ~CascadedShadowMaps() {
+        glDeleteFramebuffers(1, &m_Framebuffer);
+        glDeleteTextures(1, &m_DepthTexture);
+    }
+    /// <summary>Creates the shadow map array</summary>
+    /// <param name="resolution">Width and height of each cascade's shadow map</param>
+    /// <param name="cascadeCount">Number of cascades, up to MAX_CASCADES</param>
+    /// <param name="firstCachedCascade">The first cascade that is cached, the ones before it are rendered every frame</param>
+    static CascadedShadowMaps Create(int resolution = 2048, int cascadeCount = MAX_CASCADES, int firstCachedCascade = 2) {
+        return CascadedShadowMaps(resolution, std::clamp(cascadeCount, 1, MAX_CASCADES), firstCachedCascade);
+    }
+    // Reports a moving shadow caster's bounding sphere (center in xyz, radius in w) for the next Update
+    void AddDynamicCaster(const glm::vec4& sphere) {
+        m_DynamicCasters.push_back(sphere);
+    }
+    // Forces every cascade to be re-rendered, to be called when static geometry changes
+    void Invalidate() {
+        for (Cascade& cascade : m_Cascades) {
+            cascade.valid = false;
+        }
+    }
+    /// <summary>Fits the cascades to the camera frustum and decides which have to be re-rendered</summary>
+    /// <param name="fovY">Vertical field of view of the projection in radians</param>
+    /// <param name="aspect">Aspect ratio of the projection</param>
+    /// <param name="near">Near plane of the projection</param>
+    /// <param name="far">Distance up to which shadows are drawn</param>
+    /// <param name="lightDirection">Direction the directional light shines in</param>
+    void Update(const Camera& camera, float fovY, float aspect, float near, float far, const glm::vec3& lightDirection) {
+        glm::vec3 direction = glm::normalize(lightDirection);
+        if (direction != m_LightDirection) {
+            m_LightDirection = direction;
+            // A fixed orientation for the light so snapping works in the same texel grid every frame
+            glm::vec3 up = std::abs(direction.y) > .99f ? glm::vec3(0.f, 0.f, 1.f) : Camera::WORLD_UP;
+            m_LightView = glm::lookAt(glm::vec3(0.f), direction, up);
+            Invalidate();
+        }
+        // Squared distance from the view axis to a frustum corner, per unit of depth
+        float tanHalfFov = std::tan(fovY * .5f);
+        float k2 = tanHalfFov * tanHalfFov * (1.f + aspect * aspect);
+        float splitNear = near;
+        for (int i = 0; i < m_CascadeCount; i++) {
+            float t = (float)(i + 1) / m_CascadeCount;
+            float splitFar = SPLIT_LAMBDA * near * std::pow(far / near, t) + (1.f - SPLIT_LAMBDA) * (near + (far - near) * t);
+            m_Splits[i] = splitFar;
+            // The smallest sphere around the slice is centered on the view axis, equally far from both corner rings
+            float center = std::min((splitFar + splitNear) * (1.f + k2) * .5f, splitFar);
+            float radius = std::sqrt((splitFar - center) * (splitFar - center) + splitFar * splitFar * k2);
+            glm::vec3 worldCenter = camera.GetPosition() + camera.GetFront() * center;
+            UpdateCascade(i, glm::vec3(m_LightView * glm::vec4(worldCenter, 1.f)), radius);
+            splitNear = splitFar;
+        }
+        m_DynamicCasters.clear();
+    }
+    // Whether the cascade's shadow map has to be rendered this frame
+    bool NeedsRender(int cascade) const {
+        return m_Cascades[cascade].render;
+    }
+    // Binds and clears the cascade's layer for rendering the casters with a depth only shader
+    void BeginCascade(int cascade) {
+        glBindFramebuffer(GL_FRAMEBUFFER, m_Framebuffer);
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_DepthTexture, 0, cascade);
+        glViewport(0, 0, m_Resolution, m_Resolution);
+        glDepthMask(GL_TRUE);
+        glClear(GL_DEPTH_BUFFER_BIT);
+        // Casters in front of the cascade's near plane are flattened onto it instead of being clipped
+        glEnable(GL_DEPTH_CLAMP);
+        glEnable(GL_POLYGON_OFFSET_FILL);
+        glPolygonOffset(2.f, 4.f);
+        m_Cascades[cascade].render = false;
+        m_Cascades[cascade].valid = true;
+    }
+    // Restores the state changed by BeginCascade and binds the default framebuffer
+    void EndCascades(int width, int height) const {
+        glDisable(GL_POLYGON_OFFSET_FILL);
+        glDisable(GL_DEPTH_CLAMP);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(0, 0, width, height);
+    }
+    // The light's view projection matrix of a cascade, for rendering its casters
+    const glm::mat4& GetLightViewProj(int cascade) const {
+        return m_Cascades[cascade].viewProj;
+    }
+    // Binds the shadow maps to a texture unit and sets the shader's shadow uniforms
+    void Bind(const Shader& shader, unsigned int unit) const {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, m_DepthTexture);
+        shader.SetInt("uShadowMap", unit);
+        // From clip space to texture space
+        static const glm::mat4 BIAS = glm::translate(glm::mat4(1.f), glm::vec3(.5f)) * glm::scale(glm::mat4(1.f), glm::vec3(.5f));
+        for (int i = 0; i < m_CascadeCount; i++) {
+            char name[32];
+            snprintf(name, sizeof(name), "uShadowMatrices[%d]", i);
+            shader.SetMatrix4(name, BIAS * m_Cascades[i].viewProj);
+        }
+        shader.SetFloat4("uCascadeSplits", m_Splits);
+        shader.SetInt("uCascadeCount", m_CascadeCount);
+    }
+    int GetCascadeCount() const {
+        return m_CascadeCount;
+    }
+    GLuint GetDepthTexture() const {
+        return m_DepthTexture;
+    }
+private:
+    struct Cascade {
+        // The light space sphere the shadow map covers
+        glm::vec3 center{};
+        float radius{};
+        glm::mat4 viewProj{ 1.f };
+        bool valid{};
+        bool render{};
+        // Dynamic casters were drawn in the last render, their shadows have to be cleared
+        bool hadDynamicCasters{};
+    };
+    // Cascaded shadow maps constructor
+    CascadedShadowMaps(int resolution, int cascadeCount, int firstCachedCascade)
+        : m_Resolution(resolution), m_CascadeCount(cascadeCount), m_FirstCachedCascade(firstCachedCascade) {
+        glGenTextures(1, &m_DepthTexture);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, m_DepthTexture);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, m_Resolution, m_Resolution, m_CascadeCount, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+        // Hardware depth comparison with bilinear filtering of the results
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+        glGenFramebuffers(1, &m_Framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, m_Framebuffer);
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_DepthTexture, 0, 0);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+        if (status != GL_FRAMEBUFFER_COMPLETE) {
+            fprintf(stderr, "shadow map framebuffer incomplete (0x%x)\n", status);
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+    // Decides whether a cascade can keep its shadow map and refits it when it cannot
+    void UpdateCascade(int i, const glm::vec3& center, float radius) {
+        Cascade& cascade = m_Cascades[i];
+        bool cached = i >= m_FirstCachedCascade;
+        if (cached && cascade.valid) {
+            // The slice still has to be inside the region the shadow map covers
+            glm::vec3 offset = glm::abs(center - cascade.center);
+            bool covered = glm::max(offset.x, glm::max(offset.y, offset.z)) + radius <= cascade.radius;
+            bool dynamic = TouchesDynamicCaster(cascade);
+            cascade.render = !covered || dynamic || cascade.hadDynamicCasters;
+            if (covered) {
+                cascade.hadDynamicCasters = dynamic;
+                return;
+            }
+        }
+        cascade.render = true;
+        cascade.radius = cached ? radius * (1.f + CACHE_MARGIN) : radius;
+        // Snapping the center to the texel grid
+        float texel = 2.f * cascade.radius / m_Resolution;
+        cascade.center = glm::vec3(glm::floor(glm::vec2(center) / texel) * texel, center.z);
+        cascade.hadDynamicCasters = cached && TouchesDynamicCaster(cascade);
+        // The light looks down -z, casters up to a radius before the sphere still cast into it (depth clamp covers the rest)
+        glm::mat4 proj = glm::ortho(cascade.center.x - cascade.radius, cascade.center.x + cascade.radius,
+            cascade.center.y - cascade.radius, cascade.center.y + cascade.radius,
+            -cascade.center.z - 2.f * cascade.radius, -cascade.center.z + cascade.radius);
+        cascade.viewProj = proj * m_LightView;
+    }
+    // Whether a dynamic caster can throw a shadow into the cascade's region
+    bool TouchesDynamicCaster(const Cascade& cascade) const {
+        for (const glm::vec4& sphere : m_DynamicCasters) {
+            glm::vec3 center = glm::vec3(m_LightView * glm::vec4(glm::vec3(sphere), 1.f));
+            // Casters anywhere towards the light (+z in light space) shadow the region
+            if (std::abs(center.x - cascade.center.x) <= cascade.radius + sphere.w &&
+                std::abs(center.y - cascade.center.y) <= cascade.radius + sphere.w &&
+                center.z + sphere.w >= cascade.center.z - cascade.radius) {
+                return true;
+            }
+        }
+        return false;
+    }
+private:
+    int m_Resolution{};
+    int m_CascadeCount{};
+    int m_FirstCachedCascade{};
+    GLuint m_DepthTexture{};
+    GLuint m_Framebuffer{};
+    glm::vec3 m_LightDirection{};
+    glm::mat4 m_LightView{ 1.f };
+    Cascade m_Cascades[MAX_CASCADES];
+    glm::vec4 m_Splits{ 0.f };
+    std::vector<glm::vec4> m_DynamicCasters;
+};
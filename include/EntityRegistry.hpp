@@ -0,0 +1,329 @@
+#pragma once
+
+#include <JobSystem.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+// An entity is an index into the registry plus a generation that tells apart entities reusing the same index
+struct Entity {
+    uint32_t index = UINT32_MAX;
+    uint32_t generation = 0;
+    bool operator==(const Entity& other) const {
+        return index == other.index && generation == other.generation;
+    }
+    bool operator!=(const Entity& other) const {
+        return !(*this == other);
+    }
+};
+
+// The entity registry class
+// Entities with the same set of components (an archetype) are stored together in fixed size chunks, inside a
+// chunk every component type has its own tightly packed array. Queries walk the matching chunks linearly so
+// systems stream through exactly the data they need. Components must be trivially copyable.
+// Adding or removing components and entities while iterating is not allowed.
+class EntityRegistry {
+public:
+    static constexpr size_t CHUNK_SIZE = 16 * 1024;
+    static constexpr size_t MAX_COMPONENT_TYPES = 64;
+    EntityRegistry() = default;
+    EntityRegistry(const EntityRegistry&) = delete;
+    EntityRegistry& operator=(const EntityRegistry&) = delete;
+    // Creates an entity with the given components
+    template<typename... Ts>
+    Entity Create(const Ts&... components) {
+        Archetype& archetype = GetArchetype(MaskOf<Ts...>());
+        Entity entity = AllocateEntity();
+        size_t row = AddRow(archetype, entity);
+        (Store(archetype, row, components), ...);
+        m_Records[entity.index].archetype = &archetype;
+        m_Records[entity.index].row = row;
+        return entity;
+    }
+    // Destroys the entity and its components
+    void Destroy(Entity entity) {
+        if (!IsAlive(entity)) {
+            return;
+        }
+        EntityRecord& record = m_Records[entity.index];
+        RemoveRow(*record.archetype, record.row);
+        record.archetype = nullptr;
+        record.generation++;
+        m_FreeIndices.push_back(entity.index);
+    }
+    bool IsAlive(Entity entity) const {
+        return entity.index < m_Records.size() && m_Records[entity.index].generation == entity.generation && m_Records[entity.index].archetype != nullptr;
+    }
+    // Returns the component of the entity or nullptr if it does not have one
+    template<typename T>
+    T* Get(Entity entity) {
+        if (!IsAlive(entity)) {
+            return nullptr;
+        }
+        const EntityRecord& record = m_Records[entity.index];
+        size_t id = ComponentId<T>();
+        if ((record.archetype->mask & (uint64_t(1) << id)) == 0) {
+            return nullptr;
+        }
+        return reinterpret_cast<T*>(Element(*record.archetype, record.row, id));
+    }
+    template<typename T>
+    bool Has(Entity entity) {
+        return Get<T>(entity) != nullptr;
+    }
+    // Adds (or overwrites) a component, moving the entity to the archetype with the new set of components
+    template<typename T>
+    void Add(Entity entity, const T& component) {
+        if (T* existing = Get<T>(entity)) {
+            *existing = component;
+            return;
+        }
+        if (!IsAlive(entity)) {
+            return;
+        }
+        size_t row = MoveEntity(entity, m_Records[entity.index].archetype->mask | MaskOf<T>());
+        Store(*m_Records[entity.index].archetype, row, component);
+    }
+    // Removes a component, moving the entity to the archetype without it
+    template<typename T>
+    void Remove(Entity entity) {
+        if (Get<T>(entity) == nullptr) {
+            return;
+        }
+        MoveEntity(entity, m_Records[entity.index].archetype->mask & ~MaskOf<T>());
+    }
+    /// <summary>Calls func(size_t count, const Entity* entities, Ts*... components) for every chunk holding entities with all of Ts</summary>
+    /// <param name="func">Receives the arrays of a chunk, the arrays hold count elements</param>
+    template<typename... Ts, typename Func>
+    void ForEachChunk(Func&& func) {
+        uint64_t mask = MaskOf<Ts...>();
+        for (const std::unique_ptr<Archetype>& archetype : m_Archetypes) {
+            if ((archetype->mask & mask) != mask) {
+                continue;
+            }
+            for (size_t c = 0; c < archetype->chunks.size(); c++) {
+                CallChunk<Ts...>(*archetype, c, func);
+            }
+        }
+    }
+    // Calls func(Entity entity, Ts&... components) for every entity with all of Ts
+    template<typename... Ts, typename Func>
+    void Each(Func&& func) {
+        ForEachChunk<Ts...>([&func](size_t count, const Entity* entities, Ts*... components) {
+            for (size_t i = 0; i < count; i++) {
+                func(entities[i], components[i]...);
+            }
+        });
+    }
+    // Same as Each but chunks are processed in parallel, func must be safe to call from several threads
+    template<typename... Ts, typename Func>
+    void ParallelEach(JobSystem& jobSystem, Func&& func) {
+        uint64_t mask = MaskOf<Ts...>();
+        std::vector<std::pair<Archetype*, size_t>> chunks;
+        for (const std::unique_ptr<Archetype>& archetype : m_Archetypes) {
+            if ((archetype->mask & mask) == mask) {
+                for (size_t c = 0; c < archetype->chunks.size(); c++) {
+                    chunks.emplace_back(archetype.get(), c);
+                }
+            }
+        }
+        jobSystem.ParallelFor(chunks.size(), 1, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                CallChunk<Ts...>(*chunks[i].first, chunks[i].second, [&func](size_t count, const Entity* entities, Ts*... components) {
+                    for (size_t j = 0; j < count; j++) {
+                        func(entities[j], components[j]...);
+                    }
+                });
+            }
+        });
+    }
+    // Number of entities with all of Ts
+    template<typename... Ts>
+    size_t Count() {
+        uint64_t mask = MaskOf<Ts...>();
+        size_t count = 0;
+        for (const std::unique_ptr<Archetype>& archetype : m_Archetypes) {
+            if ((archetype->mask & mask) == mask) {
+                count += archetype->count;
+            }
+        }
+        return count;
+    }
+private:
+    struct alignas(64) Chunk {
+        uint8_t data[CHUNK_SIZE];
+    };
+    struct Archetype {
+        uint64_t mask = 0;
+        // Offset of each component's array inside a chunk, indexed by component id
+        size_t offsets[MAX_COMPONENT_TYPES]{};
+        // Rows per chunk
+        size_t capacity = 0;
+        size_t count = 0;
+        std::vector<std::unique_ptr<Chunk>> chunks;
+    };
+    struct EntityRecord {
+        Archetype* archetype = nullptr;
+        size_t row = 0;
+        uint32_t generation = 0;
+    };
+    struct ComponentInfo {
+        size_t size;
+        size_t alignment;
+    };
+    // Component types registered so far, indexed by component id
+    static std::vector<ComponentInfo>& GetComponentInfos() {
+        static std::vector<ComponentInfo> infos;
+        return infos;
+    }
+    // Assigns every component type a small id the first time it is used
+    template<typename T>
+    static size_t ComponentId() {
+        static_assert(std::is_trivially_copyable_v<T>, "components must be trivially copyable");
+        static const size_t id = [] {
+            std::vector<ComponentInfo>& infos = GetComponentInfos();
+            // Ids past the limit do not fit the masks or the archetypes' offsets
+            if (infos.size() >= MAX_COMPONENT_TYPES) {
+                fprintf(stderr, "too many component types (the maximum is %zu)\n", MAX_COMPONENT_TYPES);
+                std::abort();
+            }
+            infos.push_back({ sizeof(T), alignof(T) });
+            return infos.size() - 1;
+        }();
+        return id;
+    }
+    template<typename... Ts>
+    static uint64_t MaskOf() {
+        return (uint64_t(0) | ... | (uint64_t(1) << ComponentId<Ts>()));
+    }
+    // Finds or creates the archetype of a set of components and lays out its chunks
+    Archetype& GetArchetype(uint64_t mask) {
+        auto it = m_ArchetypeByMask.find(mask);
+        if (it != m_ArchetypeByMask.end()) {
+            return *it->second;
+        }
+        std::unique_ptr<Archetype> archetype = std::make_unique<Archetype>();
+        archetype->mask = mask;
+        const std::vector<ComponentInfo>& infos = GetComponentInfos();
+        size_t rowSize = sizeof(Entity);
+        for (size_t id = 0; id < infos.size(); id++) {
+            if (mask & (uint64_t(1) << id)) {
+                rowSize += infos[id].size;
+            }
+        }
+        // Shrinks the capacity until the arrays including their alignment padding fit in a chunk
+        for (size_t capacity = CHUNK_SIZE / rowSize; capacity > 0; capacity--) {
+            size_t offset = sizeof(Entity) * capacity;
+            for (size_t id = 0; id < infos.size(); id++) {
+                if (mask & (uint64_t(1) << id)) {
+                    offset = (offset + infos[id].alignment - 1) / infos[id].alignment * infos[id].alignment;
+                    archetype->offsets[id] = offset;
+                    offset += infos[id].size * capacity;
+                }
+            }
+            if (offset <= CHUNK_SIZE) {
+                archetype->capacity = capacity;
+                break;
+            }
+        }
+        // A single row would already be written past the end of the chunk
+        if (archetype->capacity == 0) {
+            fprintf(stderr, "components do not fit in a %zu byte chunk\n", CHUNK_SIZE);
+            std::abort();
+        }
+        Archetype& result = *archetype;
+        m_ArchetypeByMask[mask] = archetype.get();
+        m_Archetypes.emplace_back(std::move(archetype));
+        return result;
+    }
+    Entity AllocateEntity() {
+        Entity entity;
+        if (!m_FreeIndices.empty()) {
+            entity.index = m_FreeIndices.back();
+            m_FreeIndices.pop_back();
+        }
+        else {
+            entity.index = (uint32_t)m_Records.size();
+            m_Records.emplace_back();
+        }
+        entity.generation = m_Records[entity.index].generation;
+        return entity;
+    }
+    uint8_t* Element(Archetype& archetype, size_t row, size_t id) {
+        return archetype.chunks[row / archetype.capacity]->data + archetype.offsets[id] + GetComponentInfos()[id].size * (row % archetype.capacity);
+    }
+    Entity& EntityAt(Archetype& archetype, size_t row) {
+        return reinterpret_cast<Entity*>(archetype.chunks[row / archetype.capacity]->data)[row % archetype.capacity];
+    }
+    template<typename T>
+    void Store(Archetype& archetype, size_t row, const T& component) {
+        memcpy(Element(archetype, row, ComponentId<T>()), &component, sizeof(T));
+    }
+    // Appends a row for the entity, components are left for the caller to fill in
+    size_t AddRow(Archetype& archetype, Entity entity) {
+        size_t row = archetype.count++;
+        if (row / archetype.capacity >= archetype.chunks.size()) {
+            archetype.chunks.emplace_back(std::make_unique<Chunk>());
+        }
+        EntityAt(archetype, row) = entity;
+        return row;
+    }
+    // Removes a row by moving the last row into it so the archetype stays densely packed
+    void RemoveRow(Archetype& archetype, size_t row) {
+        size_t last = archetype.count - 1;
+        if (row != last) {
+            Entity moved = EntityAt(archetype, last);
+            EntityAt(archetype, row) = moved;
+            const std::vector<ComponentInfo>& infos = GetComponentInfos();
+            for (size_t id = 0; id < infos.size(); id++) {
+                if (archetype.mask & (uint64_t(1) << id)) {
+                    memcpy(Element(archetype, row, id), Element(archetype, last, id), infos[id].size);
+                }
+            }
+            m_Records[moved.index].row = row;
+        }
+        archetype.count--;
+        // Frees the last chunk once it is empty
+        if (archetype.count <= (archetype.chunks.size() - 1) * archetype.capacity) {
+            archetype.chunks.pop_back();
+        }
+    }
+    // Moves the entity to the archetype of mask keeping the components both archetypes share, returns the new row
+    size_t MoveEntity(Entity entity, uint64_t mask) {
+        EntityRecord& record = m_Records[entity.index];
+        Archetype& from = *record.archetype;
+        Archetype& to = GetArchetype(mask);
+        size_t row = AddRow(to, entity);
+        const std::vector<ComponentInfo>& infos = GetComponentInfos();
+        for (size_t id = 0; id < infos.size(); id++) {
+            if ((from.mask & to.mask) & (uint64_t(1) << id)) {
+                memcpy(Element(to, row, id), Element(from, record.row, id), infos[id].size);
+            }
+        }
+        RemoveRow(from, record.row);
+        record.archetype = &to;
+        record.row = row;
+        return row;
+    }
+    template<typename... Ts, typename Func>
+    void CallChunk(Archetype& archetype, size_t chunkIndex, Func&& func) {
+        size_t count = archetype.count - chunkIndex * archetype.capacity;
+        if (count > archetype.capacity) {
+            count = archetype.capacity;
+        }
+        uint8_t* data = archetype.chunks[chunkIndex]->data;
+        func(count, reinterpret_cast<const Entity*>(data), reinterpret_cast<Ts*>(data + archetype.offsets[ComponentId<Ts>()])...);
+    }
+private:
+    std::vector<std::unique_ptr<Archetype>> m_Archetypes;
+    std::unordered_map<uint64_t, Archetype*> m_ArchetypeByMask;
+    std::vector<EntityRecord> m_Records;
+    std::vector<uint32_t> m_FreeIndices;
+};
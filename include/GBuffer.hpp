@@ -0,0 +1,113 @@
+#pragma once
+
+#include <Shader.hpp>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstdio>
+
+// The g-buffer class
+// Holds the surface attributes written by the geometry pass of deferred shading in two compact targets:
+//     albedo/specular   RGBA8     albedo in rgb, specular intensity in a
+//     normal/shininess  RGB10_A2  octahedral encoded normal in rg, log2(shininess) / 11 in b
+// Positions are reconstructed from the depth buffer. The lighting passes add their results into an
+// accumulation target, half float so the lights can add up past 1 for the hdr pipeline. The depth is not attached
+// to it since the lighting shaders sample it (a feedback loop otherwise), light volumes test it in the shader.
+class GBuffer {
+public:
+    // Format of the light accumulation target
+    static constexpr GLenum ACCUMULATION_FORMAT = GL_RGBA16F;
+    ~GBuffer() {
+        glDeleteFramebuffers(1, &m_GeometryFramebuffer);
+        glDeleteFramebuffers(1, &m_LightFramebuffer);
+        glDeleteTextures(TARGET_COUNT, m_Textures);
+    }
+    // Creates the g-buffer with the size of the screen
+    static GBuffer Create(int width, int height) {
+        return GBuffer(width, height);
+    }
+    // Binds and clears the g-buffer for the geometry pass
+    void BindGeometryPass() const {
+        glBindFramebuffer(GL_FRAMEBUFFER, m_GeometryFramebuffer);
+        glViewport(0, 0, m_Width, m_Height);
+        glDepthMask(GL_TRUE);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    }
+    // Binds and clears the accumulation target for the lighting passes
+    void BindLightingPass() const {
+        glBindFramebuffer(GL_FRAMEBUFFER, m_LightFramebuffer);
+        glViewport(0, 0, m_Width, m_Height);
+        glClear(GL_COLOR_BUFFER_BIT);
+    }
+    // Binds the g-buffer textures starting at firstUnit and sets the uniforms the lighting shaders read them with
+    void BindTextures(const Shader& shader, unsigned int firstUnit) const {
+        static const char* const SAMPLERS[3] = { "uGAlbedoSpecular", "uGNormalShininess", "uGDepth" };
+        for (int i = 0; i < 3; i++) {
+            glActiveTexture(GL_TEXTURE0 + firstUnit + i);
+            glBindTexture(GL_TEXTURE_2D, m_Textures[i]);
+            shader.SetInt(SAMPLERS[i], firstUnit + i);
+        }
+        shader.SetFloat2("uScreenSize", { (float)m_Width, (float)m_Height });
+    }
+    // Copies the lit image and the depth to a framebuffer (the default one by default) and binds it so forward passes
+    // can draw on top, its depth format has to match the g-buffer's
+    void BlitTo(GLuint framebuffer = 0) const {
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, m_LightFramebuffer);
+        glBlitFramebuffer(0, 0, m_Width, m_Height, 0, 0, m_Width, m_Height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, m_GeometryFramebuffer);
+        glBlitFramebuffer(0, 0, m_Width, m_Height, 0, 0, m_Width, m_Height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    }
+    GLuint GetAccumulationTexture() const {
+        return m_Textures[ACCUMULATION];
+    }
+    GLuint GetDepthTexture() const {
+        return m_Textures[DEPTH];
+    }
+    GLuint GetLightFramebuffer() const {
+        return m_LightFramebuffer;
+    }
+private:
+    enum { ALBEDO_SPECULAR, NORMAL_SHININESS, DEPTH, ACCUMULATION, TARGET_COUNT };
+    // G-buffer constructor
+    GBuffer(int width, int height)
+        : m_Width(width), m_Height(height) {
+        static constexpr GLenum INTERNAL_FORMATS[TARGET_COUNT] = { GL_RGBA8, GL_RGB10_A2, GL_DEPTH24_STENCIL8, ACCUMULATION_FORMAT };
+        static constexpr GLenum FORMATS[TARGET_COUNT] = { GL_RGBA, GL_RGBA, GL_DEPTH_STENCIL, GL_RGBA };
+        static constexpr GLenum TYPES[TARGET_COUNT] = { GL_UNSIGNED_BYTE, GL_UNSIGNED_INT_2_10_10_10_REV, GL_UNSIGNED_INT_24_8, GL_FLOAT };
+        glGenTextures(TARGET_COUNT, m_Textures);
+        for (int i = 0; i < TARGET_COUNT; i++) {
+            glBindTexture(GL_TEXTURE_2D, m_Textures[i]);
+            glTexImage2D(GL_TEXTURE_2D, 0, INTERNAL_FORMATS[i], m_Width, m_Height, 0, FORMATS[i], TYPES[i], nullptr);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        }
+        glGenFramebuffers(1, &m_GeometryFramebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, m_GeometryFramebuffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_Textures[ALBEDO_SPECULAR], 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, m_Textures[NORMAL_SHININESS], 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, m_Textures[DEPTH], 0);
+        static constexpr GLenum DRAW_BUFFERS[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+        glDrawBuffers(2, DRAW_BUFFERS);
+        CheckFramebufferStatus("g-buffer");
+        glGenFramebuffers(1, &m_LightFramebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, m_LightFramebuffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_Textures[ACCUMULATION], 0);
+        CheckFramebufferStatus("light accumulation");
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+    static void CheckFramebufferStatus(const char* name) {
+        GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+        if (status != GL_FRAMEBUFFER_COMPLETE) {
+            fprintf(stderr, "%s framebuffer incomplete (0x%x)\n", name, status);
+        }
+    }
+private:
+    GLuint m_GeometryFramebuffer{};
+    GLuint m_LightFramebuffer{};
+    GLuint m_Textures[TARGET_COUNT]{};
+    int m_Width{}, m_Height{};
+};
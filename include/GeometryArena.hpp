@@ -0,0 +1,226 @@
+#pragma once
+
+#include <RangeAllocator.hpp>
+#include <VertexFormat.hpp>
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+// The geometry arena class
+// Keeps the meshes of one vertex format in one big vertex buffer and one big index buffer behind a single vertex
+// array. Meshes are suballocated with a free list each and drawn with a base vertex, so indices stay relative to
+// their mesh (16 bit indices are enough for meshes of up to 65536 vertices) and switching meshes needs no vertex
+// array or buffer binds. When an allocation does not fit the live meshes are compacted into fresh buffers on the
+// gpu (glCopyBufferSubData), which also grows them if compacting alone does not free enough space.
+class GeometryArena {
+public:
+    // Handle of a mesh in the arena, stays valid across defragmentation
+    using MeshHandle = uint32_t;
+    static constexpr MeshHandle INVALID_MESH = UINT32_MAX;
+    // Where a mesh lives in the arena's buffers, in vertices and indices
+    struct Mesh {
+        uint32_t baseVertex;
+        uint32_t vertexCount;
+        uint32_t firstIndex;
+        uint32_t indexCount;
+    };
+    ~GeometryArena() {
+        glDeleteVertexArrays(1, &m_Vao);
+        glDeleteBuffers(1, &m_Vbo);
+        glDeleteBuffers(1, &m_Ebo);
+    }
+    /// <summary>Creates an empty arena</summary>
+    /// <param name="vertexCapacity">Vertices the vertex buffer starts with</param>
+    /// <param name="indexCapacity">Indices the index buffer starts with</param>
+    /// <param name="indexType">GL_UNSIGNED_SHORT or GL_UNSIGNED_INT for all meshes</param>
+    static GeometryArena Create(const VertexFormat& format, uint32_t vertexCapacity, uint32_t indexCapacity, GLenum indexType = GL_UNSIGNED_SHORT) {
+        return GeometryArena(format, vertexCapacity, indexCapacity, indexType);
+    }
+    /// <summary>Uploads a mesh into the arena</summary>
+    /// <param name="vertices">vertexCount vertices laid out in the arena's format</param>
+    /// <param name="indices">Indices relative to the mesh's first vertex</param>
+    MeshHandle Add(const void* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount) {
+        if (vertexCount == 0 || indexCount == 0) {
+            return INVALID_MESH;
+        }
+        if (m_IndexType == GL_UNSIGNED_SHORT && vertexCount > 0x10000) {
+            fprintf(stderr, "mesh of %u vertices does not fit 16 bit indices\n", vertexCount);
+            return INVALID_MESH;
+        }
+        uint32_t baseVertex = m_Vertices.Allocate(vertexCount);
+        uint32_t firstIndex = m_Indices.Allocate(indexCount);
+        if (baseVertex == RangeAllocator::INVALID_OFFSET || firstIndex == RangeAllocator::INVALID_OFFSET) {
+            m_Vertices.Free(baseVertex, vertexCount);
+            m_Indices.Free(firstIndex, indexCount);
+            // Compacting is enough when the free space is there but in pieces, the buffers grow otherwise
+            uint32_t vertexCapacity = m_Vertices.GetCapacity(), indexCapacity = m_Indices.GetCapacity();
+            if (m_Vertices.GetFreeSize() < vertexCount) {
+                vertexCapacity = std::max(vertexCapacity * 2, vertexCapacity - m_Vertices.GetFreeSize() + vertexCount);
+            }
+            if (m_Indices.GetFreeSize() < indexCount) {
+                indexCapacity = std::max(indexCapacity * 2, indexCapacity - m_Indices.GetFreeSize() + indexCount);
+            }
+            Reallocate(vertexCapacity, indexCapacity);
+            baseVertex = m_Vertices.Allocate(vertexCount);
+            firstIndex = m_Indices.Allocate(indexCount);
+        }
+        glBindBuffer(GL_COPY_WRITE_BUFFER, m_Vbo);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)baseVertex * m_Format.GetStride(), (GLsizeiptr)vertexCount * m_Format.GetStride(), vertices);
+        std::vector<char> packed(indexCount * m_IndexSize);
+        for (uint32_t i = 0; i < indexCount; i++) {
+            if (m_IndexType == GL_UNSIGNED_SHORT) {
+                uint16_t index = (uint16_t)indices[i];
+                memcpy(packed.data() + i * 2, &index, 2);
+            }
+            else {
+                memcpy(packed.data() + i * 4, &indices[i], 4);
+            }
+        }
+        glBindBuffer(GL_COPY_WRITE_BUFFER, m_Ebo);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)firstIndex * m_IndexSize, (GLsizeiptr)packed.size(), packed.data());
+        MeshHandle handle;
+        if (!m_FreeHandles.empty()) {
+            handle = m_FreeHandles.back();
+            m_FreeHandles.pop_back();
+        }
+        else {
+            handle = (MeshHandle)m_Meshes.size();
+            m_Meshes.emplace_back();
+            m_Live.push_back(false);
+        }
+        m_Meshes[handle] = { baseVertex, vertexCount, firstIndex, indexCount };
+        m_Live[handle] = true;
+        return handle;
+    }
+    // Frees a mesh's space, the handle may be reused by a later Add
+    void Remove(MeshHandle handle) {
+        if (handle >= m_Meshes.size() || !m_Live[handle]) {
+            return;
+        }
+        const Mesh& mesh = m_Meshes[handle];
+        m_Vertices.Free(mesh.baseVertex, mesh.vertexCount);
+        m_Indices.Free(mesh.firstIndex, mesh.indexCount);
+        m_Live[handle] = false;
+        m_FreeHandles.push_back(handle);
+    }
+    // Binds the vertex array all meshes are drawn with, instance attributes can be added to it
+    void Bind() const {
+        glBindVertexArray(m_Vao);
+    }
+    // Draws a mesh, the arena has to be bound
+    void Draw(MeshHandle handle, GLsizei instanceCount = 1) const {
+        const Mesh& mesh = m_Meshes[handle];
+        glDrawElementsInstancedBaseVertex(GL_TRIANGLES, (GLsizei)mesh.indexCount, m_IndexType,
+            reinterpret_cast<const void*>((uintptr_t)mesh.firstIndex * m_IndexSize), instanceCount, (GLint)mesh.baseVertex);
+    }
+    // Moves the live meshes to the start of the buffers so the free space is in one piece
+    void Defragment() {
+        Reallocate(m_Vertices.GetCapacity(), m_Indices.GetCapacity());
+    }
+    const Mesh& GetMesh(MeshHandle handle) const {
+        return m_Meshes[handle];
+    }
+    GLenum GetIndexType() const {
+        return m_IndexType;
+    }
+    const VertexFormat& GetFormat() const {
+        return m_Format;
+    }
+    const RangeAllocator& GetVertexAllocator() const {
+        return m_Vertices;
+    }
+    const RangeAllocator& GetIndexAllocator() const {
+        return m_Indices;
+    }
+    GLuint GetVertexBuffer() const {
+        return m_Vbo;
+    }
+    GLuint GetIndexBuffer() const {
+        return m_Ebo;
+    }
+private:
+    // Geometry arena constructor
+    GeometryArena(const VertexFormat& format, uint32_t vertexCapacity, uint32_t indexCapacity, GLenum indexType)
+        : m_Format(format), m_IndexType(indexType), m_IndexSize(indexType == GL_UNSIGNED_SHORT ? 2 : 4),
+        m_Vertices(vertexCapacity), m_Indices(indexCapacity) {
+        glGenVertexArrays(1, &m_Vao);
+        glGenBuffers(1, &m_Vbo);
+        glGenBuffers(1, &m_Ebo);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, m_Vbo);
+        glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)vertexCapacity * m_Format.GetStride(), nullptr, GL_STATIC_DRAW);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, m_Ebo);
+        glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)indexCapacity * m_IndexSize, nullptr, GL_STATIC_DRAW);
+        AttachBuffers();
+    }
+    // Points the vertex array at the current buffers, instance attributes set up by the user are left alone
+    void AttachBuffers() {
+        GLint previous;
+        glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &previous);
+        glBindVertexArray(m_Vao);
+        glBindBuffer(GL_ARRAY_BUFFER, m_Vbo);
+        m_Format.Apply();
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_Ebo);
+        glBindVertexArray((GLuint)previous);
+    }
+    // Copies the live meshes packed in offset order into new buffers of the given capacities
+    void Reallocate(uint32_t vertexCapacity, uint32_t indexCapacity) {
+        GLuint buffers[2];
+        glGenBuffers(2, buffers);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffers[0]);
+        glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)vertexCapacity * m_Format.GetStride(), nullptr, GL_STATIC_DRAW);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffers[1]);
+        glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)indexCapacity * m_IndexSize, nullptr, GL_STATIC_DRAW);
+        // Keeping the order of the meshes keeps the copies mostly sequential
+        std::vector<MeshHandle> order;
+        for (MeshHandle handle = 0; handle < m_Meshes.size(); handle++) {
+            if (m_Live[handle]) {
+                order.push_back(handle);
+            }
+        }
+        std::sort(order.begin(), order.end(), [&](MeshHandle a, MeshHandle b) {
+            return m_Meshes[a].baseVertex < m_Meshes[b].baseVertex;
+        });
+        uint32_t vertexEnd = 0, indexEnd = 0;
+        glBindBuffer(GL_COPY_READ_BUFFER, m_Vbo);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffers[0]);
+        for (MeshHandle handle : order) {
+            Mesh& mesh = m_Meshes[handle];
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, (GLintptr)mesh.baseVertex * m_Format.GetStride(),
+                (GLintptr)vertexEnd * m_Format.GetStride(), (GLsizeiptr)mesh.vertexCount * m_Format.GetStride());
+            mesh.baseVertex = vertexEnd;
+            vertexEnd += mesh.vertexCount;
+        }
+        glBindBuffer(GL_COPY_READ_BUFFER, m_Ebo);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffers[1]);
+        for (MeshHandle handle : order) {
+            Mesh& mesh = m_Meshes[handle];
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, (GLintptr)mesh.firstIndex * m_IndexSize,
+                (GLintptr)indexEnd * m_IndexSize, (GLsizeiptr)mesh.indexCount * m_IndexSize);
+            mesh.firstIndex = indexEnd;
+            indexEnd += mesh.indexCount;
+        }
+        glDeleteBuffers(1, &m_Vbo);
+        glDeleteBuffers(1, &m_Ebo);
+        m_Vbo = buffers[0];
+        m_Ebo = buffers[1];
+        m_Vertices.Reset(vertexEnd, vertexCapacity);
+        m_Indices.Reset(indexEnd, indexCapacity);
+        AttachBuffers();
+    }
+private:
+    VertexFormat m_Format;
+    GLenum m_IndexType;
+    uint32_t m_IndexSize;
+    RangeAllocator m_Vertices;
+    RangeAllocator m_Indices;
+    GLuint m_Vao{};
+    GLuint m_Vbo{};
+    GLuint m_Ebo{};
+    std::vector<Mesh> m_Meshes;
+    std::vector<bool> m_Live;
+    std::vector<MeshHandle> m_FreeHandles;
+};
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstdint>
+
+// The gpu timer class
+// Measures how long the gpu takes to execute the commands between Begin and End with timer queries. Every
+// measurement gets its own query from a small ring and is read back when that query comes around again,
+// by then the gpu has long finished it so reading never stalls the cpu. Timers must not be nested.
+class GpuTimer {
+public:
+    // Measurements in flight, more than the frames the driver queues up
+    static constexpr int QUERY_COUNT = 5;
+    ~GpuTimer() {
+        glDeleteQueries(QUERY_COUNT, m_Queries);
+    }
+    // Creates the timer's queries
+    static GpuTimer Create() {
+        return GpuTimer();
+    }
+    // Starts a measurement, collecting the result of the oldest one first
+    void Begin() {
+        if (m_Pending[m_Next]) {
+            GLuint64 nanoseconds;
+            glGetQueryObjectui64v(m_Queries[m_Next], GL_QUERY_RESULT, &nanoseconds);
+            m_TotalNanoseconds += nanoseconds;
+            m_SampleCount++;
+            m_Pending[m_Next] = false;
+        }
+        glBeginQuery(GL_TIME_ELAPSED, m_Queries[m_Next]);
+    }
+    void End() {
+        glEndQuery(GL_TIME_ELAPSED);
+        m_Pending[m_Next] = true;
+        m_Next = (m_Next + 1) % QUERY_COUNT;
+    }
+    // Average milliseconds of the measurements collected since the last Reset
+    double GetAverageMs() const {
+        return m_SampleCount > 0 ? (double)m_TotalNanoseconds / m_SampleCount * 1e-6 : 0.;
+    }
+    uint64_t GetSampleCount() const {
+        return m_SampleCount;
+    }
+    // Starts a new average, measurements still in flight are dropped
+    void Reset() {
+        for (bool& pending : m_Pending) {
+            pending = false;
+        }
+        m_TotalNanoseconds = 0;
+        m_SampleCount = 0;
+    }
+private:
+    // Gpu timer constructor
+    GpuTimer() {
+        glGenQueries(QUERY_COUNT, m_Queries);
+    }
+private:
+    GLuint m_Queries[QUERY_COUNT]{};
+    bool m_Pending[QUERY_COUNT]{};
+    int m_Next{};
+    uint64_t m_TotalNanoseconds{};
+    uint64_t m_SampleCount{};
+};
@@ -0,0 +1,192 @@
+#pragma once
+
+#include <Shader.hpp>
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+// The hdr pipeline class
+// Lets the scene be rendered into a half float target so adding up lights does not clip, then maps it to the screen.
+// Auto exposure follows the average log luminance of the scene: a first pass writes the log luminance into a power
+// of two target, then every pass halves it (a single bilinear tap averages 2x2 texels) down to one texel. The
+// exposure adapts towards that average over time in a 1x1 target, everything stays on the gpu so nothing stalls.
+// The tonemap pass of a frame uses the luminance adapted up to the previous frame.
+// Shader side:
+//     luminance_frag.glsl   uScene, uTargetSize
+//     downsample_frag.glsl  uSource, uTargetSize
+//     adapt_frag.glsl       uAverageLogLuminance, uPreviousLuminance, uAdaptation
+//     tonemap_frag.glsl     uScene, uAdaptedLuminance, uKey
+class HdrPipeline {
+public:
+    static constexpr GLenum SCENE_FORMAT = GL_RGBA16F;
+    // The scene's average luminance is exposed to this middle grey
+    static constexpr float DEFAULT_KEY = .18f;
+    // Rate at which the exposure follows the scene, per second
+    static constexpr float DEFAULT_ADAPTATION_SPEED = 1.5f;
+    ~HdrPipeline() {
+        glDeleteFramebuffers(1, &m_SceneFramebuffer);
+        glDeleteTextures(1, &m_SceneColor);
+        glDeleteTextures(1, &m_SceneDepth);
+        glDeleteFramebuffers((GLsizei)m_LuminanceFramebuffers.size(), m_LuminanceFramebuffers.data());
+        glDeleteTextures((GLsizei)m_LuminanceTextures.size(), m_LuminanceTextures.data());
+        glDeleteFramebuffers(2, m_AdaptedFramebuffers);
+        glDeleteTextures(2, m_AdaptedTextures);
+        glDeleteVertexArrays(1, &m_EmptyVao);
+    }
+    // Creates the scene target with the size of the screen and the luminance chain
+    static HdrPipeline Create(int width, int height) {
+        return HdrPipeline(width, height);
+    }
+    // Binds and clears the scene target, everything drawn until Tonemap is in linear hdr
+    void BindSceneTarget() const {
+        glBindFramebuffer(GL_FRAMEBUFFER, m_SceneFramebuffer);
+        glViewport(0, 0, m_Width, m_Height);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    }
+    // Exposes and tonemaps the scene into the default framebuffer
+    void Tonemap(const Shader& tonemapShader) const {
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(0, 0, m_Width, m_Height);
+        glDisable(GL_DEPTH_TEST);
+        tonemapShader.UseProgram();
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, m_SceneColor);
+        tonemapShader.SetInt("uScene", 0);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, m_AdaptedTextures[m_Adapted]);
+        tonemapShader.SetInt("uAdaptedLuminance", 1);
+        tonemapShader.SetFloat("uKey", m_Key);
+        glBindVertexArray(m_EmptyVao);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glEnable(GL_DEPTH_TEST);
+    }
+    /// <summary>Reduces the scene to its average log luminance and adapts the exposure towards it</summary>
+    /// <param name="deltaTime">Seconds since the last measurement</param>
+    void MeasureLuminance(const Shader& luminanceShader, const Shader& downsampleShader, const Shader& adaptShader, float deltaTime) {
+        glDisable(GL_DEPTH_TEST);
+        glBindVertexArray(m_EmptyVao);
+        glActiveTexture(GL_TEXTURE0);
+        for (size_t i = 0; i < m_LuminanceTextures.size(); i++) {
+            const Shader& shader = i == 0 ? luminanceShader : downsampleShader;
+            shader.UseProgram();
+            glBindTexture(GL_TEXTURE_2D, i == 0 ? m_SceneColor : m_LuminanceTextures[i - 1]);
+            shader.SetInt(i == 0 ? "uScene" : "uSource", 0);
+            shader.SetFloat2("uTargetSize", { (float)m_LuminanceSizes[i].x, (float)m_LuminanceSizes[i].y });
+            glBindFramebuffer(GL_FRAMEBUFFER, m_LuminanceFramebuffers[i]);
+            glViewport(0, 0, m_LuminanceSizes[i].x, m_LuminanceSizes[i].y);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+        }
+        // The new adapted luminance is written to the other target so the previous one can be read
+        adaptShader.UseProgram();
+        glBindTexture(GL_TEXTURE_2D, m_LuminanceTextures.back());
+        adaptShader.SetInt("uAverageLogLuminance", 0);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, m_AdaptedTextures[m_Adapted]);
+        adaptShader.SetInt("uPreviousLuminance", 1);
+        adaptShader.SetFloat("uAdaptation", 1.f - std::exp(-deltaTime * m_AdaptationSpeed));
+        m_Adapted = 1 - m_Adapted;
+        glBindFramebuffer(GL_FRAMEBUFFER, m_AdaptedFramebuffers[m_Adapted]);
+        glViewport(0, 0, 1, 1);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(0, 0, m_Width, m_Height);
+        glEnable(GL_DEPTH_TEST);
+    }
+    void SetKey(float key) {
+        m_Key = key;
+    }
+    void SetAdaptationSpeed(float speed) {
+        m_AdaptationSpeed = speed;
+    }
+    GLuint GetSceneFramebuffer() const {
+        return m_SceneFramebuffer;
+    }
+    GLuint GetSceneTexture() const {
+        return m_SceneColor;
+    }
+private:
+    // Hdr pipeline constructor
+    HdrPipeline(int width, int height)
+        : m_Width(width), m_Height(height) {
+        glGenTextures(1, &m_SceneColor);
+        CreateTexture(m_SceneColor, SCENE_FORMAT, width, height, GL_RGBA, GL_FLOAT, nullptr, GL_NEAREST);
+        glGenTextures(1, &m_SceneDepth);
+        CreateTexture(m_SceneDepth, GL_DEPTH24_STENCIL8, width, height, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, nullptr, GL_NEAREST);
+        glGenFramebuffers(1, &m_SceneFramebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, m_SceneFramebuffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_SceneColor, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, m_SceneDepth, 0);
+        CheckFramebufferStatus("hdr scene");
+        // The first level is the largest power of two at most half the screen, each following level halves it
+        glm::ivec2 size{ FloorPowerOfTwo(std::max(width / 2, 1)), FloorPowerOfTwo(std::max(height / 2, 1)) };
+        while (true) {
+            m_LuminanceSizes.push_back(size);
+            if (size.x == 1 && size.y == 1) {
+                break;
+            }
+            size = glm::max(size / 2, glm::ivec2(1));
+        }
+        m_LuminanceTextures.resize(m_LuminanceSizes.size());
+        m_LuminanceFramebuffers.resize(m_LuminanceSizes.size());
+        glGenTextures((GLsizei)m_LuminanceTextures.size(), m_LuminanceTextures.data());
+        glGenFramebuffers((GLsizei)m_LuminanceFramebuffers.size(), m_LuminanceFramebuffers.data());
+        for (size_t i = 0; i < m_LuminanceTextures.size(); i++) {
+            CreateTexture(m_LuminanceTextures[i], GL_R16F, m_LuminanceSizes[i].x, m_LuminanceSizes[i].y, GL_RED, GL_FLOAT, nullptr, GL_LINEAR);
+            glBindFramebuffer(GL_FRAMEBUFFER, m_LuminanceFramebuffers[i]);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_LuminanceTextures[i], 0);
+            CheckFramebufferStatus("luminance");
+        }
+        // Starting at the key keeps the first frames at an exposure of 1
+        glGenTextures(2, m_AdaptedTextures);
+        glGenFramebuffers(2, m_AdaptedFramebuffers);
+        for (int i = 0; i < 2; i++) {
+            CreateTexture(m_AdaptedTextures[i], GL_R32F, 1, 1, GL_RED, GL_FLOAT, &DEFAULT_KEY, GL_NEAREST);
+            glBindFramebuffer(GL_FRAMEBUFFER, m_AdaptedFramebuffers[i]);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_AdaptedTextures[i], 0);
+            CheckFramebufferStatus("adapted luminance");
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        // Fullscreen passes generate their vertices but a vertex array still has to be bound
+        glGenVertexArrays(1, &m_EmptyVao);
+    }
+    static void CreateTexture(GLuint texture, GLenum internalFormat, int width, int height, GLenum format, GLenum type, const void* data, GLint filter) {
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, data);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+    static int FloorPowerOfTwo(int value) {
+        int power = 1;
+        while (power * 2 <= value) {
+            power *= 2;
+        }
+        return power;
+    }
+    static void CheckFramebufferStatus(const char* name) {
+        GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+        if (status != GL_FRAMEBUFFER_COMPLETE) {
+            fprintf(stderr, "%s framebuffer incomplete (0x%x)\n", name, status);
+        }
+    }
+private:
+    int m_Width{}, m_Height{};
+    float m_Key{ DEFAULT_KEY };
+    float m_AdaptationSpeed{ DEFAULT_ADAPTATION_SPEED };
+    GLuint m_SceneFramebuffer{};
+    GLuint m_SceneColor{};
+    GLuint m_SceneDepth{};
+    // The reduction chain from the first log luminance level down to 1x1
+    std::vector<glm::ivec2> m_LuminanceSizes;
+    std::vector<GLuint> m_LuminanceTextures;
+    std::vector<GLuint> m_LuminanceFramebuffers;
+    // Ping-ponged 1x1 targets of the adapted luminance, m_Adapted is the latest
+    GLuint m_AdaptedTextures[2]{};
+    GLuint m_AdaptedFramebuffers[2]{};
+    int m_Adapted{};
+    GLuint m_EmptyVao{};
+};
@@ -0,0 +1,226 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Counts the unfinished jobs of a group, jobs can depend on a counter reaching zero
+class JobCounter {
+public:
+    // Returns true when every job tied to this counter has finished
+    bool IsDone() const {
+        return m_Count.load(std::memory_order_acquire) == 0;
+    }
+private:
+    friend class JobSystem;
+    std::atomic<int> m_Count{ 0 };
+    // Guards the last decrement so the counter is not destroyed while the finishing job still uses it
+    mutable std::mutex m_Mutex;
+    // Jobs waiting for this counter to reach zero
+    std::vector<std::function<void()>> m_Continuations;
+};
+
+// The job system class
+// Runs jobs on one worker thread per core. Every thread owns a deque, it pushes and pops its own jobs
+// at the back while idle threads steal from the front of the others, so work spreads without a global queue.
+// Threads waiting on a counter execute jobs instead of blocking.
+class JobSystem {
+public:
+    /// <summary>Starts the worker threads</summary>
+    /// <param name="workerCount">Number of worker threads, 0 uses one per core minus the calling thread</param>
+    explicit JobSystem(unsigned int workerCount = 0) {
+        if (workerCount == 0) {
+            unsigned int cores = std::thread::hardware_concurrency();
+            workerCount = cores > 1 ? cores - 1 : 1;
+        }
+        // Queue 0 belongs to the thread that created the job system (and any thread that is not a worker)
+        for (unsigned int i = 0; i <= workerCount; i++) {
+            m_Queues.emplace_back(std::make_unique<WorkQueue>());
+        }
+        s_Owner = this;
+        s_ThreadIndex = 0;
+        for (unsigned int i = 1; i <= workerCount; i++) {
+            m_Workers.emplace_back([this, i]() { WorkerLoop(i); });
+        }
+    }
+    ~JobSystem() {
+        {
+            std::lock_guard<std::mutex> lock{ m_WakeMutex };
+            m_Stop = true;
+        }
+        m_WakeCondition.notify_all();
+        for (std::thread& worker : m_Workers) {
+            worker.join();
+        }
+        if (s_Owner == this) {
+            s_Owner = nullptr;
+        }
+    }
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+    /// <summary>Schedules a job</summary>
+    /// <param name="job">The work to run</param>
+    /// <param name="counter">Optional counter incremented now and decremented when the job finishes</param>
+    void Schedule(std::function<void()> job, JobCounter* counter = nullptr) {
+        if (counter != nullptr) {
+            counter->m_Count.fetch_add(1, std::memory_order_relaxed);
+        }
+        Push(Wrap(std::move(job), counter));
+    }
+    /// <summary>Schedules a job that only starts once dependency has reached zero</summary>
+    /// <param name="job">The work to run</param>
+    /// <param name="dependency">The counter to wait for</param>
+    /// <param name="counter">Optional counter incremented now and decremented when the job finishes</param>
+    void Schedule(std::function<void()> job, JobCounter& dependency, JobCounter* counter = nullptr) {
+        if (counter != nullptr) {
+            counter->m_Count.fetch_add(1, std::memory_order_relaxed);
+        }
+        std::function<void()> wrapped = Wrap(std::move(job), counter);
+        {
+            std::lock_guard<std::mutex> lock{ dependency.m_Mutex };
+            if (!dependency.IsDone()) {
+                dependency.m_Continuations.emplace_back(std::move(wrapped));
+                return;
+            }
+        }
+        Push(std::move(wrapped));
+    }
+    // Runs jobs on the calling thread until the counter reaches zero
+    void Wait(const JobCounter& counter) {
+        while (!counter.IsDone()) {
+            if (!RunOne()) {
+                std::this_thread::yield();
+            }
+        }
+        // The job that finished last may still hold the lock, once released the counter can be destroyed
+        std::lock_guard<std::mutex> lock{ counter.m_Mutex };
+    }
+    /// <summary>Splits [0, count) into chunks of grainSize and runs func(begin, end) on each in parallel, returns when all are done</summary>
+    /// <param name="count">Number of elements</param>
+    /// <param name="grainSize">Elements per job, 0 picks a size giving each thread a few chunks</param>
+    /// <param name="func">Callable taking the half open range (size_t begin, size_t end)</param>
+    template<typename Func>
+    void ParallelFor(size_t count, size_t grainSize, Func&& func) {
+        if (count == 0) {
+            return;
+        }
+        if (grainSize == 0) {
+            // A few chunks per thread balances uneven chunks without drowning in scheduling overhead
+            grainSize = std::max<size_t>(1, count / (GetThreadCount() * 4));
+        }
+        if (count <= grainSize) {
+            func(size_t{ 0 }, count);
+            return;
+        }
+        JobCounter counter;
+        // The calling thread runs the first chunk itself
+        for (size_t begin = grainSize; begin < count; begin += grainSize) {
+            size_t end = std::min(begin + grainSize, count);
+            Schedule([&func, begin, end]() { func(begin, end); }, &counter);
+        }
+        func(size_t{ 0 }, grainSize);
+        Wait(counter);
+    }
+    // Number of threads executing jobs, including the one that created the job system
+    size_t GetThreadCount() const {
+        return m_Queues.size();
+    }
+private:
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> jobs;
+    };
+    // Decrements the counter once the job is done and releases the jobs depending on it
+    std::function<void()> Wrap(std::function<void()> job, JobCounter* counter) {
+        if (counter == nullptr) {
+            return job;
+        }
+        return [this, job = std::move(job), counter]() {
+            job();
+            std::vector<std::function<void()>> continuations;
+            {
+                std::lock_guard<std::mutex> lock{ counter->m_Mutex };
+                if (counter->m_Count.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    continuations.swap(counter->m_Continuations);
+                }
+            }
+            for (std::function<void()>& continuation : continuations) {
+                Push(std::move(continuation));
+            }
+        };
+    }
+    // Pushes a job onto the calling thread's queue and wakes a sleeping worker
+    void Push(std::function<void()> job) {
+        WorkQueue& queue = *m_Queues[GetQueueIndex()];
+        {
+            std::lock_guard<std::mutex> lock{ queue.mutex };
+            queue.jobs.emplace_back(std::move(job));
+        }
+        {
+            std::lock_guard<std::mutex> lock{ m_WakeMutex };
+            m_PendingJobs++;
+        }
+        m_WakeCondition.notify_one();
+    }
+    // Pops a job from the calling thread's queue or steals one from another thread, returns false if none was found
+    bool RunOne() {
+        size_t index = GetQueueIndex();
+        std::function<void()> job;
+        {
+            WorkQueue& queue = *m_Queues[index];
+            std::lock_guard<std::mutex> lock{ queue.mutex };
+            if (!queue.jobs.empty()) {
+                job = std::move(queue.jobs.back());
+                queue.jobs.pop_back();
+            }
+        }
+        for (size_t i = 1; !job && i < m_Queues.size(); i++) {
+            WorkQueue& victim = *m_Queues[(index + i) % m_Queues.size()];
+            std::lock_guard<std::mutex> lock{ victim.mutex };
+            if (!victim.jobs.empty()) {
+                job = std::move(victim.jobs.front());
+                victim.jobs.pop_front();
+            }
+        }
+        if (!job) {
+            return false;
+        }
+        m_PendingJobs.fetch_sub(1, std::memory_order_relaxed);
+        job();
+        return true;
+    }
+    void WorkerLoop(unsigned int index) {
+        s_Owner = this;
+        s_ThreadIndex = index;
+        while (true) {
+            if (RunOne()) {
+                continue;
+            }
+            std::unique_lock<std::mutex> lock{ m_WakeMutex };
+            m_WakeCondition.wait(lock, [this]() { return m_Stop || m_PendingJobs.load(std::memory_order_relaxed) > 0; });
+            if (m_Stop) {
+                return;
+            }
+        }
+    }
+    // Threads that are not workers of this job system share queue 0
+    size_t GetQueueIndex() const {
+        return s_Owner == this ? s_ThreadIndex : 0;
+    }
+private:
+    std::vector<std::unique_ptr<WorkQueue>> m_Queues;
+    std::vector<std::thread> m_Workers;
+    std::mutex m_WakeMutex;
+    std::condition_variable m_WakeCondition;
+    std::atomic<int> m_PendingJobs{ 0 };
+    bool m_Stop{};
+    static inline thread_local const JobSystem* s_Owner = nullptr;
+    static inline thread_local size_t s_ThreadIndex = 0;
+};
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <JobSystem.hpp>
+#include <Shader.hpp>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <vector>
+
+// The light assignment class
+// Gives every object of a forward pass only the few point lights that matter most to it. Lights whose influence
+// radius does not reach an object's bounding sphere are skipped, the rest are ranked by the light's brightness
+// at the point of the sphere closest to it. The lights are uploaded once per frame in a texture buffer and each
+// draw gets a small list of indices into it.
+// Shader side (see multi_light_phong_frag.glsl):
+//     uLights        samplerBuffer, 4 texels per light: (position, radius) (ambient, constant) (diffuse, linear) (specular, quadratic)
+//     uLightIndices  int[MAX_OBJECT_LIGHTS], the object's lights
+//     uLightCount    int, number of entries used in uLightIndices
+class LightAssignment {
+public:
+    // Size of the shader's index list
+    static constexpr int MAX_OBJECT_LIGHTS = 8;
+    ~LightAssignment() {
+        glDeleteTextures(1, &m_Texture);
+        glDeleteBuffers(1, &m_Buffer);
+    }
+    /// <summary>Creates the light assignment</summary>
+    /// <param name="lightsPerObject">Most lights an object gets, up to MAX_OBJECT_LIGHTS</param>
+    /// <param name="threshold">Brightness below which a light is considered out of reach</param>
+    static LightAssignment Create(int lightsPerObject = MAX_OBJECT_LIGHTS, float threshold = phong::DEFAULT_ATTENUATION_THRESHOLD) {
+        return LightAssignment(std::clamp(lightsPerObject, 1, MAX_OBJECT_LIGHTS), threshold);
+    }
+    /// <summary>Picks the lights of every object and uploads the lights</summary>
+    /// <param name="objectBounds">Bounding sphere of each object, center in xyz and radius in w</param>
+    /// <param name="jobSystem">Optional job system to rank the lights of the objects in parallel</param>
+    void Assign(const phong::PointLight* lights, size_t lightCount, const glm::vec4* objectBounds, size_t objectCount, JobSystem* jobSystem = nullptr) {
+        m_LightData.resize(lightCount * 4);
+        m_Peak.resize(lightCount);
+        for (size_t i = 0; i < lightCount; i++) {
+            const phong::PointLight& light = lights[i];
+            m_Peak[i] = light.PeakIntensity();
+            m_LightData[i * 4 + 0] = glm::vec4(light.position, light.InfluenceRadius(m_Threshold));
+            m_LightData[i * 4 + 1] = glm::vec4(light.ambient, light.constant);
+            m_LightData[i * 4 + 2] = glm::vec4(light.diffuse, light.linear);
+            m_LightData[i * 4 + 3] = glm::vec4(light.specular, light.quadratic);
+        }
+        m_ObjectLights.resize(objectCount * m_LightsPerObject);
+        m_ObjectLightCounts.resize(objectCount);
+        auto assign = [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                AssignObject(i, objectBounds[i]);
+            }
+        };
+        if (jobSystem != nullptr) {
+            jobSystem->ParallelFor(objectCount, 0, assign);
+        }
+        else {
+            assign(0, objectCount);
+        }
+        glBindBuffer(GL_TEXTURE_BUFFER, m_Buffer);
+        glBufferData(GL_TEXTURE_BUFFER, std::max<size_t>(m_LightData.size() * sizeof(glm::vec4), 16), nullptr, GL_STREAM_DRAW);
+        if (!m_LightData.empty()) {
+            glBufferSubData(GL_TEXTURE_BUFFER, 0, m_LightData.size() * sizeof(glm::vec4), m_LightData.data());
+        }
+    }
+    // Binds the light buffer to a texture unit and sets the shader's uLights sampler
+    void Bind(const Shader& shader, unsigned int unit) const {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(GL_TEXTURE_BUFFER, m_Texture);
+        shader.SetInt("uLights", unit);
+    }
+    // Sets the index list uniforms for drawing an object
+    void SetObjectLights(const Shader& shader, size_t object) const {
+        int count;
+        const int* indices = GetObjectLights(object, count);
+        shader.SetInts("uLightIndices", indices, count);
+        shader.SetInt("uLightCount", count);
+    }
+    // The lights of an object from the last Assign, most relevant first
+    const int* GetObjectLights(size_t object, int& count) const {
+        count = m_ObjectLightCounts[object];
+        return m_ObjectLights.data() + object * m_LightsPerObject;
+    }
+private:
+    // Light assignment constructor
+    LightAssignment(int lightsPerObject, float threshold)
+        : m_LightsPerObject(lightsPerObject), m_Threshold(threshold) {
+        glGenBuffers(1, &m_Buffer);
+        glBindBuffer(GL_TEXTURE_BUFFER, m_Buffer);
+        glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW);
+        glGenTextures(1, &m_Texture);
+        glBindTexture(GL_TEXTURE_BUFFER, m_Texture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, m_Buffer);
+    }
+    // Keeps the most relevant lights of one object sorted by relevance with an insertion sort, the list is tiny
+    void AssignObject(size_t object, const glm::vec4& bounds) {
+        int* indices = m_ObjectLights.data() + object * m_LightsPerObject;
+        float relevance[MAX_OBJECT_LIGHTS];
+        int count = 0;
+        for (size_t i = 0; i < m_Peak.size(); i++) {
+            const glm::vec4& positionRadius = m_LightData[i * 4];
+            float dist = std::max(glm::distance(glm::vec3(positionRadius), glm::vec3(bounds)) - bounds.w, 0.f);
+            if (dist > positionRadius.w) {
+                continue;
+            }
+            float attenuation = m_LightData[i * 4 + 1].w + m_LightData[i * 4 + 2].w * dist + m_LightData[i * 4 + 3].w * dist * dist;
+            float score = m_Peak[i] / attenuation;
+            if (count == m_LightsPerObject && score <= relevance[count - 1]) {
+                continue;
+            }
+            int slot = count == m_LightsPerObject ? count - 1 : count++;
+            for (; slot > 0 && relevance[slot - 1] < score; slot--) {
+                relevance[slot] = relevance[slot - 1];
+                indices[slot] = indices[slot - 1];
+            }
+            relevance[slot] = score;
+            indices[slot] = (int)i;
+        }
+        m_ObjectLightCounts[object] = count;
+    }
+private:
+    int m_LightsPerObject{};
+    float m_Threshold{};
+    // Per light: packed shader data and brightest color
+    std::vector<glm::vec4> m_LightData;
+    std::vector<float> m_Peak;
+    // m_LightsPerObject entries per object, the first m_ObjectLightCounts are used
+    std::vector<int> m_ObjectLights;
+    std::vector<int> m_ObjectLightCounts;
+    GLuint m_Buffer{};
+    GLuint m_Texture{};
+};
@@ -0,0 +1,239 @@
+#pragma once
+
+#include <JobSystem.hpp>
+#include <Shader.hpp>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// The light clusters class
+// Splits the view frustum into a grid of clusters (screen tiles by exponentially spaced depth slices), assigns
+// every point light to the clusters its sphere of influence touches and uploads the result in texture buffers,
+// so each fragment only evaluates the lights of its own cluster. The assignment runs on the job system.
+// Shader side (see clustered_phong_frag.glsl):
+//     uClusterGrid          usamplerBuffer, per cluster (offset, count) into uClusterLightIndices
+//     uClusterLightIndices  usamplerBuffer, light indices
+//     uClusterLights        samplerBuffer, 4 texels per light: (position, radius) (ambient, constant) (diffuse, linear) (specular, quadratic)
+class LightClusters {
+public:
+    static constexpr int DEFAULT_TILES_X = 16;
+    static constexpr int DEFAULT_TILES_Y = 9;
+    static constexpr int DEFAULT_SLICES = 24;
+    ~LightClusters() {
+        glDeleteTextures(3, m_Textures);
+        glDeleteBuffers(3, m_Buffers);
+    }
+    /// <summary>Creates the cluster grid</summary>
+    /// <param name="tilesX">Number of clusters across the screen</param>
+    /// <param name="tilesY">Number of clusters down the screen</param>
+    /// <param name="slices">Number of depth slices between the near and far plane</param>
+    static LightClusters Create(int tilesX = DEFAULT_TILES_X, int tilesY = DEFAULT_TILES_Y, int slices = DEFAULT_SLICES) {
+        return LightClusters(tilesX, tilesY, slices);
+    }
+    /// <summary>Assigns the lights to the clusters and uploads the result</summary>
+    /// <param name="view">The camera's view matrix</param>
+    /// <param name="proj">The (symmetric perspective) projection matrix</param>
+    /// <param name="near">The near plane distance used by proj</param>
+    /// <param name="far">The far plane distance used by proj</param>
+    void Build(const glm::mat4& view, const glm::mat4& proj, float near, float far, const phong::PointLight* lights, size_t count, JobSystem& jobSystem) {
+        if (proj != m_Proj || near != m_Near || far != m_Far) {
+            m_Proj = proj;
+            m_Near = near;
+            m_Far = far;
+            BuildClusterBounds();
+        }
+        // Per light: the view space sphere and the range of clusters it may touch
+        m_LightBounds.resize(count);
+        jobSystem.ParallelFor(count, 256, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                m_LightBounds[i] = ComputeLightBounds(view, lights[i]);
+            }
+        });
+        // Every slice is assigned by one job, each job only writes the lists of its own clusters
+        const size_t clustersPerSlice = (size_t)m_TilesX * m_TilesY;
+        m_ClusterLights.resize(clustersPerSlice * m_Slices);
+        jobSystem.ParallelFor((size_t)m_Slices, 1, [&](size_t begin, size_t end) {
+            for (size_t z = begin; z < end; z++) {
+                for (size_t c = z * clustersPerSlice; c < (z + 1) * clustersPerSlice; c++) {
+                    m_ClusterLights[c].clear();
+                }
+                for (size_t i = 0; i < count; i++) {
+                    const LightBounds& bounds = m_LightBounds[i];
+                    if ((int)z < bounds.min.z || (int)z > bounds.max.z) {
+                        continue;
+                    }
+                    for (int y = bounds.min.y; y <= bounds.max.y; y++) {
+                        for (int x = bounds.min.x; x <= bounds.max.x; x++) {
+                            size_t cluster = z * clustersPerSlice + (size_t)y * m_TilesX + x;
+                            if (SphereIntersectsBox(bounds.center, bounds.radius, m_ClusterMin[cluster], m_ClusterMax[cluster])) {
+                                m_ClusterLights[cluster].push_back((uint32_t)i);
+                            }
+                        }
+                    }
+                }
+            }
+        });
+        // Flattening the lists
+        m_Grid.resize(m_ClusterLights.size() * 2);
+        m_Indices.clear();
+        for (size_t c = 0; c < m_ClusterLights.size(); c++) {
+            m_Grid[c * 2] = (uint32_t)m_Indices.size();
+            m_Grid[c * 2 + 1] = (uint32_t)m_ClusterLights[c].size();
+            m_Indices.insert(m_Indices.end(), m_ClusterLights[c].begin(), m_ClusterLights[c].end());
+        }
+        m_LightData.resize(count * 4);
+        for (size_t i = 0; i < count; i++) {
+            const phong::PointLight& light = lights[i];
+            m_LightData[i * 4 + 0] = glm::vec4(light.position, m_LightBounds[i].radius);
+            m_LightData[i * 4 + 1] = glm::vec4(light.ambient, light.constant);
+            m_LightData[i * 4 + 2] = glm::vec4(light.diffuse, light.linear);
+            m_LightData[i * 4 + 3] = glm::vec4(light.specular, light.quadratic);
+        }
+        Upload(m_Buffers[GRID], m_Grid.data(), m_Grid.size() * sizeof(uint32_t));
+        Upload(m_Buffers[INDICES], m_Indices.data(), m_Indices.size() * sizeof(uint32_t));
+        Upload(m_Buffers[LIGHTS], m_LightData.data(), m_LightData.size() * sizeof(glm::vec4));
+    }
+    // Binds the cluster textures to three texture units starting at firstUnit and sets the shader's cluster uniforms
+    void Bind(Shader& shader, unsigned int firstUnit, const glm::vec2& screenSize) const {
+        static const char* const SAMPLERS[3] = { "uClusterGrid", "uClusterLightIndices", "uClusterLights" };
+        for (int i = 0; i < 3; i++) {
+            glActiveTexture(GL_TEXTURE0 + firstUnit + i);
+            glBindTexture(GL_TEXTURE_BUFFER, m_Textures[i]);
+            shader.SetInt(SAMPLERS[i], firstUnit + i);
+        }
+        shader.SetInt3("uClusterDims", { m_TilesX, m_TilesY, m_Slices });
+        shader.SetFloat2("uClusterTileSize", screenSize / glm::vec2((float)m_TilesX, (float)m_TilesY));
+        // slice = log(depth) * scale - bias
+        float scale = m_Slices / std::log(m_Far / m_Near);
+        shader.SetFloat("uClusterDepthScale", scale);
+        shader.SetFloat("uClusterDepthBias", std::log(m_Near) * scale);
+    }
+    // Number of light indices in all clusters of the last Build
+    size_t GetIndexCount() const {
+        return m_Indices.size();
+    }
+private:
+    enum { GRID, INDICES, LIGHTS };
+    struct LightBounds {
+        glm::vec3 center;
+        float radius;
+        glm::ivec3 min;
+        glm::ivec3 max;
+    };
+    // Light clusters constructor
+    LightClusters(int tilesX, int tilesY, int slices)
+        : m_TilesX(tilesX), m_TilesY(tilesY), m_Slices(slices) {
+        static constexpr GLenum FORMATS[3] = { GL_RG32UI, GL_R32UI, GL_RGBA32F };
+        glGenBuffers(3, m_Buffers);
+        glGenTextures(3, m_Textures);
+        for (int i = 0; i < 3; i++) {
+            glBindBuffer(GL_TEXTURE_BUFFER, m_Buffers[i]);
+            glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW);
+            glBindTexture(GL_TEXTURE_BUFFER, m_Textures[i]);
+            glTexBuffer(GL_TEXTURE_BUFFER, FORMATS[i], m_Buffers[i]);
+        }
+    }
+    // Computes the view space bounds of every cluster, only needed when the projection changes
+    void BuildClusterBounds() {
+        m_ClusterMin.resize((size_t)m_TilesX * m_TilesY * m_Slices);
+        m_ClusterMax.resize(m_ClusterMin.size());
+        for (int z = 0; z < m_Slices; z++) {
+            float nearDepth = SliceDepth(z);
+            float farDepth = SliceDepth(z + 1);
+            for (int y = 0; y < m_TilesY; y++) {
+                for (int x = 0; x < m_TilesX; x++) {
+                    glm::vec2 ndcMin{ 2.f * x / m_TilesX - 1.f, 2.f * y / m_TilesY - 1.f };
+                    glm::vec2 ndcMax{ 2.f * (x + 1) / m_TilesX - 1.f, 2.f * (y + 1) / m_TilesY - 1.f };
+                    glm::vec3 boxMin{ INFINITY }, boxMax{ -INFINITY };
+                    for (float depth : { nearDepth, farDepth }) {
+                        for (const glm::vec2& ndc : { ndcMin, ndcMax }) {
+                            // Points on the tile's edges at that depth (the camera looks down -z)
+                            glm::vec3 p{ ndc.x * depth / m_Proj[0][0], ndc.y * depth / m_Proj[1][1], -depth };
+                            boxMin = glm::min(boxMin, p);
+                            boxMax = glm::max(boxMax, p);
+                        }
+                    }
+                    size_t cluster = ((size_t)z * m_TilesY + y) * m_TilesX + x;
+                    m_ClusterMin[cluster] = boxMin;
+                    m_ClusterMax[cluster] = boxMax;
+                }
+            }
+        }
+    }
+    // Distance from the camera where a depth slice starts
+    float SliceDepth(int slice) const {
+        return m_Near * std::pow(m_Far / m_Near, (float)slice / m_Slices);
+    }
+    // Depth slice containing a view distance, clamped to the grid
+    int DepthSlice(float depth) const {
+        int slice = (int)std::floor(std::log(std::max(depth, m_Near) / m_Near) / std::log(m_Far / m_Near) * m_Slices);
+        return std::clamp(slice, 0, m_Slices - 1);
+    }
+    // Conservatively finds the clusters a light may touch, an empty range (min > max) when it cannot be seen
+    LightBounds ComputeLightBounds(const glm::mat4& view, const phong::PointLight& light) const {
+        LightBounds bounds;
+        bounds.center = glm::vec3(view * glm::vec4(light.position, 1.f));
+        bounds.radius = light.InfluenceRadius();
+        bounds.min = glm::ivec3(0);
+        bounds.max = glm::ivec3(-1);
+        float closest = -bounds.center.z - bounds.radius;
+        float farthest = -bounds.center.z + bounds.radius;
+        if (farthest < m_Near || closest > m_Far) {
+            return bounds;
+        }
+        closest = std::max(closest, m_Near);
+        farthest = std::min(farthest, m_Far);
+        if (!std::isfinite(bounds.radius)) {
+            bounds.max = glm::ivec3(m_TilesX - 1, m_TilesY - 1, m_Slices - 1);
+            return bounds;
+        }
+        // The projection x * p / depth is monotonic on the box's corners once the depth is positive
+        glm::vec2 ndcMin{ INFINITY }, ndcMax{ -INFINITY };
+        for (float depth : { closest, farthest }) {
+            for (float sign : { -1.f, 1.f }) {
+                glm::vec2 ndc{ (bounds.center.x + sign * bounds.radius) * m_Proj[0][0] / depth, (bounds.center.y + sign * bounds.radius) * m_Proj[1][1] / depth };
+                ndcMin = glm::min(ndcMin, ndc);
+                ndcMax = glm::max(ndcMax, ndc);
+            }
+        }
+        if (ndcMax.x < -1.f || ndcMin.x > 1.f || ndcMax.y < -1.f || ndcMin.y > 1.f) {
+            return bounds;
+        }
+        glm::vec2 tiles{ (float)m_TilesX, (float)m_TilesY };
+        glm::vec2 tileMin = glm::floor((glm::clamp(ndcMin, -1.f, 1.f) * .5f + .5f) * tiles);
+        glm::vec2 tileMax = glm::floor((glm::clamp(ndcMax, -1.f, 1.f) * .5f + .5f) * tiles);
+        bounds.min = glm::ivec3((int)tileMin.x, (int)tileMin.y, DepthSlice(closest));
+        bounds.max = glm::ivec3(std::min((int)tileMax.x, m_TilesX - 1), std::min((int)tileMax.y, m_TilesY - 1), DepthSlice(farthest));
+        return bounds;
+    }
+    static bool SphereIntersectsBox(const glm::vec3& center, float radius, const glm::vec3& boxMin, const glm::vec3& boxMax) {
+        glm::vec3 closest = glm::clamp(center, boxMin, boxMax);
+        glm::vec3 d = center - closest;
+        return glm::dot(d, d) <= radius * radius;
+    }
+    // Replaces the contents of a buffer, orphaning the old storage so the gpu can keep reading it
+    static void Upload(GLuint buffer, const void* data, size_t size) {
+        glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+        glBufferData(GL_TEXTURE_BUFFER, std::max<size_t>(size, 16), nullptr, GL_STREAM_DRAW);
+        if (size > 0) {
+            glBufferSubData(GL_TEXTURE_BUFFER, 0, size, data);
+        }
+    }
+private:
+    int m_TilesX{}, m_TilesY{}, m_Slices{};
+    glm::mat4 m_Proj{ 0.f };
+    float m_Near{}, m_Far{};
+    GLuint m_Buffers[3]{};
+    GLuint m_Textures[3]{};
+    std::vector<glm::vec3> m_ClusterMin;
+    std::vector<glm::vec3> m_ClusterMax;
+    std::vector<LightBounds> m_LightBounds;
+    std::vector<std::vector<uint32_t>> m_ClusterLights;
+    std::vector<uint32_t> m_Grid;
+    std::vector<uint32_t> m_Indices;
+    std::vector<glm::vec4> m_LightData;
+};
@@ -0,0 +1,186 @@
+#pragma once
+
+#include <Shader.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+
+// The light shader generator class
+// Writes fragment shaders specialized to one light configuration instead of looping over a uniform light count.
+// Every light is unrolled into straight-line code, the terms the lights share (normal, view direction, material
+// lookups) are computed once and the specular term is only emitted for lights that have specular. Programs are
+// compiled the first time a configuration is asked for and cached, so a scene only pays for the variants it uses.
+// Shader side: the uniforms of multi_light_phong_frag.glsl, point lights come from the LightAssignment buffer.
+class LightShaderGenerator {
+public:
+    // Point lights a shader can be specialized to, the size of the shader's index list
+    static constexpr int MAX_POINT_LIGHTS = 8;
+    // The lights a shader is specialized to
+    struct Configuration {
+        bool directionalLight = true;
+        bool directionalSpecular = true;
+        // Lights read through uLightIndices[0] to uLightIndices[pointCount - 1]
+        int pointCount = 0;
+        // Bit i is set when the point light in slot i has specular
+        uint32_t pointSpecularMask = 0;
+        bool flashLight = true;
+        bool flashLightSpecular = true;
+        // Packs the configuration into a cache key
+        uint32_t GetKey() const {
+            uint32_t specularMask = pointSpecularMask & ((1u << pointCount) - 1u);
+            return (uint32_t)directionalLight | (uint32_t)directionalSpecular << 1 | (uint32_t)flashLight << 2 | (uint32_t)flashLightSpecular << 3 |
+                (uint32_t)pointCount << 4 | specularMask << 8;
+        }
+    };
+    /// <summary>Creates an empty cache</summary>
+    /// <param name="vertexFile">The vertex shader every generated fragment shader is linked with</param>
+    explicit LightShaderGenerator(const char* vertexFile) {
+        extractTextFromFile(vertexFile, m_VertexSource);
+    }
+    // The program for a configuration, generated and compiled on the first request
+    Shader& Get(Configuration configuration) {
+        configuration.pointCount = std::clamp(configuration.pointCount, 0, MAX_POINT_LIGHTS);
+        std::unique_ptr<Shader>& shader = m_Shaders[configuration.GetKey()];
+        if (shader == nullptr) {
+            std::string fragmentSource = Generate(configuration);
+            shader.reset(new Shader(Shader::CreateFromSource(m_VertexSource.c_str(), fragmentSource.c_str())));
+        }
+        return *shader;
+    }
+    // Number of programs compiled so far
+    size_t GetShaderCount() const {
+        return m_Shaders.size();
+    }
+    // The fragment shader source for a configuration
+    static std::string Generate(const Configuration& configuration) {
+        bool pointSpecular = (configuration.pointSpecularMask & ((1u << configuration.pointCount) - 1u)) != 0;
+        bool directionalSpecular = configuration.directionalLight && configuration.directionalSpecular;
+        bool flashLightSpecular = configuration.flashLight && configuration.flashLightSpecular;
+        bool anySpecular = pointSpecular || directionalSpecular || flashLightSpecular;
+        std::stringstream ss;
+        ss << "#version 330 core\n"
+            "// Generated by LightShaderGenerator: " << configuration.pointCount << " point lights"
+            << (configuration.directionalLight ? ", directional light" : "") << (configuration.flashLight ? ", flash light" : "") << "\n"
+            "layout (location = 0) out vec4 oFragColor;\n"
+            "in vec3 Position;\n"
+            "in vec2 TexCoord;\n"
+            "in vec3 Normal;\n"
+            "uniform struct Material {\n"
+            "    sampler2D diffuse;\n"
+            "    sampler2D specular;\n"
+            "    float shininess;\n"
+            "} uMaterial;\n";
+        if (configuration.directionalLight) {
+            ss << "uniform struct DirectionalLight {\n"
+                "    vec3 ambient;\n"
+                "    vec3 diffuse;\n"
+                "    vec3 specular;\n"
+                "    vec3 direction;\n"
+                "} uDirectionalLight;\n"
+                "uniform mat4 uView;\n"
+                "uniform sampler2DArrayShadow uShadowMap;\n"
+                "uniform mat4 uShadowMatrices[4];\n"
+                "uniform vec4 uCascadeSplits;\n"
+                "uniform int uCascadeCount;\n";
+        }
+        if (configuration.flashLight) {
+            ss << "uniform struct FlashLight {\n"
+                "    vec3 ambient;\n"
+                "    vec3 diffuse;\n"
+                "    vec3 specular;\n"
+                "    vec3 position;\n"
+                "    vec3 direction;\n"
+                "    float innerCutoff;\n"
+                "    float outerCutoff;\n"
+                "    float constant;\n"
+                "    float linear;\n"
+                "    float quadratic;\n"
+                "} uFlashLight;\n";
+        }
+        if (configuration.pointCount > 0) {
+            ss << "uniform samplerBuffer uLights;\n"
+                "uniform int uLightIndices[" << MAX_POINT_LIGHTS << "];\n";
+        }
+        if (anySpecular) {
+            ss << "uniform vec3 uCamPos;\n";
+        }
+        if (configuration.directionalLight) {
+            ss << "float CalculateShadow(in vec3 position, in vec3 normal, in float viewDepth) {\n"
+                "    int cascade = 0;\n"
+                "    while (cascade < uCascadeCount && viewDepth > uCascadeSplits[cascade]) {\n"
+                "        cascade++;\n"
+                "    }\n"
+                "    if (cascade == uCascadeCount) {\n"
+                "        return 1.;\n"
+                "    }\n"
+                "    vec4 coord = uShadowMatrices[cascade] * vec4(position + normal * .02, 1.);\n"
+                "    return texture(uShadowMap, vec4(coord.xy, float(cascade), coord.z));\n"
+                "}\n";
+        }
+        ss << "void main() {\n"
+            "    vec3 normal = normalize(Normal);\n"
+            "    vec3 diffuseFragColor = texture(uMaterial.diffuse, TexCoord).rgb;\n";
+        if (anySpecular) {
+            ss << "    vec3 specularFragColor = texture(uMaterial.specular, TexCoord).rgb;\n"
+                "    vec3 camDir = normalize(uCamPos - Position);\n";
+        }
+        ss << "    vec3 color = vec3(0.);\n";
+        if (configuration.directionalLight) {
+            ss << "    {\n"
+                "        vec3 lightDir = normalize(-uDirectionalLight.direction);\n"
+                "        vec3 lit = max(dot(normal, lightDir), 0.) * uDirectionalLight.diffuse * diffuseFragColor;\n";
+            if (directionalSpecular) {
+                ss << "        lit += pow(max(dot(camDir, reflect(-lightDir, normal)), 0.), uMaterial.shininess) * uDirectionalLight.specular * specularFragColor;\n";
+            }
+            ss << "        float shadow = CalculateShadow(Position, normal, -(uView * vec4(Position, 1.)).z);\n"
+                "        color += uDirectionalLight.ambient * diffuseFragColor + shadow * lit;\n"
+                "    }\n";
+        }
+        for (int i = 0; i < configuration.pointCount; i++) {
+            bool specular = (configuration.pointSpecularMask >> i & 1u) != 0;
+            ss << "    {\n"
+                "        int index = uLightIndices[" << i << "] * 4;\n"
+                "        vec4 positionRadius = texelFetch(uLights, index);\n"
+                "        vec4 ambientConstant = texelFetch(uLights, index + 1);\n"
+                "        vec4 diffuseLinear = texelFetch(uLights, index + 2);\n"
+                "        vec4 specularQuadratic = texelFetch(uLights, index + 3);\n"
+                "        vec3 toLight = positionRadius.xyz - Position;\n"
+                "        float dist = length(toLight);\n"
+                "        vec3 lightDir = toLight / dist;\n"
+                "        float attenuation = 1. / (ambientConstant.w + diffuseLinear.w * dist + specularQuadratic.w * (dist * dist));\n"
+                "        vec3 lit = (ambientConstant.rgb + max(dot(normal, lightDir), 0.) * diffuseLinear.rgb) * diffuseFragColor;\n";
+            if (specular) {
+                ss << "        lit += pow(max(dot(camDir, reflect(-lightDir, normal)), 0.), uMaterial.shininess) * specularQuadratic.rgb * specularFragColor;\n";
+            }
+            ss << "        color += attenuation * lit;\n"
+                "    }\n";
+        }
+        if (configuration.flashLight) {
+            // Outside of the cone the intensity clamps to 0, which leaves only the ambient term without a branch
+            ss << "    {\n"
+                "        vec3 toLight = uFlashLight.position - Position;\n"
+                "        float dist = length(toLight);\n"
+                "        vec3 lightDir = toLight / dist;\n"
+                "        float theta = dot(lightDir, normalize(-uFlashLight.direction));\n"
+                "        float intensity = clamp((theta - uFlashLight.outerCutoff) / (uFlashLight.innerCutoff - uFlashLight.outerCutoff), 0., 1.);\n"
+                "        float attenuation = 1. / (uFlashLight.constant + uFlashLight.linear * dist + uFlashLight.quadratic * (dist * dist));\n"
+                "        vec3 lit = max(dot(normal, lightDir), 0.) * uFlashLight.diffuse * diffuseFragColor;\n";
+            if (flashLightSpecular) {
+                ss << "        lit += pow(max(dot(camDir, reflect(-lightDir, normal)), 0.), uMaterial.shininess) * uFlashLight.specular * specularFragColor;\n";
+            }
+            ss << "        color += uFlashLight.ambient * diffuseFragColor + intensity * attenuation * lit;\n"
+                "    }\n";
+        }
+        ss << "    oFragColor = vec4(color, 1.);\n"
+            "}\n";
+        return ss.str();
+    }
+private:
+    std::string m_VertexSource;
+    // Programs by configuration key, behind pointers so references handed out by Get stay valid
+    std::unordered_map<uint32_t, std::unique_ptr<Shader>> m_Shaders;
+};
@@ -0,0 +1,380 @@
+#pragma once
+
+#include <Bvh.hpp>
+#include <JobSystem.hpp>
+#include <Shader.hpp>
+#include <glm/glm.hpp>
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+// The lightmap baker class
+// Precomputes the diffuse lighting of static geometry offline. Every triangle gets its own chart in the lightmap,
+// the charts are packed on shelves from the tallest to the shortest. Each covered texel casts shadow rays towards
+// the directional and point lights through a bvh, bounces gather the lighting of the previous pass with cosine
+// distributed rays. The texels are split between all cores of the job system.
+// Lighting is stored divided by LIGHTMAP_SCALE so 8 bits per channel can hold surfaces lit brighter than 1.
+// Shader side (see lightmap_frag.glsl):
+//     uLightmap       sampler2D, the written lightmap
+//     uLightmapScale  float, LIGHTMAP_SCALE
+class LightmapBaker {
+public:
+    static constexpr float LIGHTMAP_SCALE = 2.f;
+    // Empty texels around every chart so bilinear filtering does not pick up the neighboring charts
+    static constexpr int CHART_PADDING = 2;
+    // Rays start this far off the surface against self intersection
+    static constexpr float RAY_OFFSET = 1e-3f;
+    // Unwrap lowers the texel density by this factor until the charts fit
+    static constexpr float DENSITY_STEP = .8f;
+    // A vertex of the unwrapped geometry, already in world space
+    struct Vertex {
+        glm::vec3 position;
+        glm::vec2 texCoord;
+        glm::vec3 normal;
+        glm::vec2 lightmapCoord;
+    };
+    /// <summary>Creates an empty baker</summary>
+    /// <param name="resolution">Width and height of the lightmap in texels</param>
+    /// <param name="texelsPerUnit">Texel density, Unwrap lowers it when the charts do not fit</param>
+    explicit LightmapBaker(int resolution = 512, float texelsPerUnit = 32.f)
+        : m_Resolution(resolution), m_TexelsPerUnit(texelsPerUnit) {
+    }
+    /// <summary>Adds a static mesh, its triangles are stored unindexed and in world space</summary>
+    /// <param name="vertices">Interleaved float vertices</param>
+    /// <param name="floatsPerVertex">The vertex stride in floats</param>
+    /// <param name="model">The mesh's world matrix</param>
+    /// <param name="positionOffset">Float offset of the position in a vertex</param>
+    /// <param name="texCoordOffset">Float offset of the texture coordinates in a vertex</param>
+    /// <param name="normalOffset">Float offset of the normal in a vertex</param>
+    void AddMesh(const float* vertices, size_t floatsPerVertex, const unsigned int* indices, size_t indexCount, const glm::mat4& model,
+        size_t positionOffset = 0, size_t texCoordOffset = 3, size_t normalOffset = 5) {
+        glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(model)));
+        for (size_t i = 0; i < indexCount / 3 * 3; i++) {
+            const float* v = vertices + indices[i] * floatsPerVertex;
+            Vertex vertex{};
+            vertex.position = glm::vec3(model * glm::vec4(v[positionOffset], v[positionOffset + 1], v[positionOffset + 2], 1.f));
+            vertex.texCoord = glm::vec2(v[texCoordOffset], v[texCoordOffset + 1]);
+            vertex.normal = glm::normalize(normalMatrix * glm::vec3(v[normalOffset], v[normalOffset + 1], v[normalOffset + 2]));
+            m_Vertices.push_back(vertex);
+        }
+    }
+    /// <summary>Packs a chart for every triangle and sets the lightmap coordinates of the vertices</summary>
+    /// <returns>False when the charts do not fit even at a tiny texel density</returns>
+    bool Unwrap() {
+        size_t triangleCount = m_Vertices.size() / 3;
+        // Every triangle is laid flat with its first edge along x, corners are relative to the chart's lower left
+        std::vector<glm::vec2> corners(m_Vertices.size());
+        std::vector<glm::vec2> sizes(triangleCount);
+        for (size_t i = 0; i < triangleCount; i++) {
+            const Vertex* v = m_Vertices.data() + i * 3;
+            glm::vec3 e1 = v[1].position - v[0].position, e2 = v[2].position - v[0].position;
+            glm::vec3 normal = glm::cross(e1, e2);
+            float length = glm::length(e1);
+            if (length == 0.f || glm::dot(normal, normal) == 0.f) {
+                // Degenerate triangles still get a texel so they are not left black
+                corners[i * 3] = corners[i * 3 + 1] = corners[i * 3 + 2] = glm::vec2(0.f);
+                continue;
+            }
+            glm::vec3 x = e1 / length;
+            glm::vec3 y = glm::normalize(glm::cross(normal, x));
+            glm::vec2 c{ glm::dot(e2, x), glm::dot(e2, y) };
+            float minX = glm::min(0.f, c.x);
+            corners[i * 3] = glm::vec2(-minX, 0.f);
+            corners[i * 3 + 1] = glm::vec2(length - minX, 0.f);
+            corners[i * 3 + 2] = glm::vec2(c.x - minX, c.y);
+            sizes[i] = glm::vec2(glm::max(length, c.x) - minX, c.y);
+        }
+        std::vector<uint32_t> order(triangleCount);
+        for (size_t i = 0; i < triangleCount; i++) {
+            order[i] = (uint32_t)i;
+        }
+        std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+            return sizes[a].y > sizes[b].y;
+        });
+        m_Charts.resize(triangleCount);
+        while (!Pack(order, sizes)) {
+            m_TexelsPerUnit *= DENSITY_STEP;
+            if (m_TexelsPerUnit < 1e-3f) {
+                fprintf(stderr, "The %zu lightmap charts do not fit in %dx%d texels\n", triangleCount, m_Resolution, m_Resolution);
+                return false;
+            }
+        }
+        for (size_t i = 0; i < triangleCount; i++) {
+            glm::vec2 origin{ (float)(m_Charts[i].x + CHART_PADDING), (float)(m_Charts[i].y + CHART_PADDING) };
+            for (size_t j = i * 3; j < i * 3 + 3; j++) {
+                m_Vertices[j].lightmapCoord = (origin + corners[j] * m_TexelsPerUnit) / (float)m_Resolution;
+            }
+        }
+        return true;
+    }
+    /// <summary>Computes the lighting of every covered texel, Unwrap has to be called first</summary>
+    /// <param name="bounces">Passes of indirect lighting after the direct lighting</param>
+    /// <param name="bounceSamples">Rays per texel and bounce</param>
+    /// <param name="albedo">Fraction of the light the surfaces reflect on bounces</param>
+    void Bake(const phong::DirectionalLight* directionalLights, size_t directionalCount, const phong::PointLight* pointLights, size_t pointCount,
+        JobSystem& jobSystem, int bounces = 0, int bounceSamples = 64, float albedo = .5f) {
+        std::vector<glm::vec3> positions(m_Vertices.size());
+        for (size_t i = 0; i < m_Vertices.size(); i++) {
+            positions[i] = m_Vertices[i].position;
+        }
+        m_Bvh.Build(positions.data(), positions.size() / 3);
+        Rasterize();
+        m_Lightmap.assign((size_t)m_Resolution * m_Resolution, glm::vec3(0.f));
+        std::vector<glm::vec3> direct(m_Texels.size());
+        jobSystem.ParallelFor(m_Texels.size(), 0, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                direct[i] = DirectLighting(m_Texels[i], directionalLights, directionalCount, pointLights, pointCount);
+            }
+        });
+        for (size_t i = 0; i < m_Texels.size(); i++) {
+            m_Lightmap[m_Texels[i].index] = direct[i];
+        }
+        Dilate();
+        std::vector<glm::vec3> gathered(m_Texels.size());
+        for (int bounce = 0; bounce < bounces; bounce++) {
+            jobSystem.ParallelFor(m_Texels.size(), 0, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; i++) {
+                    gathered[i] = albedo * Gather(m_Texels[i], bounceSamples, (uint32_t)(bounce * m_Texels.size() + i));
+                }
+            });
+            for (size_t i = 0; i < m_Texels.size(); i++) {
+                m_Lightmap[m_Texels[i].index] = direct[i] + gathered[i];
+            }
+            Dilate();
+        }
+    }
+    /// <summary>Writes the lightmap as an 8 bit png, values are divided by LIGHTMAP_SCALE</summary>
+    bool Write(const char* filepath) const {
+        std::vector<unsigned char> pixels(m_Lightmap.size() * 3);
+        for (size_t i = 0; i < m_Lightmap.size(); i++) {
+            glm::vec3 color = glm::clamp(m_Lightmap[i] / LIGHTMAP_SCALE, 0.f, 1.f) * 255.f + .5f;
+            pixels[i * 3] = (unsigned char)color.x;
+            pixels[i * 3 + 1] = (unsigned char)color.y;
+            pixels[i * 3 + 2] = (unsigned char)color.z;
+        }
+        if (pixels.empty() || stbi_write_png(filepath, m_Resolution, m_Resolution, 3, pixels.data(), m_Resolution * 3) == 0) {
+            fprintf(stderr, "Failed to write the lightmap %s\n", filepath);
+            return false;
+        }
+        return true;
+    }
+    // Three vertices per triangle, ready for glDrawArrays
+    const std::vector<Vertex>& GetVertices() const {
+        return m_Vertices;
+    }
+    // The baked lighting, row by row starting at lightmap coordinate v = 0
+    const std::vector<glm::vec3>& GetLightmap() const {
+        return m_Lightmap;
+    }
+    int GetResolution() const {
+        return m_Resolution;
+    }
+    float GetTexelsPerUnit() const {
+        return m_TexelsPerUnit;
+    }
+    // Texels covered by a triangle in the last Bake
+    size_t GetTexelCount() const {
+        return m_Texels.size();
+    }
+private:
+    // A triangle's rectangle in the lightmap including the padding, in texels
+    struct Chart {
+        int x;
+        int y;
+        int width;
+        int height;
+    };
+    // A lightmap texel and the surface point it stands for
+    struct Texel {
+        uint32_t index;
+        glm::vec3 position;
+        glm::vec3 normal;
+    };
+    // Shelf packing, false when the charts overflow the lightmap
+    bool Pack(const std::vector<uint32_t>& order, const std::vector<glm::vec2>& sizes) {
+        int x = 0, y = 0, shelfHeight = 0;
+        for (uint32_t triangle : order) {
+            int width = (int)std::ceil(sizes[triangle].x * m_TexelsPerUnit) + 1 + CHART_PADDING * 2;
+            int height = (int)std::ceil(sizes[triangle].y * m_TexelsPerUnit) + 1 + CHART_PADDING * 2;
+            if (x + width > m_Resolution) {
+                x = 0;
+                y += shelfHeight;
+                shelfHeight = 0;
+            }
+            if (width > m_Resolution || y + height > m_Resolution) {
+                return false;
+            }
+            m_Charts[triangle] = { x, y, width, height };
+            x += width;
+            shelfHeight = std::max(shelfHeight, height);
+        }
+        return true;
+    }
+    // Finds the texels of every chart whose center is within half a texel diagonal of the triangle
+    void Rasterize() {
+        m_Texels.clear();
+        m_Covered.assign((size_t)m_Resolution * m_Resolution, 0);
+        for (size_t triangle = 0; triangle < m_Charts.size(); triangle++) {
+            const Vertex* v = m_Vertices.data() + triangle * 3;
+            glm::vec2 a = v[0].lightmapCoord * (float)m_Resolution;
+            glm::vec2 b = v[1].lightmapCoord * (float)m_Resolution;
+            glm::vec2 c = v[2].lightmapCoord * (float)m_Resolution;
+            const Chart& chart = m_Charts[triangle];
+            for (int y = chart.y; y < chart.y + chart.height; y++) {
+                for (int x = chart.x; x < chart.x + chart.width; x++) {
+                    glm::vec3 barycentric;
+                    if (!ClosestBarycentric(glm::vec2(x + .5f, y + .5f), a, b, c, barycentric)) {
+                        continue;
+                    }
+                    Texel texel;
+                    texel.index = (uint32_t)(y * m_Resolution + x);
+                    texel.position = barycentric.x * v[0].position + barycentric.y * v[1].position + barycentric.z * v[2].position;
+                    texel.normal = glm::normalize(barycentric.x * v[0].normal + barycentric.y * v[1].normal + barycentric.z * v[2].normal);
+                    m_Texels.push_back(texel);
+                    m_Covered[texel.index] = 1;
+                }
+            }
+        }
+    }
+    // Barycentrics of the point of the triangle closest to p, false when that point is too far for p's texel
+    static bool ClosestBarycentric(const glm::vec2& p, const glm::vec2& a, const glm::vec2& b, const glm::vec2& c, glm::vec3& barycentric) {
+        float area = Cross(b - a, c - a);
+        if (area != 0.f) {
+            barycentric = glm::vec3(Cross(b - p, c - p), Cross(c - p, a - p), Cross(a - p, b - p)) / area;
+            if (barycentric.x >= 0.f && barycentric.y >= 0.f && barycentric.z >= 0.f) {
+                return true;
+            }
+        }
+        // Outside, the closest point lies on one of the edges
+        const glm::vec2 corners[3] = { a, b, c };
+        float closest = INFINITY;
+        for (int i = 0; i < 3; i++) {
+            glm::vec2 edge = corners[(i + 1) % 3] - corners[i];
+            float lengthSquared = glm::dot(edge, edge);
+            float t = lengthSquared > 0.f ? glm::clamp(glm::dot(p - corners[i], edge) / lengthSquared, 0.f, 1.f) : 0.f;
+            glm::vec2 d = corners[i] + edge * t - p;
+            if (glm::dot(d, d) < closest) {
+                closest = glm::dot(d, d);
+                barycentric = glm::vec3(0.f);
+                barycentric[i] = 1.f - t;
+                barycentric[(i + 1) % 3] = t;
+            }
+        }
+        return closest <= .5f;
+    }
+    static float Cross(const glm::vec2& a, const glm::vec2& b) {
+        return a.x * b.y - a.y * b.x;
+    }
+    // Lambert lighting with shadows, the ambient terms are added unshadowed like the real time shaders do
+    glm::vec3 DirectLighting(const Texel& texel, const phong::DirectionalLight* directionalLights, size_t directionalCount,
+        const phong::PointLight* pointLights, size_t pointCount) const {
+        glm::vec3 origin = texel.position + texel.normal * RAY_OFFSET;
+        glm::vec3 color{ 0.f };
+        for (size_t i = 0; i < directionalCount; i++) {
+            const phong::DirectionalLight& light = directionalLights[i];
+            glm::vec3 lightDir = glm::normalize(-light.direction);
+            color += light.ambient;
+            float diff = glm::dot(texel.normal, lightDir);
+            if (diff > 0.f && !m_Bvh.Occluded(origin, lightDir, INFINITY)) {
+                color += diff * light.diffuse;
+            }
+        }
+        for (size_t i = 0; i < pointCount; i++) {
+            const phong::PointLight& light = pointLights[i];
+            glm::vec3 toLight = light.position - origin;
+            float dist = glm::length(toLight);
+            if (dist > light.InfluenceRadius()) {
+                continue;
+            }
+            float attenuation = 1.f / (light.constant + light.linear * dist + light.quadratic * dist * dist);
+            color += attenuation * light.ambient;
+            float diff = glm::dot(texel.normal, toLight / dist);
+            // The direction is left unnormalized so the light sits at t = 1
+            if (diff > 0.f && !m_Bvh.Occluded(origin, toLight, 1.f)) {
+                color += attenuation * diff * light.diffuse;
+            }
+        }
+        return color;
+    }
+    // Average lighting seen over the hemisphere with cosine distributed rays (so no cosine weighting is needed)
+    glm::vec3 Gather(const Texel& texel, int samples, uint32_t seed) const {
+        std::minstd_rand random{ seed + 1 };
+        std::uniform_real_distribution<float> unit{ 0.f, 1.f };
+        // Orthonormal basis around the normal (Duff et al. 2017)
+        const glm::vec3& n = texel.normal;
+        float sign = std::copysign(1.f, n.z);
+        float a = -1.f / (sign + n.z);
+        float b = n.x * n.y * a;
+        glm::vec3 tangent{ 1.f + sign * n.x * n.x * a, sign * b, -sign * n.x };
+        glm::vec3 bitangent{ b, sign + n.y * n.y * a, -n.y };
+        glm::vec3 origin = texel.position + n * RAY_OFFSET;
+        glm::vec3 sum{ 0.f };
+        for (int i = 0; i < samples; i++) {
+            float phi = 6.2831853f * unit(random);
+            float r2 = unit(random);
+            float r = std::sqrt(r2);
+            glm::vec3 direction = tangent * (r * std::cos(phi)) + bitangent * (r * std::sin(phi)) + n * std::sqrt(1.f - r2);
+            Bvh::Hit hit;
+            if (!m_Bvh.Intersect(origin, direction, INFINITY, hit)) {
+                continue;
+            }
+            const Vertex* v = m_Vertices.data() + hit.triangle * 3;
+            // The back faces of closed meshes are never lit
+            if (glm::dot(glm::cross(v[1].position - v[0].position, v[2].position - v[0].position), direction) > 0.f) {
+                continue;
+            }
+            glm::vec2 coord = (1.f - hit.u - hit.v) * v[0].lightmapCoord + hit.u * v[1].lightmapCoord + hit.v * v[2].lightmapCoord;
+            int x = glm::clamp((int)(coord.x * m_Resolution), 0, m_Resolution - 1);
+            int y = glm::clamp((int)(coord.y * m_Resolution), 0, m_Resolution - 1);
+            sum += m_Lightmap[(size_t)y * m_Resolution + x];
+        }
+        return sum / (float)std::max(samples, 1);
+    }
+    // Grows the charts into their padding so filtering and bounce lookups next to an edge find lighting
+    void Dilate() {
+        std::vector<uint8_t> covered = m_Covered;
+        for (int pass = 0; pass < CHART_PADDING; pass++) {
+            std::vector<uint8_t> next = covered;
+            for (int y = 0; y < m_Resolution; y++) {
+                for (int x = 0; x < m_Resolution; x++) {
+                    size_t index = (size_t)y * m_Resolution + x;
+                    if (covered[index]) {
+                        continue;
+                    }
+                    glm::vec3 sum{ 0.f };
+                    int count = 0;
+                    for (int ny = std::max(y - 1, 0); ny <= std::min(y + 1, m_Resolution - 1); ny++) {
+                        for (int nx = std::max(x - 1, 0); nx <= std::min(x + 1, m_Resolution - 1); nx++) {
+                            size_t neighbor = (size_t)ny * m_Resolution + nx;
+                            if (covered[neighbor]) {
+                                sum += m_Lightmap[neighbor];
+                                count++;
+                            }
+                        }
+                    }
+                    if (count > 0) {
+                        m_Lightmap[index] = sum / (float)count;
+                        next[index] = 1;
+                    }
+                }
+            }
+            covered.swap(next);
+        }
+    }
+private:
+    int m_Resolution{};
+    float m_TexelsPerUnit{};
+    std::vector<Vertex> m_Vertices;
+    std::vector<Chart> m_Charts;
+    Bvh m_Bvh;
+    std::vector<Texel> m_Texels;
+    // Per lightmap texel: whether a triangle covers it
+    std::vector<uint8_t> m_Covered;
+    std::vector<glm::vec3> m_Lightmap;
+};
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// The lod selector class
+// Picks the level of detail of an object from its projected size: a level's object space error (see
+// StaticMesh::GetLodErrors) is projected with the pixels a unit covers at the object's bounding sphere and the coarsest
+// level whose error stays below a pixel budget is used. An object only changes level once the projected error is
+// clearly past the budget (by the hysteresis fraction), so it does not flip back and forth near a threshold.
+class LodSelector {
+public:
+    // Projected error in pixels a level may have
+    static constexpr float DEFAULT_PIXEL_ERROR = 1.f;
+    // Fraction of the pixel budget the error has to be past the budget by before the level changes
+    static constexpr float DEFAULT_HYSTERESIS = .25f;
+    /// <summary>Creates a selector for a perspective projection</summary>
+    /// <param name="fovY">Vertical field of view in radians</param>
+    LodSelector(float fovY, int screenHeight, float pixelError = DEFAULT_PIXEL_ERROR, float hysteresis = DEFAULT_HYSTERESIS)
+        : m_PixelError(pixelError), m_Hysteresis(hysteresis) {
+        SetProjection(fovY, screenHeight);
+    }
+    // Updates the projection, e.g. when the window is resized or the camera zooms
+    void SetProjection(float fovY, int screenHeight) {
+        m_PixelsPerUnitAtOne = (float)screenHeight / (2.f * std::tan(fovY * .5f));
+    }
+    /// <summary>Pixels a unit covers on the screen at the nearest point of a bounding sphere</summary>
+    /// <param name="center">Center of the sphere in world space</param>
+    /// <param name="radius">Radius of the sphere in world space</param>
+    float GetPixelsPerUnit(const glm::vec3& center, float radius, const glm::vec3& cameraPosition) const {
+        float distance = glm::length(center - cameraPosition) - radius;
+        // The camera inside the sphere sees the object at full size
+        return distance > 0.f ? m_PixelsPerUnitAtOne / distance : INFINITY;
+    }
+    /// <summary>The level an object should be drawn with this frame</summary>
+    /// <param name="currentLod">The level the object was drawn with last frame</param>
+    /// <param name="lodErrors">Object space error of every level, finest first</param>
+    /// <param name="scale">Largest scale of the object's model matrix, object space errors are scaled by it</param>
+    uint32_t Select(uint32_t currentLod, const std::vector<float>& lodErrors, const glm::vec3& center, float radius,
+        const glm::vec3& cameraPosition, float scale = 1.f) const {
+        if (lodErrors.empty()) {
+            return 0;
+        }
+        currentLod = std::min(currentLod, (uint32_t)lodErrors.size() - 1);
+        float pixelsPerUnit = GetPixelsPerUnit(center, radius, cameraPosition) * scale;
+        auto pixels = [&](uint32_t lod) {
+            return lodErrors[lod] * pixelsPerUnit;
+        };
+        uint32_t target = 0;
+        for (uint32_t lod = (uint32_t)lodErrors.size() - 1; lod > 0; lod--) {
+            if (pixels(lod) <= m_PixelError) {
+                target = lod;
+                break;
+            }
+        }
+        if (target > currentLod) {
+            // Coarser only once the error is comfortably within the budget
+            while (target > currentLod && pixels(target) > m_PixelError * (1.f - m_Hysteresis)) {
+                target--;
+            }
+        }
+        else if (target < currentLod && pixels(currentLod) <= m_PixelError * (1.f + m_Hysteresis)) {
+            // Finer only once the current level is clearly over the budget
+            target = currentLod;
+        }
+        return target;
+    }
+private:
+    float m_PixelError;
+    float m_Hysteresis;
+    // Pixels a unit covers at a distance of one
+    float m_PixelsPerUnitAtOne{};
+};
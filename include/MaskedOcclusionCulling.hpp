@@ -0,0 +1,328 @@
+#pragma once
+
+#include <JobSystem.hpp>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#if defined(__AVX2__)
+#define MASKED_OCCLUSION_CULLING_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#define MASKED_OCCLUSION_CULLING_SSE
+#include <emmintrin.h>
+#endif
+
+// The masked occlusion culling class
+// A low resolution software depth buffer to drop objects hidden behind others before they are drawn (after Hasselgren
+// et al., Masked Software Occlusion Culling). Instead of a depth per pixel every tile of 8x4 pixels keeps a coverage
+// mask and two depths: the farthest depth of the occluders covering the whole tile and a working layer collecting
+// triangles that cover it partially, which replaces the first once its mask is full. Depths are 1 / w, larger is nearer.
+// Occluder triangles are set up when added, then Rasterize covers the rows of tiles in parallel, every row taking the
+// triangles in the order they were added so the result does not depend on the threads. A row of pixel centers is
+// tested against a triangle's edges 8 at a time with avx2 (two halves with sse when the build has no avx2).
+// Nothing touches opengl, so the buffer can be filled and tested without a context.
+class MaskedOcclusionCulling {
+public:
+    static constexpr int TILE_WIDTH = 8;
+    static constexpr int TILE_HEIGHT = 4;
+    // A fraction of a 1080p screen in each direction is enough for large occluders
+    static constexpr int DEFAULT_WIDTH = 320;
+    static constexpr int DEFAULT_HEIGHT = 180;
+    enum Result {
+        VISIBLE,
+        // Behind the occluders in every tile it covers
+        OCCLUDED,
+        // Outside the frustum
+        VIEW_CULLED,
+    };
+    /// <summary>Creates an empty buffer</summary>
+    /// <param name="width">Width in pixels, rounded up to whole tiles</param>
+    /// <param name="height">Height in pixels, rounded up to whole tiles</param>
+    explicit MaskedOcclusionCulling(int width = DEFAULT_WIDTH, int height = DEFAULT_HEIGHT) {
+        SetResolution(width, height);
+    }
+    void SetResolution(int width, int height) {
+        m_TilesX = std::max((width + TILE_WIDTH - 1) / TILE_WIDTH, 1);
+        m_TilesY = std::max((height + TILE_HEIGHT - 1) / TILE_HEIGHT, 1);
+        m_Width = (float)(m_TilesX * TILE_WIDTH);
+        m_Height = (float)(m_TilesY * TILE_HEIGHT);
+        Clear();
+    }
+    // Empties the buffer and drops the occluders, once per frame before adding them
+    void Clear() {
+        size_t tileCount = (size_t)m_TilesX * m_TilesY;
+        m_Masks.assign(tileCount, 0);
+        m_Depth0.assign(tileCount, 0.f);
+        m_Depth1.assign(tileCount, INFINITY);
+        m_Triangles.clear();
+    }
+    /// <summary>Adds the triangles of an occluder, only its front faces (counter-clockwise on the screen) are kept</summary>
+    /// <param name="positions">Object space positions, the first 3 floats of every vertex</param>
+    /// <param name="stride">Floats from one vertex to the next</param>
+    /// <param name="modelToClip">Projection times view times model</param>
+    void AddOccluder(const float* positions, size_t stride, const uint32_t* indices, size_t indexCount, const glm::mat4& modelToClip) {
+        for (size_t i = 0; i + 2 < indexCount; i += 3) {
+            glm::vec4 clip[3];
+            for (int k = 0; k < 3; k++) {
+                const float* position = positions + indices[i + k] * stride;
+                clip[k] = modelToClip * glm::vec4(position[0], position[1], position[2], 1.f);
+            }
+            AddClipTriangle(clip);
+        }
+    }
+    // Covers the tiles with the occluders added since the last Clear, rows of tiles are covered in parallel
+    void Rasterize(JobSystem* jobSystem = nullptr) {
+        auto rasterizeRows = [&](size_t begin, size_t end) {
+            for (size_t y = begin; y < end; y++) {
+                RasterizeRow((int)y);
+            }
+        };
+        if (jobSystem != nullptr) {
+            jobSystem->ParallelFor((size_t)m_TilesY, 1, rasterizeRows);
+        }
+        else {
+            rasterizeRows(0, (size_t)m_TilesY);
+        }
+    }
+    /// <summary>Tests an object's bounding box against the rasterized occluders</summary>
+    /// <param name="modelToClip">Projection times view times the object's model matrix</param>
+    Result TestBox(const glm::vec3& min, const glm::vec3& max, const glm::mat4& modelToClip) const {
+        glm::vec4 corners[8];
+        for (int i = 0; i < 8; i++) {
+            corners[i] = modelToClip * glm::vec4(i & 1 ? max.x : min.x, i & 2 ? max.y : min.y, i & 4 ? max.z : min.z, 1.f);
+        }
+        // Outside when all corners are beyond the same clip plane
+        for (int axis = 0; axis < 3; axis++) {
+            bool below = true, above = true;
+            for (const glm::vec4& corner : corners) {
+                below &= corner[axis] < -corner.w;
+                above &= corner[axis] > corner.w;
+            }
+            if (below || above) {
+                return VIEW_CULLED;
+            }
+        }
+        float minX = INFINITY, minY = INFINITY, maxX = -INFINITY, maxY = -INFINITY;
+        float nearest = 0.f;
+        for (const glm::vec4& corner : corners) {
+            // A box reaching through the near plane covers the camera
+            if (corner.z < -corner.w || corner.w <= 0.f) {
+                return VISIBLE;
+            }
+            glm::vec2 screen = ToScreen(corner);
+            minX = std::min(minX, screen.x);
+            maxX = std::max(maxX, screen.x);
+            minY = std::min(minY, screen.y);
+            maxY = std::max(maxY, screen.y);
+            nearest = std::max(nearest, 1.f / corner.w);
+        }
+        int tileMinX = ToTile(minX, TILE_WIDTH, m_TilesX), tileMaxX = ToTile(maxX, TILE_WIDTH, m_TilesX);
+        int tileMinY = ToTile(minY, TILE_HEIGHT, m_TilesY), tileMaxY = ToTile(maxY, TILE_HEIGHT, m_TilesY);
+        for (int y = tileMinY; y <= tileMaxY; y++) {
+            // Visible as soon as one tile's occluders are not all nearer than the box
+            const float* depths = &m_Depth0[(size_t)y * m_TilesX];
+            int x = tileMinX;
+#if defined(MASKED_OCCLUSION_CULLING_AVX2)
+            const __m256 nearestV = _mm256_set1_ps(nearest);
+            for (; x + 8 <= tileMaxX + 1; x += 8) {
+                if (_mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(depths + x), nearestV, _CMP_LE_OQ)) != 0) {
+                    return VISIBLE;
+                }
+            }
+#elif defined(MASKED_OCCLUSION_CULLING_SSE)
+            const __m128 nearestV = _mm_set1_ps(nearest);
+            for (; x + 4 <= tileMaxX + 1; x += 4) {
+                if (_mm_movemask_ps(_mm_cmple_ps(_mm_loadu_ps(depths + x), nearestV)) != 0) {
+                    return VISIBLE;
+                }
+            }
+#endif
+            for (; x <= tileMaxX; x++) {
+                if (depths[x] <= nearest) {
+                    return VISIBLE;
+                }
+            }
+        }
+        return OCCLUDED;
+    }
+    int GetTilesX() const {
+        return m_TilesX;
+    }
+    int GetTilesY() const {
+        return m_TilesY;
+    }
+    // Front facing occluder triangles after clipping, added since the last Clear
+    size_t GetTriangleCount() const {
+        return m_Triangles.size();
+    }
+    // The farthest depth (1 / w) of the occluders covering the whole tile, 0 when the tile is not covered yet
+    float GetTileDepth(int x, int y) const {
+        return m_Depth0[(size_t)y * m_TilesX + x];
+    }
+private:
+    static constexpr uint32_t FULL_MASK = 0xFFFFFFFFu;
+    // Screen space triangle, edge functions a * x + b * y + c are positive inside and the depth is a plane over the screen
+    struct Triangle {
+        float edgeA[3], edgeB[3], edgeC[3];
+        float depthA, depthB, depthC;
+        float minDepth, maxDepth;
+        int tileMinX, tileMaxX, tileMinY, tileMaxY;
+    };
+    glm::vec2 ToScreen(const glm::vec4& clip) const {
+        return { (clip.x / clip.w * .5f + .5f) * m_Width, (clip.y / clip.w * .5f + .5f) * m_Height };
+    }
+    // The tile a screen coordinate falls into, clamped to the screen before converting as points can project far off it
+    static int ToTile(float coordinate, int tileSize, int tileCount) {
+        return (int)std::clamp(coordinate / tileSize, 0.f, (float)(tileCount - 1));
+    }
+    // Clips a triangle against the near plane (z >= -w) and sets up the one or two triangles left
+    void AddClipTriangle(const glm::vec4 clip[3]) {
+        glm::vec4 polygon[4];
+        int count = 0;
+        for (int k = 0; k < 3; k++) {
+            const glm::vec4& a = clip[k];
+            const glm::vec4& b = clip[(k + 1) % 3];
+            float distanceA = a.z + a.w, distanceB = b.z + b.w;
+            if (distanceA >= 0.f) {
+                polygon[count++] = a;
+            }
+            if ((distanceA >= 0.f) != (distanceB >= 0.f)) {
+                polygon[count++] = a + (b - a) * (distanceA / (distanceA - distanceB));
+            }
+        }
+        for (int k = 1; k + 1 < count; k++) {
+            SetupTriangle(polygon[0], polygon[k], polygon[k + 1]);
+        }
+    }
+    void SetupTriangle(const glm::vec4& clip0, const glm::vec4& clip1, const glm::vec4& clip2) {
+        if (clip0.w <= 0.f || clip1.w <= 0.f || clip2.w <= 0.f) {
+            return;
+        }
+        glm::vec2 p[3] = { ToScreen(clip0), ToScreen(clip1), ToScreen(clip2) };
+        float z[3] = { 1.f / clip0.w, 1.f / clip1.w, 1.f / clip2.w };
+        float area = (p[1].x - p[0].x) * (p[2].y - p[0].y) - (p[2].x - p[0].x) * (p[1].y - p[0].y);
+        // Back facing or degenerate
+        if (!(area > 0.f)) {
+            return;
+        }
+        float minX = std::min({ p[0].x, p[1].x, p[2].x }), maxX = std::max({ p[0].x, p[1].x, p[2].x });
+        float minY = std::min({ p[0].y, p[1].y, p[2].y }), maxY = std::max({ p[0].y, p[1].y, p[2].y });
+        if (maxX < 0.f || maxY < 0.f || minX >= m_Width || minY >= m_Height) {
+            return;
+        }
+        Triangle triangle;
+        for (int k = 0; k < 3; k++) {
+            const glm::vec2& a = p[k];
+            const glm::vec2& b = p[(k + 1) % 3];
+            triangle.edgeA[k] = a.y - b.y;
+            triangle.edgeB[k] = b.x - a.x;
+            triangle.edgeC[k] = a.x * b.y - b.x * a.y;
+        }
+        triangle.depthA = ((z[1] - z[0]) * (p[2].y - p[0].y) - (z[2] - z[0]) * (p[1].y - p[0].y)) / area;
+        triangle.depthB = ((p[1].x - p[0].x) * (z[2] - z[0]) - (p[2].x - p[0].x) * (z[1] - z[0])) / area;
+        triangle.depthC = z[0] - triangle.depthA * p[0].x - triangle.depthB * p[0].y;
+        triangle.minDepth = std::min({ z[0], z[1], z[2] });
+        triangle.maxDepth = std::max({ z[0], z[1], z[2] });
+        triangle.tileMinX = ToTile(minX, TILE_WIDTH, m_TilesX);
+        triangle.tileMaxX = ToTile(maxX, TILE_WIDTH, m_TilesX);
+        triangle.tileMinY = ToTile(minY, TILE_HEIGHT, m_TilesY);
+        triangle.tileMaxY = ToTile(maxY, TILE_HEIGHT, m_TilesY);
+        m_Triangles.push_back(triangle);
+    }
+    // Covers one row of tiles with every triangle overlapping it, rows share no tiles so they run in parallel
+    void RasterizeRow(int y) {
+        for (const Triangle& triangle : m_Triangles) {
+            if (y < triangle.tileMinY || y > triangle.tileMaxY) {
+                continue;
+            }
+            float top = (float)(y * TILE_HEIGHT) + .5f, bottom = top + (TILE_HEIGHT - 1);
+            for (int x = triangle.tileMinX; x <= triangle.tileMaxX; x++) {
+                size_t tile = (size_t)y * m_TilesX + x;
+                // The depth plane is lowest at a corner of the tile's pixel centers, and never below the farthest vertex
+                float left = (float)(x * TILE_WIDTH) + .5f, right = left + (TILE_WIDTH - 1);
+                float depth = triangle.depthC + triangle.depthA * (triangle.depthA > 0.f ? left : right) + triangle.depthB * (triangle.depthB > 0.f ? top : bottom);
+                depth = std::clamp(depth, triangle.minDepth, triangle.maxDepth);
+                // Nothing to add behind the occluders already covering the tile
+                if (depth <= m_Depth0[tile]) {
+                    continue;
+                }
+                uint32_t mask = 0;
+                for (int row = 0; row < TILE_HEIGHT; row++) {
+                    mask |= RowCoverage(triangle, left - .5f, top + row) << (row * TILE_WIDTH);
+                }
+                if (mask != 0) {
+                    UpdateTile(tile, mask, depth);
+                }
+            }
+        }
+    }
+    // Coverage of a tile row's 8 pixel centers, bit i for column i
+    static uint32_t RowCoverage(const Triangle& triangle, float x, float y) {
+#if defined(MASKED_OCCLUSION_CULLING_AVX2)
+        const __m256 xs = _mm256_add_ps(_mm256_set1_ps(x), _mm256_setr_ps(.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f));
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (int k = 0; k < 3; k++) {
+            __m256 edge = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(triangle.edgeA[k]), xs), _mm256_set1_ps(triangle.edgeB[k] * y + triangle.edgeC[k]));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(edge, _mm256_setzero_ps(), _CMP_GE_OQ));
+        }
+        return (uint32_t)_mm256_movemask_ps(inside);
+#elif defined(MASKED_OCCLUSION_CULLING_SSE)
+        const __m128 low = _mm_add_ps(_mm_set1_ps(x), _mm_setr_ps(.5f, 1.5f, 2.5f, 3.5f));
+        const __m128 high = _mm_add_ps(low, _mm_set1_ps(4.f));
+        __m128 insideLow = _mm_castsi128_ps(_mm_set1_epi32(-1)), insideHigh = insideLow;
+        for (int k = 0; k < 3; k++) {
+            const __m128 a = _mm_set1_ps(triangle.edgeA[k]), row = _mm_set1_ps(triangle.edgeB[k] * y + triangle.edgeC[k]);
+            insideLow = _mm_and_ps(insideLow, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a, low), row), _mm_setzero_ps()));
+            insideHigh = _mm_and_ps(insideHigh, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a, high), row), _mm_setzero_ps()));
+        }
+        return (uint32_t)(_mm_movemask_ps(insideLow) | _mm_movemask_ps(insideHigh) << 4);
+#else
+        uint32_t mask = 0;
+        for (int i = 0; i < TILE_WIDTH; i++) {
+            bool inside = true;
+            for (int k = 0; k < 3; k++) {
+                inside &= triangle.edgeA[k] * (x + i + .5f) + triangle.edgeB[k] * y + triangle.edgeC[k] >= 0.f;
+            }
+            mask |= (uint32_t)inside << i;
+        }
+        return mask;
+#endif
+    }
+    /// <summary>Merges a triangle's coverage of a tile into the tile's layers</summary>
+    /// <param name="depth">The triangle's farthest depth within the tile</param>
+    void UpdateTile(size_t tile, uint32_t mask, float depth) {
+        uint32_t& tileMask = m_Masks[tile];
+        float& depth0 = m_Depth0[tile];
+        float& depth1 = m_Depth1[tile];
+        if (mask == FULL_MASK) {
+            depth0 = depth;
+        }
+        else {
+            tileMask |= mask;
+            depth1 = std::min(depth1, depth);
+            // The working layer covers the tile, its farthest depth becomes the tile's
+            if (tileMask == FULL_MASK) {
+                depth0 = std::max(depth0, depth1);
+                tileMask = 0;
+                depth1 = INFINITY;
+            }
+        }
+        // A working layer behind the tile's occluders adds nothing
+        if (depth1 <= depth0) {
+            tileMask = 0;
+            depth1 = INFINITY;
+        }
+    }
+private:
+    int m_TilesX{}, m_TilesY{};
+    float m_Width{}, m_Height{};
+    // Per tile, row by row: the working layer's coverage, the depth of the full layer and of the working layer
+    std::vector<uint32_t> m_Masks;
+    std::vector<float> m_Depth0;
+    std::vector<float> m_Depth1;
+    std::vector<Triangle> m_Triangles;
+};
@@ -0,0 +1,389 @@
+#pragma once
+
+#include <VertexFormat.hpp>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// The binary mesh format written offline by the MeshConverter tool, laid out as
+//     [Header][Stream table][Submesh table][Meshlet table][Vertex streams][Indices]
+// Every section starts 16 byte aligned and the vertex streams and indices are stored exactly as the gpu reads them,
+// so a mapped file is uploaded without any parsing.
+namespace meshfile {
+    // "GBMF" in a little endian file
+    constexpr uint32_t MAGIC = 0x464D4247;
+    constexpr uint32_t VERSION = 4;
+    constexpr uint64_t ALIGNMENT = 16;
+    // Vertex attributes, the value is the attribute location the shaders read them from
+    enum Attribute : uint32_t {
+        POSITION = 0,
+        TEXCOORD = 1,
+        NORMAL = 2,
+    };
+    // How a shader gets the attribute back from what vertex fetch returns
+    enum Encoding : uint32_t {
+        // Used as is
+        RAW = 0,
+        // Unsigned normalized within the mesh's bounds: boundsMin + value * (boundsMax - boundsMin)
+        BOUNDS = 1,
+        // Signed normalized octahedral normal in two components, see vertexcompression::OctahedralEncode
+        OCTAHEDRAL = 2,
+    };
+    struct Header {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t vertexCount;
+        uint32_t indexCount;
+        // Bytes per index, 2 when every vertex can be addressed with 16 bits
+        uint32_t indexSize;
+        uint32_t streamCount;
+        uint32_t submeshCount;
+        uint32_t meshletCount;
+        float boundsMin[3];
+        float boundsMax[3];
+        uint64_t streamTableOffset;
+        uint64_t submeshTableOffset;
+        uint64_t meshletTableOffset;
+        // All vertex streams in one block, uploaded as one buffer
+        uint64_t vertexDataOffset;
+        uint64_t vertexDataSize;
+        uint64_t indexDataOffset;
+        uint64_t indexDataSize;
+    };
+    // One vertex attribute stored as its own array
+    struct Stream {
+        uint32_t attribute;
+        uint32_t components;
+        // Gl type of a component
+        uint32_t type;
+        uint32_t normalized;
+        uint32_t stride;
+        uint32_t encoding;
+        // Relative to the vertex data block
+        uint64_t offset;
+    };
+    // A range of the index buffer drawn with one material at one level of detail, the submeshes of a level follow
+    // those of the finer levels and every level has the same submeshes in the same order
+    struct Submesh {
+        uint32_t firstIndex;
+        uint32_t indexCount;
+        uint32_t materialIndex;
+        uint32_t lod;
+        // Object space distance by which the level can deviate from the full detail surface, 0 for level 0
+        float lodError;
+        float boundsMin[3];
+        float boundsMax[3];
+        // The submesh's meshlets, they cover its index range in order
+        uint32_t firstMeshlet;
+        uint32_t meshletCount;
+    };
+    // A cluster of up to a few dozen triangles in a contiguous index range, culled on its own (see MeshletCuller)
+    struct Meshlet {
+        uint32_t firstIndex;
+        uint32_t indexCount;
+        // Object space bounding sphere
+        float center[3];
+        float radius;
+        // Normal cone: the meshlet faces away from cameras in direction d from the apex with dot(-d, axis) > cutoff,
+        // the cutoff is 1 when the triangles face too many directions to ever all face away
+        float coneApex[3];
+        float coneAxis[3];
+        float coneCutoff;
+    };
+    static_assert(sizeof(Header) == 112 && sizeof(Stream) == 32 && sizeof(Submesh) == 52 && sizeof(Meshlet) == 52,
+        "The file layout must not depend on padding");
+
+    // Mesh data on the cpu side, what the converter fills in before writing
+    struct MeshData {
+        std::vector<glm::vec3> positions;
+        // Optional streams, either empty or one entry per position
+        std::vector<glm::vec2> texCoords;
+        std::vector<glm::vec3> normals;
+        std::vector<uint32_t> indices;
+        // Everything but the bounds, those are computed when writing
+        std::vector<Submesh> submeshes;
+        // Optional, filled in by meshopt::BuildMeshlets
+        std::vector<Meshlet> meshlets;
+    };
+}
+
+// The mesh file class
+// Maps a converted mesh file read-only into memory and checks that its sections lie within the file.
+class MeshFile {
+public:
+    ~MeshFile() {
+#ifdef _WIN32
+        if (m_Data != nullptr) {
+            UnmapViewOfFile(m_Data);
+        }
+        if (m_Mapping != nullptr) {
+            CloseHandle(m_Mapping);
+        }
+        if (m_File != INVALID_HANDLE_VALUE) {
+            CloseHandle(m_File);
+        }
+#else
+        if (m_Data != nullptr) {
+            munmap(m_Data, m_Size);
+        }
+#endif
+    }
+    MeshFile(const MeshFile&) = delete;
+    MeshFile& operator=(const MeshFile&) = delete;
+    // Maps a mesh file, check IsValid before using it
+    static MeshFile Map(const char* filepath) {
+        return MeshFile(filepath);
+    }
+    /// <summary>Writes a mesh in the binary format</summary>
+    /// <param name="mesh">The mesh, texture coordinates and normals are only written when present for every vertex</param>
+    /// <param name="compress">Stores positions as 16 bit quantized to the bounds, normals octahedral in 2x16 bit and
+    /// texture coordinates as 16 bit unorm (half floats when they leave [0, 1]), 16 bytes per vertex instead of 32</param>
+    static bool Write(const char* filepath, const meshfile::MeshData& mesh, bool compress = true) {
+        using namespace meshfile;
+        size_t vertexCount = mesh.positions.size();
+        bool hasTexCoords = !mesh.texCoords.empty() && mesh.texCoords.size() == vertexCount;
+        bool hasNormals = !mesh.normals.empty() && mesh.normals.size() == vertexCount;
+        Header header{};
+        header.magic = MAGIC;
+        header.version = VERSION;
+        header.vertexCount = (uint32_t)vertexCount;
+        header.indexCount = (uint32_t)mesh.indices.size();
+        header.indexSize = vertexcompression::SelectIndexType(vertexCount) == GL_UNSIGNED_SHORT ? 2 : 4;
+        header.submeshCount = (uint32_t)mesh.submeshes.size();
+        header.meshletCount = (uint32_t)mesh.meshlets.size();
+        glm::vec3 min{ INFINITY }, max{ -INFINITY };
+        for (const glm::vec3& position : mesh.positions) {
+            min = glm::min(min, position);
+            max = glm::max(max, position);
+        }
+        memcpy(header.boundsMin, &min, sizeof(header.boundsMin));
+        memcpy(header.boundsMax, &max, sizeof(header.boundsMax));
+        // Every stream is a single attribute vertex format, the packer fills in one vertex at a time
+        struct StreamSource {
+            VertexFormat format;
+            std::function<void(size_t, float*)> values;
+        };
+        std::vector<Stream> streams;
+        std::vector<StreamSource> sources;
+        uint64_t vertexDataSize = 0;
+        auto addStream = [&](Attribute attribute, GLint components, GLenum type, bool normalized, Encoding encoding, std::function<void(size_t, float*)> values) {
+            VertexFormat format;
+            format.Add(attribute, components, type, normalized);
+            streams.push_back({ attribute, (uint32_t)components, type, normalized ? 1u : 0u, format.GetStride(), encoding, vertexDataSize });
+            sources.push_back({ format, std::move(values) });
+            vertexDataSize = Align(vertexDataSize + vertexCount * format.GetStride());
+        };
+        if (compress) {
+            addStream(POSITION, 3, GL_UNSIGNED_SHORT, true, BOUNDS, [&](size_t i, float* values) {
+                glm::vec3 quantized = vertexcompression::QuantizeToBounds(mesh.positions[i], min, max);
+                memcpy(values, &quantized, sizeof(quantized));
+            });
+        }
+        else {
+            addStream(POSITION, 3, GL_FLOAT, false, RAW, [&](size_t i, float* values) {
+                memcpy(values, &mesh.positions[i], sizeof(glm::vec3));
+            });
+        }
+        if (hasTexCoords) {
+            bool unitRange = true;
+            for (const glm::vec2& texCoord : mesh.texCoords) {
+                unitRange &= texCoord.x >= 0.f && texCoord.x <= 1.f && texCoord.y >= 0.f && texCoord.y <= 1.f;
+            }
+            GLenum type = !compress ? GL_FLOAT : unitRange ? GL_UNSIGNED_SHORT : GL_HALF_FLOAT;
+            addStream(TEXCOORD, 2, type, type == GL_UNSIGNED_SHORT, RAW, [&](size_t i, float* values) {
+                memcpy(values, &mesh.texCoords[i], sizeof(glm::vec2));
+            });
+        }
+        if (hasNormals) {
+            if (compress) {
+                addStream(NORMAL, 2, GL_SHORT, true, OCTAHEDRAL, [&](size_t i, float* values) {
+                    glm::vec2 encoded = vertexcompression::OctahedralEncode(mesh.normals[i]);
+                    memcpy(values, &encoded, sizeof(encoded));
+                });
+            }
+            else {
+                addStream(NORMAL, 3, GL_FLOAT, false, RAW, [&](size_t i, float* values) {
+                    memcpy(values, &mesh.normals[i], sizeof(glm::vec3));
+                });
+            }
+        }
+        header.streamCount = (uint32_t)streams.size();
+        header.streamTableOffset = Align(sizeof(Header));
+        header.submeshTableOffset = Align(header.streamTableOffset + streams.size() * sizeof(Stream));
+        header.meshletTableOffset = Align(header.submeshTableOffset + mesh.submeshes.size() * sizeof(Submesh));
+        header.vertexDataOffset = Align(header.meshletTableOffset + mesh.meshlets.size() * sizeof(Meshlet));
+        header.vertexDataSize = vertexDataSize;
+        header.indexDataOffset = header.vertexDataOffset + vertexDataSize;
+        header.indexDataSize = (uint64_t)mesh.indices.size() * header.indexSize;
+        std::vector<Submesh> submeshes = mesh.submeshes;
+        for (Submesh& submesh : submeshes) {
+            glm::vec3 submeshMin{ INFINITY }, submeshMax{ -INFINITY };
+            for (uint32_t i = submesh.firstIndex; i < submesh.firstIndex + submesh.indexCount && i < mesh.indices.size(); i++) {
+                submeshMin = glm::min(submeshMin, mesh.positions[mesh.indices[i]]);
+                submeshMax = glm::max(submeshMax, mesh.positions[mesh.indices[i]]);
+            }
+            memcpy(submesh.boundsMin, &submeshMin, sizeof(submesh.boundsMin));
+            memcpy(submesh.boundsMax, &submeshMax, sizeof(submesh.boundsMax));
+            if (mesh.meshlets.empty()) {
+                submesh.firstMeshlet = submesh.meshletCount = 0;
+            }
+        }
+        std::vector<char> file(header.indexDataOffset + header.indexDataSize, 0);
+        memcpy(file.data(), &header, sizeof(Header));
+        memcpy(file.data() + header.streamTableOffset, streams.data(), streams.size() * sizeof(Stream));
+        memcpy(file.data() + header.submeshTableOffset, submeshes.data(), submeshes.size() * sizeof(Submesh));
+        memcpy(file.data() + header.meshletTableOffset, mesh.meshlets.data(), mesh.meshlets.size() * sizeof(Meshlet));
+        char* vertexData = file.data() + header.vertexDataOffset;
+        for (size_t s = 0; s < streams.size(); s++) {
+            for (size_t i = 0; i < vertexCount; i++) {
+                float values[4];
+                sources[s].values(i, values);
+                sources[s].format.Pack(vertexData + streams[s].offset, i, 0, values);
+            }
+        }
+        std::vector<char> indices = vertexcompression::PackIndices(mesh.indices.data(), mesh.indices.size(), vertexCount);
+        memcpy(file.data() + header.indexDataOffset, indices.data(), indices.size());
+        std::ofstream stream{ filepath, std::ios::binary };
+        if (!stream.write(file.data(), (std::streamsize)file.size())) {
+            fprintf(stderr, "cannot write %s\n", filepath);
+            return false;
+        }
+        return true;
+    }
+    // Whether the file was mapped and its layout checks out
+    bool IsValid() const {
+        return m_Valid;
+    }
+    const meshfile::Header& GetHeader() const {
+        return *static_cast<const meshfile::Header*>(m_Data);
+    }
+    const meshfile::Stream* GetStreams() const {
+        return reinterpret_cast<const meshfile::Stream*>(GetBytes() + GetHeader().streamTableOffset);
+    }
+    const meshfile::Submesh* GetSubmeshes() const {
+        return reinterpret_cast<const meshfile::Submesh*>(GetBytes() + GetHeader().submeshTableOffset);
+    }
+    const meshfile::Meshlet* GetMeshlets() const {
+        return reinterpret_cast<const meshfile::Meshlet*>(GetBytes() + GetHeader().meshletTableOffset);
+    }
+    const void* GetVertexData() const {
+        return GetBytes() + GetHeader().vertexDataOffset;
+    }
+    const void* GetIndexData() const {
+        return GetBytes() + GetHeader().indexDataOffset;
+    }
+private:
+    // Mesh file constructor
+    MeshFile(const char* filepath) {
+#ifdef _WIN32
+        m_File = CreateFileA(filepath, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        LARGE_INTEGER size;
+        if (m_File == INVALID_HANDLE_VALUE || !GetFileSizeEx(m_File, &size) || size.QuadPart == 0) {
+            fprintf(stderr, "cannot open %s\n", filepath);
+            return;
+        }
+        m_Size = (size_t)size.QuadPart;
+        m_Mapping = CreateFileMappingA(m_File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        m_Data = m_Mapping != nullptr ? MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+#else
+        int file = open(filepath, O_RDONLY);
+        struct stat status;
+        if (file < 0 || fstat(file, &status) != 0 || status.st_size == 0) {
+            fprintf(stderr, "cannot open %s\n", filepath);
+            if (file >= 0) {
+                close(file);
+            }
+            return;
+        }
+        m_Size = (size_t)status.st_size;
+        m_Data = mmap(nullptr, m_Size, PROT_READ, MAP_PRIVATE, file, 0);
+        // The mapping keeps the file alive
+        close(file);
+        if (m_Data == MAP_FAILED) {
+            m_Data = nullptr;
+        }
+#endif
+        if (m_Data == nullptr) {
+            fprintf(stderr, "cannot map %s\n", filepath);
+            return;
+        }
+        m_Valid = Validate();
+        if (!m_Valid) {
+            fprintf(stderr, "%s is not a valid mesh file (version %u expected)\n", filepath, meshfile::VERSION);
+        }
+    }
+    bool Validate() const {
+        using namespace meshfile;
+        if (m_Size < sizeof(Header)) {
+            return false;
+        }
+        const Header& header = GetHeader();
+        auto inside = [&](uint64_t offset, uint64_t size) {
+            return offset % ALIGNMENT == 0 && offset <= m_Size && size <= m_Size - offset;
+        };
+        if (header.magic != MAGIC || header.version != VERSION || (header.indexSize != 2 && header.indexSize != 4) ||
+            !inside(header.streamTableOffset, (uint64_t)header.streamCount * sizeof(Stream)) ||
+            !inside(header.submeshTableOffset, (uint64_t)header.submeshCount * sizeof(Submesh)) ||
+            !inside(header.meshletTableOffset, (uint64_t)header.meshletCount * sizeof(Meshlet)) ||
+            !inside(header.vertexDataOffset, header.vertexDataSize) ||
+            !inside(header.indexDataOffset, header.indexDataSize) ||
+            header.indexDataSize < (uint64_t)header.indexCount * header.indexSize) {
+            return false;
+        }
+        for (uint32_t i = 0; i < header.streamCount; i++) {
+            const Stream& stream = GetStreams()[i];
+            if (stream.stride == 0 || stream.offset + (uint64_t)stream.stride * header.vertexCount > header.vertexDataSize) {
+                return false;
+            }
+        }
+        for (uint32_t i = 0; i < header.submeshCount; i++) {
+            const Submesh& submesh = GetSubmeshes()[i];
+            if ((uint64_t)submesh.firstIndex + submesh.indexCount > header.indexCount || (i > 0 && submesh.lod < GetSubmeshes()[i - 1].lod) ||
+                (uint64_t)submesh.firstMeshlet + submesh.meshletCount > header.meshletCount) {
+                return false;
+            }
+        }
+        for (uint32_t i = 0; i < header.meshletCount; i++) {
+            const Meshlet& meshlet = GetMeshlets()[i];
+            if ((uint64_t)meshlet.firstIndex + meshlet.indexCount > header.indexCount) {
+                return false;
+            }
+        }
+        return true;
+    }
+    const char* GetBytes() const {
+        return static_cast<const char*>(m_Data);
+    }
+    static uint64_t Align(uint64_t offset) {
+        return (offset + meshfile::ALIGNMENT - 1) & ~(meshfile::ALIGNMENT - 1);
+    }
+private:
+    void* m_Data{};
+    size_t m_Size{};
+    bool m_Valid{};
+#ifdef _WIN32
+    HANDLE m_File{ INVALID_HANDLE_VALUE };
+    HANDLE m_Mapping{};
+#endif
+};
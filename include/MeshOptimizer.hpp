@@ -0,0 +1,391 @@
+#pragma once
+
+#include <MeshFile.hpp>
+#include <MeshSimplifier.hpp>
+#include <MeshletBuilder.hpp>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <numeric>
+#include <unordered_map>
+#include <vector>
+
+// Mesh processing run offline on imported meshes, which arrive in whatever order the exporter wrote them.
+// The steps are meant to run in the order of Optimize: welding first so the simplifier and the cache order see the
+// shared vertices, the overdraw order only moves whole clusters of the cache order around, the meshlets grow from
+// that order and are cache ordered again within themselves, and the fetch order goes last because it follows the
+// final index order.
+namespace meshopt {
+    // Size of the fifo cache the statistics model, about what current gpus reuse
+    constexpr uint32_t STATISTICS_CACHE_SIZE = 16;
+    // Size of the lru cache the vertex cache order scores with
+    constexpr int SCORING_CACHE_SIZE = 32;
+    // Factor by which the overdraw order may worsen the acmr of a cluster to get smaller clusters
+    constexpr float DEFAULT_OVERDRAW_THRESHOLD = 1.05f;
+
+    struct VertexCacheStatistics {
+        uint32_t transformedVertices;
+        // Average cache miss ratio, transformed vertices per triangle: .5 at best for a regular grid, 3 at worst
+        float acmr;
+        // Average transform to vertex ratio, transformed vertices per referenced vertex: 1 at best
+        float atvr;
+    };
+
+    /// <summary>Simulates a fifo post-transform vertex cache over an index list</summary>
+    /// <param name="vertexCount">Number of vertices the indices point into</param>
+    inline VertexCacheStatistics AnalyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize = STATISTICS_CACHE_SIZE) {
+        // A vertex is in the cache when fewer than cacheSize misses happened since its own miss
+        std::vector<uint32_t> missTime(vertexCount, 0);
+        uint32_t time = cacheSize + 1;
+        uint32_t referenced = 0;
+        for (size_t i = 0; i < indexCount; i++) {
+            uint32_t vertex = indices[i];
+            if (missTime[vertex] == 0) {
+                referenced++;
+            }
+            if (time - missTime[vertex] > cacheSize) {
+                missTime[vertex] = time++;
+            }
+        }
+        VertexCacheStatistics statistics{};
+        statistics.transformedVertices = time - (cacheSize + 1);
+        statistics.acmr = indexCount >= 3 ? (float)statistics.transformedVertices / (float)(indexCount / 3) : 0.f;
+        statistics.atvr = referenced > 0 ? (float)statistics.transformedVertices / (float)referenced : 0.f;
+        return statistics;
+    }
+
+    /// <summary>Reorders triangles so their vertices are reused while still in the post-transform cache</summary>
+    /// <remarks>Forsyth's linear-speed optimization: vertices are scored by their position in a simulated lru cache
+    /// and by how few triangles still use them, the next triangle is the best scoring one among the triangles of
+    /// the cached vertices.</remarks>
+    inline void OptimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount) {
+        size_t triangleCount = indexCount / 3;
+        if (triangleCount == 0) {
+            return;
+        }
+        std::vector<uint32_t> source(indices, indices + triangleCount * 3);
+        // Triangles of every vertex, the first remaining[vertex] entries are the ones not emitted yet
+        std::vector<uint32_t> offsets(vertexCount + 1, 0);
+        std::vector<uint32_t> remaining(vertexCount, 0);
+        for (uint32_t vertex : source) {
+            remaining[vertex]++;
+        }
+        for (size_t v = 0; v < vertexCount; v++) {
+            offsets[v + 1] = offsets[v] + remaining[v];
+        }
+        std::vector<uint32_t> adjacency(source.size());
+        {
+            std::vector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+            for (size_t i = 0; i < source.size(); i++) {
+                adjacency[cursor[source[i]]++] = (uint32_t)(i / 3);
+            }
+        }
+        std::vector<int> cachePosition(vertexCount, -1);
+        auto vertexScore = [&](uint32_t vertex) {
+            if (remaining[vertex] == 0) {
+                return -1.f;
+            }
+            float score = 0.f;
+            int position = cachePosition[vertex];
+            // The last triangle's vertices score a little lower so the strip does not turn back on itself
+            if (position >= 0) {
+                score = position < 3 ? .75f : std::pow(1.f - (float)(position - 3) / (SCORING_CACHE_SIZE - 3), 1.5f);
+            }
+            // Vertices with few triangles left are finished first so they leave the cache for good
+            return score + 2.f / std::sqrt((float)remaining[vertex]);
+        };
+        std::vector<float> vertexScores(vertexCount);
+        for (size_t v = 0; v < vertexCount; v++) {
+            vertexScores[v] = vertexScore((uint32_t)v);
+        }
+        std::vector<float> triangleScores(triangleCount);
+        std::vector<bool> emitted(triangleCount, false);
+        for (size_t t = 0; t < triangleCount; t++) {
+            triangleScores[t] = vertexScores[source[t * 3]] + vertexScores[source[t * 3 + 1]] + vertexScores[source[t * 3 + 2]];
+        }
+        uint32_t cache[SCORING_CACHE_SIZE + 3];
+        int cacheCount = 0;
+        size_t fallback = 0;
+        int64_t best = std::max_element(triangleScores.begin(), triangleScores.end()) - triangleScores.begin();
+        for (size_t emittedCount = 0; emittedCount < triangleCount; emittedCount++) {
+            const uint32_t* triangle = &source[(size_t)best * 3];
+            memcpy(indices + emittedCount * 3, triangle, 3 * sizeof(uint32_t));
+            emitted[(size_t)best] = true;
+            for (int k = 0; k < 3; k++) {
+                uint32_t vertex = triangle[k];
+                uint32_t* list = &adjacency[offsets[vertex]];
+                uint32_t* found = std::find(list, list + remaining[vertex], (uint32_t)best);
+                *found = list[--remaining[vertex]];
+            }
+            // The triangle's vertices move to the front, the others shift back and fall out past the cache size
+            uint32_t newCache[SCORING_CACHE_SIZE + 3];
+            int newCount = 0;
+            for (int k = 0; k < 3; k++) {
+                newCache[newCount++] = triangle[k];
+            }
+            for (int i = 0; i < cacheCount; i++) {
+                if (cache[i] != triangle[0] && cache[i] != triangle[1] && cache[i] != triangle[2]) {
+                    newCache[newCount++] = cache[i];
+                }
+            }
+            for (int i = 0; i < newCount; i++) {
+                cachePosition[newCache[i]] = i < SCORING_CACHE_SIZE ? i : -1;
+                vertexScores[newCache[i]] = vertexScore(newCache[i]);
+            }
+            best = -1;
+            float bestScore = -1.f;
+            for (int i = 0; i < newCount; i++) {
+                uint32_t vertex = newCache[i];
+                for (uint32_t j = 0; j < remaining[vertex]; j++) {
+                    uint32_t t = adjacency[offsets[vertex] + j];
+                    triangleScores[t] = vertexScores[source[t * 3]] + vertexScores[source[t * 3 + 1]] + vertexScores[source[t * 3 + 2]];
+                    if (i < SCORING_CACHE_SIZE && triangleScores[t] > bestScore) {
+                        best = t;
+                        bestScore = triangleScores[t];
+                    }
+                }
+            }
+            cacheCount = std::min(newCount, SCORING_CACHE_SIZE);
+            memcpy(cache, newCache, cacheCount * sizeof(uint32_t));
+            // Nothing left around the cache, continue with the next triangle in the input order
+            if (best < 0) {
+                while (fallback < triangleCount && emitted[fallback]) {
+                    fallback++;
+                }
+                best = (int64_t)fallback;
+            }
+        }
+    }
+
+    /// <summary>Reorders clusters of a vertex cache ordered index list so outward facing surfaces draw first</summary>
+    /// <remarks>The view-independent sort of Sander et al. (Tipsify): the list is cut where the cache restarts anyway
+    /// (a triangle with three misses) and where the running acmr is within threshold of its cluster's, then clusters
+    /// are sorted by how far they face away from the mesh's centroid. Those tend to occlude the rest from any view.</remarks>
+    inline void OptimizeOverdraw(uint32_t* indices, size_t indexCount, const glm::vec3* positions, size_t vertexCount, float threshold = DEFAULT_OVERDRAW_THRESHOLD) {
+        size_t triangleCount = indexCount / 3;
+        if (triangleCount == 0) {
+            return;
+        }
+        std::vector<uint32_t> missTime(vertexCount, 0);
+        uint32_t time = STATISTICS_CACHE_SIZE + 1;
+        auto misses = [&](size_t t) {
+            uint32_t count = 0;
+            for (int k = 0; k < 3; k++) {
+                uint32_t vertex = indices[t * 3 + k];
+                if (time - missTime[vertex] > STATISTICS_CACHE_SIZE) {
+                    missTime[vertex] = time++;
+                    count++;
+                }
+            }
+            return count;
+        };
+        auto flush = [&]() {
+            time += STATISTICS_CACHE_SIZE + 1;
+        };
+        std::vector<size_t> hardBoundaries;
+        for (size_t t = 0; t < triangleCount; t++) {
+            if (misses(t) == 3) {
+                hardBoundaries.push_back(t);
+            }
+        }
+        hardBoundaries.push_back(triangleCount);
+        // Hard clusters are split further where the cache order can restart without losing more than threshold
+        std::vector<size_t> boundaries;
+        for (size_t c = 0; c + 1 < hardBoundaries.size(); c++) {
+            size_t start = hardBoundaries[c], end = hardBoundaries[c + 1];
+            flush();
+            uint32_t clusterMisses = 0;
+            for (size_t t = start; t < end; t++) {
+                clusterMisses += misses(t);
+            }
+            float clusterThreshold = (float)clusterMisses / (float)(end - start) * threshold;
+            flush();
+            boundaries.push_back(start);
+            size_t softStart = start;
+            uint32_t softMisses = 0;
+            for (size_t t = start; t < end; t++) {
+                softMisses += misses(t);
+                if (t + 1 < end && (float)softMisses / (float)(t + 1 - softStart) <= clusterThreshold) {
+                    boundaries.push_back(t + 1);
+                    softStart = t + 1;
+                    softMisses = 0;
+                    flush();
+                }
+            }
+        }
+        boundaries.push_back(triangleCount);
+        size_t clusterCount = boundaries.size() - 1;
+        std::vector<glm::vec3> centroids(clusterCount, glm::vec3(0.f));
+        std::vector<glm::vec3> normals(clusterCount, glm::vec3(0.f));
+        std::vector<float> areas(clusterCount, 0.f);
+        glm::vec3 meshCentroid{ 0.f };
+        float meshArea = 0.f;
+        for (size_t c = 0; c < clusterCount; c++) {
+            for (size_t t = boundaries[c]; t < boundaries[c + 1]; t++) {
+                const glm::vec3& a = positions[indices[t * 3]];
+                const glm::vec3& b = positions[indices[t * 3 + 1]];
+                const glm::vec3& d = positions[indices[t * 3 + 2]];
+                // Twice the area weighted normal
+                glm::vec3 normal = glm::cross(b - a, d - a);
+                float area = glm::length(normal);
+                centroids[c] += (a + b + d) * (area / 3.f);
+                normals[c] += normal;
+                areas[c] += area;
+            }
+            meshCentroid += centroids[c];
+            meshArea += areas[c];
+        }
+        meshCentroid = meshArea > 0.f ? meshCentroid / meshArea : meshCentroid;
+        std::vector<float> keys(clusterCount, 0.f);
+        for (size_t c = 0; c < clusterCount; c++) {
+            float normalLength = glm::length(normals[c]);
+            if (areas[c] > 0.f && normalLength > 0.f) {
+                keys[c] = glm::dot(centroids[c] / areas[c] - meshCentroid, normals[c] / normalLength);
+            }
+        }
+        std::vector<size_t> order(clusterCount);
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+            return keys[a] > keys[b];
+        });
+        std::vector<uint32_t> source(indices, indices + triangleCount * 3);
+        size_t written = 0;
+        for (size_t c : order) {
+            size_t count = (boundaries[c + 1] - boundaries[c]) * 3;
+            memcpy(indices + written, &source[boundaries[c] * 3], count * sizeof(uint32_t));
+            written += count;
+        }
+    }
+
+    // Moves vertex at index i of the streams to remap[i], vertices mapped to UINT32_MAX are dropped
+    inline void RemapVertices(meshfile::MeshData& mesh, const std::vector<uint32_t>& remap, size_t newVertexCount) {
+        auto remapStream = [&](auto& stream) {
+            if (stream.empty()) {
+                return;
+            }
+            std::remove_reference_t<decltype(stream)> remapped(newVertexCount);
+            for (size_t i = 0; i < remap.size(); i++) {
+                if (remap[i] != UINT32_MAX) {
+                    remapped[remap[i]] = stream[i];
+                }
+            }
+            stream.swap(remapped);
+        };
+        remapStream(mesh.positions);
+        remapStream(mesh.texCoords);
+        remapStream(mesh.normals);
+        for (uint32_t& index : mesh.indices) {
+            index = remap[index];
+        }
+    }
+
+    /// <summary>Merges vertices whose attributes are bitwise identical</summary>
+    /// <returns>The vertex count after welding</returns>
+    inline size_t WeldVertices(meshfile::MeshData& mesh) {
+        struct Key {
+            float values[8];
+            bool operator==(const Key& other) const {
+                return memcmp(values, other.values, sizeof(values)) == 0;
+            }
+        };
+        struct KeyHash {
+            size_t operator()(const Key& key) const {
+                // FNV-1a over the bytes
+                uint64_t hash = 14695981039346656037ull;
+                const unsigned char* bytes = reinterpret_cast<const unsigned char*>(key.values);
+                for (size_t i = 0; i < sizeof(key.values); i++) {
+                    hash = (hash ^ bytes[i]) * 1099511628211ull;
+                }
+                return (size_t)hash;
+            }
+        };
+        size_t vertexCount = mesh.positions.size();
+        std::unordered_map<Key, uint32_t, KeyHash> unique;
+        unique.reserve(vertexCount);
+        std::vector<uint32_t> remap(vertexCount);
+        uint32_t uniqueCount = 0;
+        for (size_t i = 0; i < vertexCount; i++) {
+            Key key{};
+            memcpy(key.values, &mesh.positions[i], sizeof(glm::vec3));
+            if (!mesh.texCoords.empty()) {
+                memcpy(key.values + 3, &mesh.texCoords[i], sizeof(glm::vec2));
+            }
+            if (!mesh.normals.empty()) {
+                memcpy(key.values + 5, &mesh.normals[i], sizeof(glm::vec3));
+            }
+            // -0 and 0 compare equal but differ in their bits
+            for (float& value : key.values) {
+                value = value == 0.f ? 0.f : value;
+            }
+            auto [it, inserted] = unique.try_emplace(key, uniqueCount);
+            remap[i] = it->second;
+            uniqueCount += inserted ? 1 : 0;
+        }
+        // Groups are numbered in the order they are first found, which keeps the streams in their order
+        RemapVertices(mesh, remap, uniqueCount);
+        return uniqueCount;
+    }
+
+    /// <summary>Renumbers vertices in the order the indices first use them so vertex fetch reads memory linearly</summary>
+    /// <returns>The vertex count afterwards, vertices no index uses are dropped</returns>
+    inline size_t OptimizeVertexFetch(meshfile::MeshData& mesh) {
+        std::vector<uint32_t> remap(mesh.positions.size(), UINT32_MAX);
+        uint32_t next = 0;
+        for (uint32_t index : mesh.indices) {
+            if (remap[index] == UINT32_MAX) {
+                remap[index] = next++;
+            }
+        }
+        RemapVertices(mesh, remap, next);
+        return next;
+    }
+
+    // Vertex cache order within every meshlet's index range, on vertices renumbered locally so each runs in meshlet time
+    inline void OptimizeMeshletVertexCache(meshfile::MeshData& mesh) {
+        std::vector<uint32_t> local(mesh.positions.size(), UINT32_MAX);
+        std::vector<uint32_t> global;
+        for (const meshfile::Meshlet& meshlet : mesh.meshlets) {
+            uint32_t* indices = mesh.indices.data() + meshlet.firstIndex;
+            global.clear();
+            for (uint32_t i = 0; i < meshlet.indexCount; i++) {
+                if (local[indices[i]] == UINT32_MAX) {
+                    local[indices[i]] = (uint32_t)global.size();
+                    global.push_back(indices[i]);
+                }
+                indices[i] = local[indices[i]];
+            }
+            OptimizeVertexCache(indices, meshlet.indexCount, global.size());
+            for (uint32_t i = 0; i < meshlet.indexCount; i++) {
+                indices[i] = global[indices[i]];
+            }
+            for (uint32_t vertex : global) {
+                local[vertex] = UINT32_MAX;
+            }
+        }
+    }
+
+    /// <summary>Runs every step, the cache and overdraw orders within each submesh's index range</summary>
+    /// <param name="lodCount">Levels of detail to generate (see GenerateLods), 1 keeps only the full detail mesh</param>
+    /// <param name="meshlets">Splits the submeshes into meshlets for culling (see BuildMeshlets)</param>
+    /// <returns>The number of levels generated</returns>
+    inline int Optimize(meshfile::MeshData& mesh, int lodCount = 1, float overdrawThreshold = DEFAULT_OVERDRAW_THRESHOLD, bool meshlets = true) {
+        WeldVertices(mesh);
+        if (lodCount > 1) {
+            lodCount = GenerateLods(mesh, lodCount);
+        }
+        for (const meshfile::Submesh& submesh : mesh.submeshes) {
+            uint32_t* indices = mesh.indices.data() + submesh.firstIndex;
+            OptimizeVertexCache(indices, submesh.indexCount, mesh.positions.size());
+            OptimizeOverdraw(indices, submesh.indexCount, mesh.positions.data(), mesh.positions.size(), overdrawThreshold);
+        }
+        if (meshlets) {
+            BuildMeshlets(mesh);
+            OptimizeMeshletVertexCache(mesh);
+        }
+        OptimizeVertexFetch(mesh);
+        return std::max(lodCount, 1);
+    }
+}
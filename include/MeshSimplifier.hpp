@@ -0,0 +1,302 @@
+#pragma once
+
+#include <MeshFile.hpp>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+
+// Level of detail generation, part of the offline mesh processing next to MeshOptimizer.hpp
+namespace meshopt {
+    // Levels GenerateLods produces at most, including the full detail one
+    constexpr int DEFAULT_LOD_COUNT = 4;
+    // Fraction of the triangles each level keeps of the previous one
+    constexpr float DEFAULT_LOD_REDUCTION = .5f;
+    // Largest error a level may reach, relative to the diagonal of the mesh's bounds
+    constexpr float DEFAULT_MAX_LOD_ERROR = .05f;
+
+    // Sum of squared distances to a set of planes as a symmetric 4x4 matrix (Garland and Heckbert)
+    struct Quadric {
+        // a^2 ab ac ad b^2 bc bd c^2 cd d^2 of the summed planes ax + by + cz + d = 0
+        double m[10]{};
+        static Quadric FromPlane(const glm::dvec3& normal, double d) {
+            Quadric q;
+            double a = normal.x, b = normal.y, c = normal.z;
+            double values[10] = { a * a, a * b, a * c, a * d, b * b, b * c, b * d, c * c, c * d, d * d };
+            memcpy(q.m, values, sizeof(values));
+            return q;
+        }
+        Quadric& operator+=(const Quadric& other) {
+            for (int i = 0; i < 10; i++) {
+                m[i] += other.m[i];
+            }
+            return *this;
+        }
+        double Evaluate(const glm::vec3& p) const {
+            double x = p.x, y = p.y, z = p.z;
+            return m[0] * x * x + 2. * m[1] * x * y + 2. * m[2] * x * z + 2. * m[3] * x + m[4] * y * y + 2. * m[5] * y * z + 2. * m[6] * y +
+                m[7] * z * z + 2. * m[8] * z + m[9];
+        }
+    };
+
+    /// <summary>Simplifies a triangle list by collapsing edges in the order of their quadric error</summary>
+    /// <remarks>A vertex is always collapsed onto one of its neighbours, so the result indexes the same vertices and
+    /// their attributes stay exact. Vertices on open borders and on attribute seams (several vertices sharing a
+    /// position) are locked, and collapses that would flip a triangle are rejected.</remarks>
+    /// <param name="targetIndexCount">Stops once the result has at most this many indices</param>
+    /// <param name="maxError">Stops before a collapse would move the surface further than this</param>
+    /// <param name="resultError">Receives the largest error of the collapses done</param>
+    inline std::vector<uint32_t> Simplify(const uint32_t* indices, size_t indexCount, const glm::vec3* positions, size_t vertexCount,
+        size_t targetIndexCount, float maxError, float* resultError = nullptr) {
+        size_t triangleCount = indexCount / 3;
+        std::vector<uint32_t> triangles(indices, indices + triangleCount * 3);
+        // Vertices that share a position are one vertex to the topology
+        struct PositionKey {
+            uint32_t bits[3];
+            bool operator==(const PositionKey& other) const {
+                return memcmp(bits, other.bits, sizeof(bits)) == 0;
+            }
+        };
+        struct PositionHash {
+            size_t operator()(const PositionKey& key) const {
+                return (size_t)(key.bits[0] * 73856093u ^ key.bits[1] * 19349663u ^ key.bits[2] * 83492791u);
+            }
+        };
+        std::unordered_map<PositionKey, uint32_t, PositionHash> positionIds;
+        positionIds.reserve(vertexCount);
+        std::vector<uint32_t> canonical(vertexCount);
+        std::vector<uint32_t> sharing(vertexCount, 0);
+        for (size_t v = 0; v < vertexCount; v++) {
+            PositionKey key;
+            memcpy(key.bits, &positions[v], sizeof(key.bits));
+            canonical[v] = positionIds.try_emplace(key, (uint32_t)v).first->second;
+            sharing[canonical[v]]++;
+        }
+        std::vector<bool> locked(vertexCount, false);
+        for (size_t v = 0; v < vertexCount; v++) {
+            locked[v] = sharing[canonical[v]] > 1;
+        }
+        // Edges used by a single triangle are on a border
+        std::unordered_map<uint64_t, int> edgeUses;
+        auto edgeKey = [&](uint32_t a, uint32_t b) {
+            a = canonical[a];
+            b = canonical[b];
+            return a < b ? (uint64_t)a << 32 | b : (uint64_t)b << 32 | a;
+        };
+        for (size_t t = 0; t < triangleCount; t++) {
+            for (int k = 0; k < 3; k++) {
+                edgeUses[edgeKey(triangles[t * 3 + k], triangles[t * 3 + (k + 1) % 3])]++;
+            }
+        }
+        for (size_t t = 0; t < triangleCount; t++) {
+            for (int k = 0; k < 3; k++) {
+                uint32_t a = triangles[t * 3 + k], b = triangles[t * 3 + (k + 1) % 3];
+                if (edgeUses[edgeKey(a, b)] == 1) {
+                    locked[a] = locked[b] = true;
+                }
+            }
+        }
+        std::vector<Quadric> quadrics(vertexCount);
+        std::vector<std::vector<uint32_t>> adjacency(vertexCount);
+        for (size_t t = 0; t < triangleCount; t++) {
+            glm::dvec3 a{ positions[triangles[t * 3]] }, b{ positions[triangles[t * 3 + 1]] }, c{ positions[triangles[t * 3 + 2]] };
+            glm::dvec3 normal = glm::cross(b - a, c - a);
+            double length = glm::length(normal);
+            if (length > 0.) {
+                normal /= length;
+                Quadric plane = Quadric::FromPlane(normal, -glm::dot(normal, a));
+                for (int k = 0; k < 3; k++) {
+                    quadrics[triangles[t * 3 + k]] += plane;
+                }
+            }
+            for (int k = 0; k < 3; k++) {
+                adjacency[triangles[t * 3 + k]].push_back((uint32_t)t);
+            }
+        }
+        struct Collapse {
+            double cost;
+            uint32_t from, to;
+            bool operator>(const Collapse& other) const {
+                return cost > other.cost;
+            }
+        };
+        std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> queue;
+        std::vector<bool> removed(vertexCount, false);
+        std::vector<bool> deadTriangle(triangleCount, false);
+        auto cost = [&](uint32_t from, uint32_t to) {
+            Quadric q = quadrics[from];
+            q += quadrics[to];
+            return std::max(q.Evaluate(positions[to]), 0.);
+        };
+        auto pushEdges = [&](uint32_t vertex) {
+            for (uint32_t t : adjacency[vertex]) {
+                if (deadTriangle[t]) {
+                    continue;
+                }
+                for (int k = 0; k < 3; k++) {
+                    uint32_t other = triangles[t * 3 + k];
+                    if (other == vertex) {
+                        continue;
+                    }
+                    if (!locked[vertex]) {
+                        queue.push({ cost(vertex, other), vertex, other });
+                    }
+                    if (!locked[other]) {
+                        queue.push({ cost(other, vertex), other, vertex });
+                    }
+                }
+            }
+        };
+        for (size_t v = 0; v < vertexCount; v++) {
+            if (!adjacency[v].empty() && !locked[v]) {
+                pushEdges((uint32_t)v);
+            }
+        }
+        size_t liveTriangles = triangleCount;
+        double maxCost = (double)maxError * maxError;
+        double reachedCost = 0.;
+        while (!queue.empty() && liveTriangles * 3 > targetIndexCount) {
+            Collapse collapse = queue.top();
+            queue.pop();
+            if (removed[collapse.from] || removed[collapse.to]) {
+                continue;
+            }
+            // Entries are not updated when quadrics grow, a stale one goes back in with its current cost
+            double current = cost(collapse.from, collapse.to);
+            if (current > collapse.cost * (1. + 1e-9) + 1e-30) {
+                queue.push({ current, collapse.from, collapse.to });
+                continue;
+            }
+            if (current > maxCost) {
+                break;
+            }
+            // Moving the vertex must not flip or flatten the triangles it keeps
+            bool valid = true;
+            bool connected = false;
+            for (uint32_t t : adjacency[collapse.from]) {
+                if (deadTriangle[t]) {
+                    continue;
+                }
+                const uint32_t* triangle = &triangles[t * 3];
+                if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to) {
+                    connected = true;
+                    continue;
+                }
+                glm::vec3 corners[3], moved[3];
+                for (int k = 0; k < 3; k++) {
+                    corners[k] = positions[triangle[k]];
+                    moved[k] = triangle[k] == collapse.from ? positions[collapse.to] : corners[k];
+                }
+                glm::vec3 before = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+                glm::vec3 after = glm::cross(moved[1] - moved[0], moved[2] - moved[0]);
+                if (glm::dot(before, after) <= .2f * glm::length(before) * glm::length(after)) {
+                    valid = false;
+                    break;
+                }
+            }
+            if (!valid || !connected) {
+                continue;
+            }
+            removed[collapse.from] = true;
+            quadrics[collapse.to] += quadrics[collapse.from];
+            reachedCost = std::max(reachedCost, current);
+            for (uint32_t t : adjacency[collapse.from]) {
+                if (deadTriangle[t]) {
+                    continue;
+                }
+                uint32_t* triangle = &triangles[t * 3];
+                for (int k = 0; k < 3; k++) {
+                    triangle[k] = triangle[k] == collapse.from ? collapse.to : triangle[k];
+                }
+                if (triangle[0] == triangle[1] || triangle[1] == triangle[2] || triangle[2] == triangle[0]) {
+                    deadTriangle[t] = true;
+                    liveTriangles--;
+                }
+                else {
+                    adjacency[collapse.to].push_back(t);
+                }
+            }
+            adjacency[collapse.from].clear();
+            // Keeps the list from filling up with dead triangles
+            std::vector<uint32_t>& list = adjacency[collapse.to];
+            list.erase(std::remove_if(list.begin(), list.end(), [&](uint32_t t) {
+                return deadTriangle[t];
+            }), list.end());
+            pushEdges(collapse.to);
+        }
+        std::vector<uint32_t> result;
+        result.reserve(liveTriangles * 3);
+        for (size_t t = 0; t < triangleCount; t++) {
+            if (!deadTriangle[t]) {
+                result.insert(result.end(), &triangles[t * 3], &triangles[t * 3] + 3);
+            }
+        }
+        if (resultError != nullptr) {
+            *resultError = (float)std::sqrt(reachedCost);
+        }
+        return result;
+    }
+
+    /// <summary>Appends coarser levels of detail of the level 0 submeshes to the mesh</summary>
+    /// <remarks>Each level aims for reduction times the triangles of the previous one and is simplified from the full
+    /// detail mesh so its error is measured against the real surface. The chain stops early once the simplifier
+    /// cannot reduce further without exceeding maxError.</remarks>
+    /// <param name="maxError">Largest error relative to the diagonal of the mesh's bounds</param>
+    /// <returns>The number of levels, including level 0</returns>
+    inline int GenerateLods(meshfile::MeshData& mesh, int maxLodCount = DEFAULT_LOD_COUNT, float reduction = DEFAULT_LOD_REDUCTION,
+        float maxError = DEFAULT_MAX_LOD_ERROR) {
+        glm::vec3 min{ INFINITY }, max{ -INFINITY };
+        for (const glm::vec3& position : mesh.positions) {
+            min = glm::min(min, position);
+            max = glm::max(max, position);
+        }
+        float errorLimit = mesh.positions.empty() ? 0.f : glm::length(max - min) * maxError;
+        std::vector<meshfile::Submesh> baseLevel;
+        for (const meshfile::Submesh& submesh : mesh.submeshes) {
+            if (submesh.lod == 0) {
+                baseLevel.push_back(submesh);
+            }
+        }
+        int lodCount = 1;
+        std::vector<size_t> previousCounts;
+        for (const meshfile::Submesh& submesh : baseLevel) {
+            previousCounts.push_back(submesh.indexCount);
+        }
+        for (int lod = 1; lod < maxLodCount; lod++) {
+            std::vector<meshfile::Submesh> level;
+            std::vector<std::vector<uint32_t>> levelIndices;
+            size_t before = 0, after = 0;
+            for (size_t i = 0; i < baseLevel.size(); i++) {
+                const meshfile::Submesh& base = baseLevel[i];
+                size_t target = (size_t)((float)previousCounts[i] / 3 * reduction) * 3;
+                float error = 0.f;
+                levelIndices.push_back(Simplify(mesh.indices.data() + base.firstIndex, base.indexCount, mesh.positions.data(), mesh.positions.size(),
+                    target, errorLimit, &error));
+                meshfile::Submesh submesh = base;
+                submesh.lod = (uint32_t)lod;
+                submesh.lodError = error;
+                level.push_back(submesh);
+                before += previousCounts[i];
+                after += levelIndices.back().size();
+            }
+            // A level that is barely smaller than the previous one is not worth switching to
+            if ((float)after > (float)before * (reduction + 1.f) * .5f) {
+                break;
+            }
+            for (size_t i = 0; i < level.size(); i++) {
+                level[i].firstIndex = (uint32_t)mesh.indices.size();
+                level[i].indexCount = (uint32_t)levelIndices[i].size();
+                mesh.indices.insert(mesh.indices.end(), levelIndices[i].begin(), levelIndices[i].end());
+                mesh.submeshes.push_back(level[i]);
+                previousCounts[i] = levelIndices[i].size();
+            }
+            lodCount++;
+        }
+        return lodCount;
+    }
+}
@@ -0,0 +1,229 @@
+#pragma once
+
+#include <MeshFile.hpp>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Meshlet clustering, part of the offline mesh processing next to MeshOptimizer.hpp
+namespace meshopt {
+    // Limits of a meshlet, the sizes mesh shading hardware favours, small enough for the bounds to cull well
+    constexpr uint32_t DEFAULT_MESHLET_VERTICES = 64;
+    constexpr uint32_t DEFAULT_MESHLET_TRIANGLES = 124;
+    // How much a triangle facing away from the meshlet's average normal counts against it compared to a new vertex,
+    // higher values give narrower normal cones at the cost of more vertices per triangle
+    constexpr float DEFAULT_MESHLET_CONE_WEIGHT = .5f;
+    // Normal cones spreading wider than this (the smallest dot product with the axis) are not worth testing
+    constexpr float MIN_MESHLET_CONE_DOT = .1f;
+
+    /// <summary>Bounding sphere and normal cone of a meshlet's triangles</summary>
+    /// <remarks>The cone apex lies behind every triangle's plane, so a camera whose direction to the apex is within
+    /// the cone's complement sees all triangles from behind (see MeshletCuller)</remarks>
+    inline void ComputeMeshletBounds(meshfile::Meshlet& meshlet, const uint32_t* indices, const glm::vec3* positions) {
+        glm::vec3 min{ INFINITY }, max{ -INFINITY };
+        for (uint32_t i = 0; i < meshlet.indexCount; i++) {
+            min = glm::min(min, positions[indices[i]]);
+            max = glm::max(max, positions[indices[i]]);
+        }
+        glm::vec3 center = (min + max) * .5f;
+        float radius = 0.f;
+        for (uint32_t i = 0; i < meshlet.indexCount; i++) {
+            radius = std::max(radius, glm::length(positions[indices[i]] - center));
+        }
+        std::vector<glm::vec3> normals;
+        glm::vec3 normalSum{ 0.f };
+        for (uint32_t i = 0; i + 2 < meshlet.indexCount; i += 3) {
+            const glm::vec3& a = positions[indices[i]];
+            glm::vec3 normal = glm::cross(positions[indices[i + 1]] - a, positions[indices[i + 2]] - a);
+            float length = glm::length(normal);
+            // Degenerate triangles are never visible, they do not widen the cone
+            if (length > 0.f) {
+                normals.push_back(normal / length);
+                normalSum += normal / length;
+            }
+        }
+        memcpy(meshlet.center, &center, sizeof(meshlet.center));
+        meshlet.radius = radius;
+        glm::vec3 axis{ 0.f }, apex = center;
+        float cutoff = 1.f;
+        if (glm::length(normalSum) > 0.f) {
+            axis = glm::normalize(normalSum);
+            float minDot = 1.f;
+            for (const glm::vec3& normal : normals) {
+                minDot = std::min(minDot, glm::dot(normal, axis));
+            }
+            if (minDot > MIN_MESHLET_CONE_DOT) {
+                // Moves the apex back along the axis until it is behind every triangle's plane
+                float maxT = 0.f;
+                size_t triangle = 0;
+                for (uint32_t i = 0; i + 2 < meshlet.indexCount; i += 3) {
+                    const glm::vec3& a = positions[indices[i]];
+                    if (glm::length(glm::cross(positions[indices[i + 1]] - a, positions[indices[i + 2]] - a)) > 0.f) {
+                        const glm::vec3& normal = normals[triangle++];
+                        maxT = std::max(maxT, glm::dot(center - a, normal) / glm::dot(axis, normal));
+                    }
+                }
+                apex = center - axis * maxT;
+                // sin of the cone's half angle: the view direction has to be within 90 degrees minus it of the axis
+                cutoff = std::sqrt(1.f - minDot * minDot);
+            }
+        }
+        memcpy(meshlet.coneApex, &apex, sizeof(meshlet.coneApex));
+        memcpy(meshlet.coneAxis, &axis, sizeof(meshlet.coneAxis));
+        meshlet.coneCutoff = cutoff;
+    }
+
+    /// <summary>Splits a triangle list into meshlets and reorders it so every meshlet is a contiguous index range</summary>
+    /// <remarks>Greedy growth: a meshlet starts at the first triangle left in the current order and takes the
+    /// adjacent triangle adding the fewest new vertices, ties broken by distance to the meshlet and by how far the
+    /// triangle faces away from it, until a limit is reached. Islands are continued with the next triangle in order.</remarks>
+    /// <param name="firstIndex">Offset of the indices in the index buffer, the meshlets' ranges are relative to it</param>
+    inline std::vector<meshfile::Meshlet> BuildMeshlets(uint32_t* indices, size_t indexCount, uint32_t firstIndex, const glm::vec3* positions,
+        size_t vertexCount, uint32_t maxVertices = DEFAULT_MESHLET_VERTICES, uint32_t maxTriangles = DEFAULT_MESHLET_TRIANGLES,
+        float coneWeight = DEFAULT_MESHLET_CONE_WEIGHT) {
+        std::vector<meshfile::Meshlet> meshlets;
+        size_t triangleCount = indexCount / 3;
+        maxVertices = std::max(maxVertices, 3u);
+        maxTriangles = std::max(maxTriangles, 1u);
+        if (triangleCount == 0) {
+            return meshlets;
+        }
+        // Triangles of every vertex
+        std::vector<uint32_t> offsets(vertexCount + 1, 0);
+        for (size_t i = 0; i < triangleCount * 3; i++) {
+            offsets[indices[i] + 1]++;
+        }
+        for (size_t v = 0; v < vertexCount; v++) {
+            offsets[v + 1] += offsets[v];
+        }
+        std::vector<uint32_t> adjacency(triangleCount * 3);
+        {
+            std::vector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+            for (size_t i = 0; i < triangleCount * 3; i++) {
+                adjacency[cursor[indices[i]]++] = (uint32_t)(i / 3);
+            }
+        }
+        std::vector<glm::vec3> centroids(triangleCount), normals(triangleCount);
+        for (size_t t = 0; t < triangleCount; t++) {
+            const glm::vec3& a = positions[indices[t * 3]];
+            const glm::vec3& b = positions[indices[t * 3 + 1]];
+            const glm::vec3& c = positions[indices[t * 3 + 2]];
+            centroids[t] = (a + b + c) / 3.f;
+            glm::vec3 normal = glm::cross(b - a, c - a);
+            normals[t] = glm::length(normal) > 0.f ? glm::normalize(normal) : glm::vec3(0.f);
+        }
+        std::vector<uint32_t> ordered;
+        ordered.reserve(triangleCount * 3);
+        std::vector<bool> emitted(triangleCount, false);
+        // The meshlet a vertex was last added to, tells whether a triangle brings new vertices
+        std::vector<uint32_t> vertexMeshlet(vertexCount, UINT32_MAX);
+        std::vector<uint32_t> candidates;
+        size_t seed = 0;
+        uint32_t meshletVertexCount = 0, meshletTriangleCount = 0;
+        glm::vec3 centroidSum{ 0.f }, normalSum{ 0.f };
+        float radius = 0.f;
+        auto newVertices = [&](size_t t) {
+            uint32_t count = 0;
+            for (int k = 0; k < 3; k++) {
+                count += vertexMeshlet[indices[t * 3 + k]] != (uint32_t)meshlets.size();
+            }
+            return count;
+        };
+        auto closeMeshlet = [&]() {
+            meshfile::Meshlet meshlet{};
+            meshlet.firstIndex = (uint32_t)(ordered.size() - meshletTriangleCount * 3);
+            meshlet.indexCount = meshletTriangleCount * 3;
+            meshlets.push_back(meshlet);
+            meshletVertexCount = meshletTriangleCount = 0;
+            centroidSum = normalSum = glm::vec3(0.f);
+            radius = 0.f;
+            candidates.clear();
+        };
+        auto addTriangle = [&](size_t t) {
+            emitted[t] = true;
+            glm::vec3 centroid = meshletTriangleCount > 0 ? centroidSum / (float)meshletTriangleCount : centroids[t];
+            radius = std::max(radius, glm::length(centroids[t] - centroid));
+            centroidSum += centroids[t];
+            normalSum += normals[t];
+            meshletTriangleCount++;
+            for (int k = 0; k < 3; k++) {
+                uint32_t vertex = indices[t * 3 + k];
+                ordered.push_back(vertex);
+                if (vertexMeshlet[vertex] != (uint32_t)meshlets.size()) {
+                    vertexMeshlet[vertex] = (uint32_t)meshlets.size();
+                    meshletVertexCount++;
+                    for (uint32_t i = offsets[vertex]; i < offsets[vertex + 1]; i++) {
+                        if (!emitted[adjacency[i]]) {
+                            candidates.push_back(adjacency[i]);
+                        }
+                    }
+                }
+            }
+        };
+        size_t emittedCount = 0;
+        while (emittedCount < triangleCount) {
+            // Best adjacent triangle that fits, the list is compacted on the way
+            size_t best = SIZE_MAX;
+            float bestScore = INFINITY;
+            glm::vec3 centroid = centroidSum / (float)std::max(meshletTriangleCount, 1u);
+            glm::vec3 axis = glm::length(normalSum) > 0.f ? glm::normalize(normalSum) : glm::vec3(0.f);
+            size_t kept = 0;
+            for (uint32_t candidate : candidates) {
+                if (emitted[candidate]) {
+                    continue;
+                }
+                candidates[kept++] = candidate;
+                uint32_t added = newVertices(candidate);
+                if (meshletVertexCount + added > maxVertices) {
+                    continue;
+                }
+                float spread = glm::length(centroids[candidate] - centroid) / (radius + 1e-6f);
+                float score = (float)added + std::min(spread, 1.f) * .5f + (1.f - glm::dot(normals[candidate], axis)) * coneWeight;
+                if (score < bestScore) {
+                    bestScore = score;
+                    best = candidate;
+                }
+            }
+            candidates.resize(kept);
+            if (best == SIZE_MAX) {
+                // Nothing adjacent fits: continue with the next triangle in order when it fits, close the meshlet otherwise
+                while (emitted[seed]) {
+                    seed++;
+                }
+                if (meshletTriangleCount > 0 && meshletVertexCount + newVertices(seed) > maxVertices) {
+                    closeMeshlet();
+                }
+                best = seed;
+            }
+            addTriangle(best);
+            emittedCount++;
+            if (meshletTriangleCount == maxTriangles) {
+                closeMeshlet();
+            }
+        }
+        if (meshletTriangleCount > 0) {
+            closeMeshlet();
+        }
+        std::copy(ordered.begin(), ordered.end(), indices);
+        for (meshfile::Meshlet& meshlet : meshlets) {
+            ComputeMeshletBounds(meshlet, indices + meshlet.firstIndex, positions);
+            meshlet.firstIndex += firstIndex;
+        }
+        return meshlets;
+    }
+    // Builds the meshlets of every submesh, each submesh's meshlets cover its index range in order
+    inline void BuildMeshlets(meshfile::MeshData& mesh, uint32_t maxVertices = DEFAULT_MESHLET_VERTICES, uint32_t maxTriangles = DEFAULT_MESHLET_TRIANGLES) {
+        mesh.meshlets.clear();
+        for (meshfile::Submesh& submesh : mesh.submeshes) {
+            std::vector<meshfile::Meshlet> meshlets = BuildMeshlets(mesh.indices.data() + submesh.firstIndex, submesh.indexCount, submesh.firstIndex,
+                mesh.positions.data(), mesh.positions.size(), maxVertices, maxTriangles);
+            submesh.firstMeshlet = (uint32_t)mesh.meshlets.size();
+            submesh.meshletCount = (uint32_t)meshlets.size();
+            mesh.meshlets.insert(mesh.meshlets.end(), meshlets.begin(), meshlets.end());
+        }
+    }
+}
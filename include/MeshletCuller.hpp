@@ -0,0 +1,113 @@
+#pragma once
+
+#include <MeshFile.hpp>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// The meshlet culler class
+// Culls the meshlets of a mesh (see meshopt::BuildMeshlets) on the cpu before drawing it: a meshlet whose bounding
+// sphere lies outside one of the frustum planes or whose normal cone faces away from the camera is dropped, and the
+// index ranges of the remaining ones are merged where they touch and drawn with one glMultiDrawElements.
+// Both tests run in object space, the planes come from the model-view-projection matrix and the camera position is
+// moved into object space, so no meshlet is transformed. The cone test assumes the model matrix keeps angles (rotation,
+// translation and uniform scale), cones do not survive a non-uniform scale.
+class MeshletCuller {
+public:
+    /// <summary>Culls a mesh's meshlets and collects the index ranges of the visible ones, replacing the last result</summary>
+    /// <param name="viewProjection">Projection times view, the frustum the meshlets are tested against</param>
+    /// <param name="cameraPosition">Camera position in world space, see Camera::GetPosition</param>
+    /// <param name="indexSize">Bytes per index of the mesh's index buffer, for the draw offsets</param>
+    void Cull(const meshfile::Meshlet* meshlets, size_t meshletCount, const glm::mat4& model, const glm::mat4& viewProjection,
+        const glm::vec3& cameraPosition, uint32_t indexSize) {
+        m_Counts.clear();
+        m_Offsets.clear();
+        m_FrustumCulledCount = m_ConeCulledCount = 0;
+        m_VisibleTriangleCount = 0;
+        glm::vec4 planes[6];
+        ExtractFrustumPlanes(viewProjection * model, planes);
+        glm::vec3 camera = glm::vec3(glm::inverse(model) * glm::vec4(cameraPosition, 1.f));
+        uint32_t end = UINT32_MAX;
+        for (size_t i = 0; i < meshletCount; i++) {
+            const meshfile::Meshlet& meshlet = meshlets[i];
+            if (!IsInFrustum(meshlet, planes)) {
+                m_FrustumCulledCount++;
+                continue;
+            }
+            if (IsBackfacing(meshlet, camera)) {
+                m_ConeCulledCount++;
+                continue;
+            }
+            m_VisibleTriangleCount += meshlet.indexCount / 3;
+            // Meshlets next to each other in the index buffer become one range
+            if (meshlet.firstIndex == end) {
+                m_Counts.back() += (GLsizei)meshlet.indexCount;
+            }
+            else {
+                m_Counts.push_back((GLsizei)meshlet.indexCount);
+                m_Offsets.push_back(reinterpret_cast<const void*>((uintptr_t)meshlet.firstIndex * indexSize));
+            }
+            end = meshlet.firstIndex + meshlet.indexCount;
+        }
+    }
+    // Draws the ranges of the last Cull, the mesh's vertex array has to be bound
+    void Draw(GLenum indexType) const {
+        if (!m_Counts.empty()) {
+            glMultiDrawElements(GL_TRIANGLES, m_Counts.data(), indexType, m_Offsets.data(), (GLsizei)m_Counts.size());
+        }
+    }
+    // Planes with normals pointing inside and unit length normals, so the distance of a point is dot(xyz, p) + w
+    static void ExtractFrustumPlanes(const glm::mat4& matrix, glm::vec4 planes[6]) {
+        glm::vec4 rows[4];
+        for (int i = 0; i < 4; i++) {
+            rows[i] = glm::vec4(matrix[0][i], matrix[1][i], matrix[2][i], matrix[3][i]);
+        }
+        // Left, right, bottom, top, near, far of gl's clip space
+        for (int i = 0; i < 3; i++) {
+            planes[i * 2] = rows[3] + rows[i];
+            planes[i * 2 + 1] = rows[3] - rows[i];
+        }
+        for (int i = 0; i < 6; i++) {
+            planes[i] /= glm::length(glm::vec3(planes[i]));
+        }
+    }
+    static bool IsInFrustum(const meshfile::Meshlet& meshlet, const glm::vec4 planes[6]) {
+        glm::vec3 center{ meshlet.center[0], meshlet.center[1], meshlet.center[2] };
+        for (int i = 0; i < 6; i++) {
+            if (glm::dot(glm::vec3(planes[i]), center) + planes[i].w < -meshlet.radius) {
+                return false;
+            }
+        }
+        return true;
+    }
+    // Whether every triangle of the meshlet faces away from a camera at an object space position
+    static bool IsBackfacing(const meshfile::Meshlet& meshlet, const glm::vec3& camera) {
+        glm::vec3 apex{ meshlet.coneApex[0], meshlet.coneApex[1], meshlet.coneApex[2] };
+        glm::vec3 axis{ meshlet.coneAxis[0], meshlet.coneAxis[1], meshlet.coneAxis[2] };
+        glm::vec3 direction = apex - camera;
+        float length = glm::length(direction);
+        // Strictly above, a cutoff of 1 marks meshlets the test must never drop
+        return length > 0.f && glm::dot(direction, axis) > meshlet.coneCutoff * length;
+    }
+    // Ranges the last Cull left, each one draw of the multi-draw
+    size_t GetRangeCount() const {
+        return m_Counts.size();
+    }
+    uint32_t GetFrustumCulledCount() const {
+        return m_FrustumCulledCount;
+    }
+    uint32_t GetConeCulledCount() const {
+        return m_ConeCulledCount;
+    }
+    uint32_t GetVisibleTriangleCount() const {
+        return m_VisibleTriangleCount;
+    }
+private:
+    std::vector<GLsizei> m_Counts;
+    std::vector<const void*> m_Offsets;
+    uint32_t m_FrustumCulledCount{};
+    uint32_t m_ConeCulledCount{};
+    uint32_t m_VisibleTriangleCount{};
+};
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// The occlusion queries class
+// Culls objects on the gpu with GL_ANY_SAMPLES_PASSED queries, exploiting that visibility rarely changes from one frame
+// to the next (after Bittner et al., coherent hierarchical culling, without the hierarchy). Every object remembers
+// whether it was visible the last time it was queried and results are only collected once they are available, so the
+// cpu never waits on the gpu:
+//     visible                  drawn, and every VISIBLE_QUERY_INTERVAL frames the draw itself is queried
+//     hidden, query in flight  drawn under glBeginConditionalRender on that query, the gpu skips it once the query
+//                              says hidden and draws it while the result is not there yet
+//     hidden                   not drawn, its bounding box is queried after the visible objects (see QueryHidden)
+// An object coming into view therefore appears a frame or two late, the price of never stalling.
+class OcclusionQueries {
+public:
+    // Frames between the queries of a visible object, spread over the objects so they do not all query at once
+    static constexpr uint32_t VISIBLE_QUERY_INTERVAL = 8;
+    enum Action {
+        DRAW,
+        // Drawn inside a query
+        DRAW_QUERIED,
+        // Drawn on condition of the hidden object's query in flight
+        DRAW_CONDITIONAL,
+        SKIP,
+    };
+    ~OcclusionQueries() {
+        if (!m_Queries.empty()) {
+            glDeleteQueries((GLsizei)m_Queries.size(), m_Queries.data());
+        }
+    }
+    OcclusionQueries(const OcclusionQueries&) = delete;
+    OcclusionQueries& operator=(const OcclusionQueries&) = delete;
+    // Creates a query per object, every object starts visible
+    static OcclusionQueries Create(size_t objectCount) {
+        return OcclusionQueries(objectCount);
+    }
+    // Collects the results that are back, once per frame before the objects are drawn
+    void BeginFrame() {
+        m_Frame++;
+        for (size_t i = 0; i < m_Objects.size(); i++) {
+            Object& object = m_Objects[i];
+            if (!object.pending) {
+                continue;
+            }
+            GLuint available = GL_FALSE;
+            glGetQueryObjectuiv(m_Queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (available == GL_TRUE) {
+                GLuint samplesPassed = GL_FALSE;
+                glGetQueryObjectuiv(m_Queries[i], GL_QUERY_RESULT, &samplesPassed);
+                object.visible = samplesPassed != GL_FALSE;
+                object.pending = false;
+            }
+        }
+    }
+    // How the object is drawn this frame, Draw applies it
+    Action GetAction(size_t index) const {
+        const Object& object = m_Objects[index];
+        if (object.visible) {
+            return object.pending || (m_Frame + index) % VISIBLE_QUERY_INTERVAL != 0 ? DRAW : DRAW_QUERIED;
+        }
+        return object.pending ? DRAW_CONDITIONAL : SKIP;
+    }
+    /// <summary>Draws an object according to its action</summary>
+    /// <param name="draw">Callable issuing the object's draw calls</param>
+    template<typename Func>
+    void Draw(size_t index, Func&& draw) {
+        switch (GetAction(index)) {
+        case DRAW:
+            draw();
+            break;
+        case DRAW_QUERIED:
+            glBeginQuery(GL_ANY_SAMPLES_PASSED, m_Queries[index]);
+            draw();
+            glEndQuery(GL_ANY_SAMPLES_PASSED);
+            m_Objects[index].pending = true;
+            break;
+        case DRAW_CONDITIONAL:
+            glBeginConditionalRender(m_Queries[index], GL_QUERY_NO_WAIT);
+            draw();
+            glEndConditionalRender();
+            break;
+        case SKIP:
+            break;
+        }
+    }
+    /// <summary>Queries the bounding boxes of the hidden objects without a query in flight, after the visible objects are drawn</summary>
+    /// <remarks>Color and depth writes are off meanwhile. Boxes are best drawn without face culling, an object whose box
+    /// contains the camera has to be made visible with MarkVisible as its box cannot be seen from inside.</remarks>
+    /// <param name="drawBox">Callable taking the object index and drawing its bounding box</param>
+    template<typename Func>
+    void QueryHidden(Func&& drawBox) {
+        GLboolean colorMask[4], depthMask;
+        glGetBooleanv(GL_COLOR_WRITEMASK, colorMask);
+        glGetBooleanv(GL_DEPTH_WRITEMASK, &depthMask);
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        glDepthMask(GL_FALSE);
+        for (size_t i = 0; i < m_Objects.size(); i++) {
+            if (GetAction(i) != SKIP) {
+                continue;
+            }
+            glBeginQuery(GL_ANY_SAMPLES_PASSED, m_Queries[i]);
+            drawBox(i);
+            glEndQuery(GL_ANY_SAMPLES_PASSED);
+            m_Objects[i].pending = true;
+        }
+        glColorMask(colorMask[0], colorMask[1], colorMask[2], colorMask[3]);
+        glDepthMask(depthMask);
+    }
+    // Drops what the queries knew about an object, e.g. when the camera is inside its bounds or it was culled otherwise
+    void MarkVisible(size_t index) {
+        m_Objects[index].visible = true;
+        m_Objects[index].pending = false;
+    }
+    size_t GetObjectCount() const {
+        return m_Objects.size();
+    }
+    // Objects the last collected results found hidden
+    size_t GetHiddenCount() const {
+        size_t count = 0;
+        for (const Object& object : m_Objects) {
+            count += object.visible ? 0 : 1;
+        }
+        return count;
+    }
+private:
+    // Occlusion queries constructor
+    OcclusionQueries(size_t objectCount)
+        : m_Queries(objectCount), m_Objects(objectCount) {
+        if (objectCount > 0) {
+            glGenQueries((GLsizei)objectCount, m_Queries.data());
+        }
+    }
+private:
+    struct Object {
+        bool visible{ true };
+        // The object's query was issued and its result not collected yet
+        bool pending{};
+    };
+    std::vector<GLuint> m_Queries;
+    std::vector<Object> m_Objects;
+    uint32_t m_Frame{};
+};
@@ -0,0 +1,224 @@
+#pragma once
+
+#include <Shader.hpp>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+// The point shadow atlas class
+// Cube shadow maps of point lights share one depth texture array, every light holding a slot of six layers (one per
+// cube face, in the +x -x +y -y +z -z order of cube maps). The faces of a light are rendered in a single pass: a
+// geometry shader sends every triangle to the layers of the faces being updated (see point_shadow_geom.glsl), the
+// maps store the distance to the light divided by its radius.
+// Only the most important lights (large and close to the camera) get a slot, and only facesPerFrame faces are
+// rendered per frame. Faces that were never rendered come first, then faces of lights that moved and then the
+// oldest faces of the most important lights, which keeps the shadows of moving casters reasonably fresh.
+// Lights are identified by their index, so they have to be passed in the same order every frame.
+// Shader side:
+//     uPointShadowMap         sampler2DArrayShadow, layer slot * 6 + face
+//     uPointShadowResolution  float, width of a face in texels, for biasing in world units
+class PointShadowAtlas {
+public:
+    static constexpr int FACE_COUNT = 6;
+    // Faces of a light that moved are refreshed before older faces of lights up to this many times as important
+    static constexpr float MOVED_WEIGHT = 8.f;
+    // Near plane of the faces in world units, casters closer to the light than this cast no shadow
+    static constexpr float NEAR_PLANE = .05f;
+    ~PointShadowAtlas() {
+        glDeleteFramebuffers(1, &m_LayeredFramebuffer);
+        glDeleteFramebuffers(1, &m_ClearFramebuffer);
+        glDeleteTextures(1, &m_DepthTexture);
+    }
+    /// <summary>Creates the shadow atlas</summary>
+    /// <param name="faceResolution">Width and height of each cube face</param>
+    /// <param name="slotCount">Number of lights that can have shadows at once</param>
+    /// <param name="facesPerFrame">Most cube faces rendered in a frame</param>
+    static PointShadowAtlas Create(int faceResolution = 512, int slotCount = 8, int facesPerFrame = 12) {
+        return PointShadowAtlas(faceResolution, slotCount, facesPerFrame);
+    }
+    // Gives slots to the most important lights and picks the faces to render this frame
+    void Update(const glm::vec3& cameraPosition, const phong::PointLight* lights, size_t count) {
+        m_Frame++;
+        // Ranking the lights
+        std::vector<std::pair<float, size_t>> ranked;
+        ranked.reserve(count);
+        for (size_t i = 0; i < count; i++) {
+            float radius = lights[i].InfluenceRadius();
+            if (radius > 0.f && std::isfinite(radius)) {
+                ranked.push_back({ Importance(cameraPosition, lights[i].position, radius), i });
+            }
+        }
+        size_t shadowed = std::min<size_t>(ranked.size(), m_Slots.size());
+        std::partial_sort(ranked.begin(), ranked.begin() + shadowed, ranked.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+        m_LightSlots.assign(count, -1);
+        for (size_t i = 0; i < shadowed; i++) {
+            m_LightSlots[ranked[i].second] = -2;
+        }
+        // Lights that dropped out give up their slot, the ones that stayed keep it and their maps
+        for (int s = 0; s < (int)m_Slots.size(); s++) {
+            Slot& slot = m_Slots[s];
+            if (slot.light >= 0 && ((size_t)slot.light >= count || m_LightSlots[slot.light] != -2)) {
+                slot.light = -1;
+            }
+            if (slot.light >= 0) {
+                m_LightSlots[slot.light] = s;
+            }
+        }
+        for (size_t i = 0; i < shadowed; i++) {
+            size_t light = ranked[i].second;
+            if (m_LightSlots[light] == -2) {
+                Slot& slot = *std::find_if(m_Slots.begin(), m_Slots.end(), [](const Slot& s) { return s.light < 0; });
+                slot.light = (int)light;
+                std::fill(std::begin(slot.renderedFrame), std::end(slot.renderedFrame), 0);
+                m_LightSlots[light] = (int)(&slot - m_Slots.data());
+            }
+        }
+        // Scoring the faces of every slot
+        std::vector<std::pair<float, int>> faces;
+        for (int s = 0; s < (int)m_Slots.size(); s++) {
+            Slot& slot = m_Slots[s];
+            slot.faceMask = 0;
+            if (slot.light < 0) {
+                continue;
+            }
+            const phong::PointLight& light = lights[slot.light];
+            slot.position = light.position;
+            slot.radius = light.InfluenceRadius();
+            float importance = Importance(cameraPosition, light.position, slot.radius);
+            for (int f = 0; f < FACE_COUNT; f++) {
+                float score;
+                if (slot.renderedFrame[f] == 0) {
+                    score = INFINITY;
+                }
+                else {
+                    bool moved = glm::distance(slot.renderedPosition[f], light.position) > slot.radius * .01f;
+                    score = importance * (float)(m_Frame - slot.renderedFrame[f]) * (moved ? MOVED_WEIGHT : 1.f);
+                }
+                faces.push_back({ score, s * FACE_COUNT + f });
+            }
+        }
+        size_t budget = std::min<size_t>(faces.size(), m_FacesPerFrame);
+        std::partial_sort(faces.begin(), faces.begin() + budget, faces.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+        for (size_t i = 0; i < budget; i++) {
+            Slot& slot = m_Slots[faces[i].second / FACE_COUNT];
+            int face = faces[i].second % FACE_COUNT;
+            slot.faceMask |= 1 << face;
+            slot.renderedFrame[face] = m_Frame;
+            slot.renderedPosition[face] = slot.position;
+        }
+    }
+    int GetSlotCount() const {
+        return (int)m_Slots.size();
+    }
+    // The faces of a slot to render this frame, one bit per face
+    int GetFaceMask(int slot) const {
+        return m_Slots[slot].faceMask;
+    }
+    // The slot holding a light's shadows, -1 when the light has none
+    int GetLightSlot(size_t light) const {
+        return light < m_LightSlots.size() ? m_LightSlots[light] : -1;
+    }
+    // Clears the faces of a slot to render and sets the uniforms of the shadow shader, the casters are then drawn once
+    void BeginSlot(int slot, const Shader& shader) const {
+        const Slot& s = m_Slots[slot];
+        glViewport(0, 0, m_FaceResolution, m_FaceResolution);
+        glDepthMask(GL_TRUE);
+        glBindFramebuffer(GL_FRAMEBUFFER, m_ClearFramebuffer);
+        for (int f = 0; f < FACE_COUNT; f++) {
+            if (s.faceMask & (1 << f)) {
+                glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_DepthTexture, 0, slot * FACE_COUNT + f);
+                glClear(GL_DEPTH_BUFFER_BIT);
+            }
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, m_LayeredFramebuffer);
+        // The cube map face orientations
+        static const glm::vec3 TARGETS[FACE_COUNT] = { { 1.f, 0.f, 0.f }, { -1.f, 0.f, 0.f }, { 0.f, 1.f, 0.f }, { 0.f, -1.f, 0.f }, { 0.f, 0.f, 1.f }, { 0.f, 0.f, -1.f } };
+        static const glm::vec3 UPS[FACE_COUNT] = { { 0.f, -1.f, 0.f }, { 0.f, -1.f, 0.f }, { 0.f, 0.f, 1.f }, { 0.f, 0.f, -1.f }, { 0.f, -1.f, 0.f }, { 0.f, -1.f, 0.f } };
+        glm::mat4 proj = glm::perspective(glm::radians(90.f), 1.f, std::min(NEAR_PLANE, s.radius * .5f), s.radius);
+        for (int f = 0; f < FACE_COUNT; f++) {
+            char name[32];
+            snprintf(name, sizeof(name), "uFaceViewProj[%d]", f);
+            shader.SetMatrix4(name, proj * glm::lookAt(s.position, s.position + TARGETS[f], UPS[f]));
+        }
+        shader.SetInt("uFaceMask", s.faceMask);
+        shader.SetInt("uFirstLayer", slot * FACE_COUNT);
+        shader.SetFloat3("uLightPosition", s.position);
+        shader.SetFloat("uLightRadius", s.radius);
+    }
+    // Binds the default framebuffer again
+    void End(int width, int height) const {
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(0, 0, width, height);
+    }
+    // Binds the atlas to a texture unit and sets the shader's uPointShadowMap sampler and uPointShadowResolution
+    void Bind(const Shader& shader, unsigned int unit) const {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, m_DepthTexture);
+        shader.SetInt("uPointShadowMap", unit);
+        shader.SetFloat("uPointShadowResolution", (float)m_FaceResolution);
+    }
+private:
+    struct Slot {
+        // Index of the light or -1 when free
+        int light = -1;
+        glm::vec3 position{};
+        float radius{};
+        int faceMask{};
+        // Frame each face was last rendered in (0 for never) and where the light was
+        unsigned renderedFrame[FACE_COUNT]{};
+        glm::vec3 renderedPosition[FACE_COUNT]{};
+    };
+    // Point shadow atlas constructor
+    PointShadowAtlas(int faceResolution, int slotCount, int facesPerFrame)
+        : m_FaceResolution(faceResolution), m_FacesPerFrame(facesPerFrame), m_Slots(slotCount) {
+        glGenTextures(1, &m_DepthTexture);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, m_DepthTexture);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, m_FaceResolution, m_FaceResolution, slotCount * FACE_COUNT, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+        // Every layer is attached for rendering, gl_Layer picks the face
+        glGenFramebuffers(1, &m_LayeredFramebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, m_LayeredFramebuffer);
+        glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_DepthTexture, 0);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        CheckFramebufferStatus("point shadow");
+        // Clearing a layered attachment clears every layer, single faces are cleared through this one
+        glGenFramebuffers(1, &m_ClearFramebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, m_ClearFramebuffer);
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_DepthTexture, 0, 0);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        CheckFramebufferStatus("point shadow clear");
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+    // Large lights close to the camera matter most
+    static float Importance(const glm::vec3& cameraPosition, const glm::vec3& position, float radius) {
+        return radius / std::max(glm::distance(cameraPosition, position), 1.f);
+    }
+    static void CheckFramebufferStatus(const char* name) {
+        GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+        if (status != GL_FRAMEBUFFER_COMPLETE) {
+            fprintf(stderr, "%s framebuffer incomplete (0x%x)\n", name, status);
+        }
+    }
+private:
+    int m_FaceResolution{};
+    int m_FacesPerFrame{};
+    unsigned m_Frame{};
+    GLuint m_DepthTexture{};
+    GLuint m_LayeredFramebuffer{};
+    GLuint m_ClearFramebuffer{};
+    std::vector<Slot> m_Slots;
+    // Slot of every light of the last Update
+    std::vector<int> m_LightSlots;
+};
@@ -0,0 +1,454 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <vector>
+
+// Procedural primitives: cube, plane, grid, uv sphere, ico sphere and cylinder
+// Every generator is constexpr and templated on its tessellation and vertex type, so a primitive can be generated at
+// compile time into an exactly sized read-only array:
+//     static constexpr auto cube = primitives::Cube();
+//     static constexpr auto sphere = primitives::UvSphere<16, 32, primitives::PositionVertex>();
+// The same generators run at runtime into vectors when the tessellation is only known then or the mesh is too large
+// for the compiler's constexpr limits, e.g. to fill a GeometryArena:
+//     primitives::MeshData<> sphere = primitives::IcoSphere(6);
+// Primitives are centered on the origin and fit the unit cube (the grid excepted), triangles are counter clockwise
+// when seen from outside. A vertex type is anything constexpr constructible from a primitives::Vertex.
+namespace primitives {
+    // The vertex every generator emits, laid out like the demos' hand written vertices (8 floats)
+    struct Vertex {
+        float position[3]{};
+        float texCoord[2]{};
+        float normal[3]{};
+    };
+    // Position only vertex, for depth only passes and benchmarks
+    struct PositionVertex {
+        float position[3]{};
+        constexpr PositionVertex() = default;
+        constexpr PositionVertex(const Vertex& vertex) : position{ vertex.position[0], vertex.position[1], vertex.position[2] } {}
+    };
+
+    // A primitive generated at compile time, sized exactly
+    template<typename V, uint32_t VertexCount, uint32_t IndexCount>
+    struct Mesh {
+        static constexpr uint32_t VERTEX_COUNT = VertexCount;
+        static constexpr uint32_t INDEX_COUNT = IndexCount;
+        static constexpr uint32_t TRIANGLE_COUNT = IndexCount / 3;
+        std::array<V, VertexCount> vertices{};
+        std::array<uint32_t, IndexCount> indices{};
+    };
+    // A primitive generated at runtime
+    template<typename V = Vertex>
+    struct MeshData {
+        std::vector<V> vertices;
+        std::vector<uint32_t> indices;
+    };
+
+    namespace detail {
+        constexpr double PI = 3.14159265358979323846;
+
+        // Constexpr replacements for <cmath>, which is not constexpr before C++26
+        constexpr double Sqrt(double x) {
+            if (x <= 0.) {
+                return 0.;
+            }
+            double root = x > 1. ? x : 1.;
+            for (int i = 0; i < 64; i++) {
+                double next = .5 * (root + x / root);
+                if (next >= root) {
+                    break;
+                }
+                root = next;
+            }
+            return root;
+        }
+        constexpr double Sin(double x) {
+            // Reduced to [-pi/2, pi/2] where the series converges quickly
+            x -= 2. * PI * (double)(int64_t)(x / (2. * PI) + (x < 0. ? -.5 : .5));
+            if (x > .5 * PI) {
+                x = PI - x;
+            }
+            else if (x < -.5 * PI) {
+                x = -PI - x;
+            }
+            double term = x, sum = x;
+            for (int i = 1; i < 12; i++) {
+                term *= -x * x / ((2. * i) * (2. * i + 1.));
+                sum += term;
+            }
+            return sum;
+        }
+        constexpr double Cos(double x) {
+            return Sin(x + .5 * PI);
+        }
+        constexpr double Atan(double x) {
+            if (x < 0.) {
+                return -Atan(-x);
+            }
+            if (x > 1.) {
+                return .5 * PI - Atan(1. / x);
+            }
+            // Halving the angle twice brings x below tan(pi / 16)
+            x = x / (1. + Sqrt(1. + x * x));
+            x = x / (1. + Sqrt(1. + x * x));
+            double term = x, sum = x;
+            for (int i = 1; i < 12; i++) {
+                term *= -x * x;
+                sum += term / (2. * i + 1.);
+            }
+            return 4. * sum;
+        }
+        constexpr double Atan2(double y, double x) {
+            if (x > 0.) {
+                return Atan(y / x);
+            }
+            if (x < 0.) {
+                return Atan(y / x) + (y < 0. ? -PI : PI);
+            }
+            return y > 0. ? .5 * PI : y < 0. ? -.5 * PI : 0.;
+        }
+
+        struct Float3 {
+            double x{}, y{}, z{};
+            constexpr Float3 operator+(const Float3& other) const {
+                return { x + other.x, y + other.y, z + other.z };
+            }
+            constexpr Float3 operator*(double scale) const {
+                return { x * scale, y * scale, z * scale };
+            }
+            constexpr Float3 Normalized() const {
+                return *this * (1. / Sqrt(x * x + y * y + z * z));
+            }
+        };
+
+        template<typename V>
+        constexpr V MakeVertex(const Float3& position, double u, double v, const Float3& normal) {
+            return V(Vertex{ { (float)position.x, (float)position.y, (float)position.z }, { (float)u, (float)v },
+                { (float)normal.x, (float)normal.y, (float)normal.z } });
+        }
+        // A (columns + 1) x (rows + 1) vertex grid spanning origin to origin + right + up, right x up is the normal
+        template<typename V>
+        constexpr void GenerateQuadGrid(const Float3& origin, const Float3& right, const Float3& up, const Float3& normal,
+            uint32_t columns, uint32_t rows, double uScale, double vScale, V*& vertices, uint32_t*& indices, uint32_t& vertexCount) {
+            for (uint32_t row = 0; row <= rows; row++) {
+                for (uint32_t column = 0; column <= columns; column++) {
+                    double u = (double)column / columns, v = (double)row / rows;
+                    *vertices++ = MakeVertex<V>(origin + right * u + up * v, u * uScale, v * vScale, normal);
+                }
+            }
+            for (uint32_t row = 0; row < rows; row++) {
+                for (uint32_t column = 0; column < columns; column++) {
+                    uint32_t bottom = vertexCount + row * (columns + 1) + column, top = bottom + columns + 1;
+                    uint32_t quad[6] = { bottom, bottom + 1, top + 1, top + 1, top, bottom };
+                    for (uint32_t index : quad) {
+                        *indices++ = index;
+                    }
+                }
+            }
+            vertexCount += (columns + 1) * (rows + 1);
+        }
+    }
+
+    // Vertex and index counts of every primitive, the sizes of the arrays the generators fill
+    constexpr uint32_t CubeVertexCount(uint32_t segments) {
+        return 6 * (segments + 1) * (segments + 1);
+    }
+    constexpr uint32_t CubeIndexCount(uint32_t segments) {
+        return 36 * segments * segments;
+    }
+    constexpr uint32_t GridVertexCount(uint32_t columns, uint32_t rows) {
+        return (columns + 1) * (rows + 1);
+    }
+    constexpr uint32_t GridIndexCount(uint32_t columns, uint32_t rows) {
+        return 6 * columns * rows;
+    }
+    constexpr uint32_t UvSphereVertexCount(uint32_t rings, uint32_t sectors) {
+        return (rings + 1) * (sectors + 1);
+    }
+    constexpr uint32_t UvSphereIndexCount(uint32_t rings, uint32_t sectors) {
+        return 6 * sectors * (rings - 1);
+    }
+    constexpr uint32_t IcoSphereVertexCount(uint32_t subdivisions) {
+        return 10 * (1u << (2 * subdivisions)) + 2;
+    }
+    constexpr uint32_t IcoSphereIndexCount(uint32_t subdivisions) {
+        return 60 * (1u << (2 * subdivisions));
+    }
+    constexpr uint32_t CylinderVertexCount(uint32_t sectors, uint32_t stacks) {
+        return (stacks + 1) * (sectors + 1) + 2 * (sectors + 1);
+    }
+    constexpr uint32_t CylinderIndexCount(uint32_t sectors, uint32_t stacks) {
+        return 6 * sectors * stacks + 6 * sectors;
+    }
+
+    /// <summary>Unit cube, every face a segments x segments grid with its own vertices</summary>
+    /// <param name="vertices">CubeVertexCount(segments) vertices</param>
+    /// <param name="indices">CubeIndexCount(segments) indices</param>
+    template<typename V>
+    constexpr void GenerateCube(uint32_t segments, V* vertices, uint32_t* indices) {
+        using detail::Float3;
+        // Front, back, top, bottom, left and right: origin, right and up of each face seen from outside
+        constexpr Float3 faces[6][3] = {
+            { { .5, -.5, -.5 }, { -1., 0., 0. }, { 0., 1., 0. } },
+            { { -.5, -.5, .5 }, { 1., 0., 0. }, { 0., 1., 0. } },
+            { { -.5, .5, .5 }, { 1., 0., 0. }, { 0., 0., -1. } },
+            { { -.5, -.5, -.5 }, { 1., 0., 0. }, { 0., 0., 1. } },
+            { { -.5, -.5, -.5 }, { 0., 0., 1. }, { 0., 1., 0. } },
+            { { .5, -.5, .5 }, { 0., 0., -1. }, { 0., 1., 0. } },
+        };
+        uint32_t vertexCount = 0;
+        for (const auto& [origin, right, up] : faces) {
+            Float3 normal{ right.y * up.z - right.z * up.y, right.z * up.x - right.x * up.z, right.x * up.y - right.y * up.x };
+            detail::GenerateQuadGrid(origin, right, up, normal, segments, segments, 1., 1., vertices, indices, vertexCount);
+        }
+    }
+    /// <summary>Grid of columns x rows unit cells on the xz plane facing +y, the texture repeats every cell</summary>
+    /// <param name="vertices">GridVertexCount(columns, rows) vertices</param>
+    /// <param name="indices">GridIndexCount(columns, rows) indices</param>
+    template<typename V>
+    constexpr void GenerateGrid(uint32_t columns, uint32_t rows, V* vertices, uint32_t* indices) {
+        uint32_t vertexCount = 0;
+        detail::GenerateQuadGrid<V>({ -.5 * columns, 0., .5 * rows }, { (double)columns, 0., 0. }, { 0., 0., -(double)rows },
+            { 0., 1., 0. }, columns, rows, columns, rows, vertices, indices, vertexCount);
+    }
+    /// <summary>Unit square on the xy plane facing +z, split into segments x segments quads</summary>
+    /// <param name="vertices">GridVertexCount(segments, segments) vertices, row by row from the bottom left</param>
+    /// <param name="indices">GridIndexCount(segments, segments) indices</param>
+    template<typename V>
+    constexpr void GeneratePlane(uint32_t segments, V* vertices, uint32_t* indices) {
+        uint32_t vertexCount = 0;
+        detail::GenerateQuadGrid<V>({ -.5, -.5, 0. }, { 1., 0., 0. }, { 0., 1., 0. }, { 0., 0., 1. }, segments, segments, 1., 1.,
+            vertices, indices, vertexCount);
+    }
+    /// <summary>Sphere of diameter 1 made of rings latitude bands of sectors quads each, the poles of triangles</summary>
+    /// <param name="rings">At least 2</param>
+    /// <param name="sectors">At least 3</param>
+    template<typename V>
+    constexpr void GenerateUvSphere(uint32_t rings, uint32_t sectors, V* vertices, uint32_t* indices) {
+        // The first and last vertex of a ring coincide so the texture coordinates do not wrap
+        for (uint32_t ring = 0; ring <= rings; ring++) {
+            double phi = detail::PI * ring / rings;
+            for (uint32_t sector = 0; sector <= sectors; sector++) {
+                double theta = 2. * detail::PI * sector / sectors;
+                detail::Float3 normal{ detail::Sin(phi) * detail::Sin(theta), detail::Cos(phi), detail::Sin(phi) * detail::Cos(theta) };
+                *vertices++ = detail::MakeVertex<V>(normal * .5, (double)sector / sectors, 1. - (double)ring / rings, normal);
+            }
+        }
+        for (uint32_t ring = 0; ring < rings; ring++) {
+            for (uint32_t sector = 0; sector < sectors; sector++) {
+                uint32_t top = ring * (sectors + 1) + sector, bottom = top + sectors + 1;
+                if (ring != 0) {
+                    *indices++ = top;
+                    *indices++ = bottom;
+                    *indices++ = top + 1;
+                }
+                if (ring != rings - 1) {
+                    *indices++ = top + 1;
+                    *indices++ = bottom;
+                    *indices++ = bottom + 1;
+                }
+            }
+        }
+    }
+    /// <summary>Sphere of diameter 1 from a subdivided icosahedron, triangles of nearly equal size everywhere</summary>
+    /// <remarks>Texture coordinates are a spherical mapping without a seam, the texture wraps wrong on one column
+    /// of triangles: UvSphere suits textured spheres better</remarks>
+    template<typename V>
+    constexpr void GenerateIcoSphere(uint32_t subdivisions, V* vertices, uint32_t* indices) {
+        using detail::Float3;
+        constexpr double t = 1.61803398874989484820;
+        std::vector<Float3> positions = {
+            { -1., t, 0. }, { 1., t, 0. }, { -1., -t, 0. }, { 1., -t, 0. },
+            { 0., -1., t }, { 0., 1., t }, { 0., -1., -t }, { 0., 1., -t },
+            { t, 0., -1. }, { t, 0., 1. }, { -t, 0., -1. }, { -t, 0., 1. },
+        };
+        std::vector<uint32_t> triangles = {
+            0, 11, 5, 0, 5, 1, 0, 1, 7, 0, 7, 10, 0, 10, 11,
+            1, 5, 9, 5, 11, 4, 11, 10, 2, 10, 7, 6, 7, 1, 8,
+            3, 9, 4, 3, 4, 2, 3, 2, 6, 3, 6, 8, 3, 8, 9,
+            4, 9, 5, 2, 4, 11, 6, 2, 10, 8, 6, 7, 9, 8, 1,
+        };
+        for (Float3& position : positions) {
+            position = position.Normalized();
+        }
+        for (uint32_t level = 0; level < subdivisions; level++) {
+            // Midpoint of every edge, found through the edge's lower vertex which has at most 6 edges
+            struct Edge {
+                uint32_t other = UINT32_MAX, midpoint = UINT32_MAX;
+            };
+            std::vector<Edge> edges(positions.size() * 6);
+            auto midpoint = [&](uint32_t a, uint32_t b) {
+                Edge* slot = &edges[(a < b ? a : b) * 6];
+                uint32_t other = a < b ? b : a;
+                while (slot->other != UINT32_MAX && slot->other != other) {
+                    slot++;
+                }
+                if (slot->other == UINT32_MAX) {
+                    slot->other = other;
+                    slot->midpoint = (uint32_t)positions.size();
+                    positions.push_back((positions[a] + positions[b]).Normalized());
+                }
+                return slot->midpoint;
+            };
+            std::vector<uint32_t> subdivided;
+            subdivided.reserve(triangles.size() * 4);
+            for (size_t i = 0; i < triangles.size(); i += 3) {
+                uint32_t a = triangles[i], b = triangles[i + 1], c = triangles[i + 2];
+                uint32_t ab = midpoint(a, b), bc = midpoint(b, c), ca = midpoint(c, a);
+                uint32_t split[12] = { a, ab, ca, b, bc, ab, c, ca, bc, ab, bc, ca };
+                for (uint32_t index : split) {
+                    subdivided.push_back(index);
+                }
+            }
+            triangles.swap(subdivided);
+        }
+        for (const Float3& normal : positions) {
+            double u = .5 + detail::Atan2(normal.x, normal.z) / (2. * detail::PI);
+            double v = .5 + detail::Atan2(normal.y, detail::Sqrt(normal.x * normal.x + normal.z * normal.z)) / detail::PI;
+            *vertices++ = detail::MakeVertex<V>(normal * .5, u, v, normal);
+        }
+        for (uint32_t index : triangles) {
+            *indices++ = index;
+        }
+    }
+    /// <summary>Cylinder of diameter and height 1 along y with capped ends</summary>
+    /// <param name="sectors">Quads around the side, at least 3</param>
+    /// <param name="stacks">Quads along the side</param>
+    template<typename V>
+    constexpr void GenerateCylinder(uint32_t sectors, uint32_t stacks, V* vertices, uint32_t* indices) {
+        using detail::Float3;
+        for (uint32_t stack = 0; stack <= stacks; stack++) {
+            double v = (double)stack / stacks;
+            for (uint32_t sector = 0; sector <= sectors; sector++) {
+                double theta = 2. * detail::PI * sector / sectors;
+                Float3 normal{ detail::Sin(theta), 0., detail::Cos(theta) };
+                *vertices++ = detail::MakeVertex<V>(normal * .5 + Float3{ 0., v - .5, 0. }, (double)sector / sectors, v, normal);
+            }
+        }
+        for (uint32_t stack = 0; stack < stacks; stack++) {
+            for (uint32_t sector = 0; sector < sectors; sector++) {
+                uint32_t bottom = stack * (sectors + 1) + sector, top = bottom + sectors + 1;
+                uint32_t quad[6] = { bottom, bottom + 1, top + 1, top + 1, top, bottom };
+                for (uint32_t index : quad) {
+                    *indices++ = index;
+                }
+            }
+        }
+        // Caps: a center vertex and a ring of sectors vertices with the cap's normal
+        uint32_t center = (stacks + 1) * (sectors + 1);
+        for (double y : { -.5, .5 }) {
+            *vertices++ = detail::MakeVertex<V>({ 0., y, 0. }, .5, .5, { 0., y * 2., 0. });
+            for (uint32_t sector = 0; sector < sectors; sector++) {
+                double theta = 2. * detail::PI * sector / sectors;
+                double x = detail::Sin(theta) * .5, z = detail::Cos(theta) * .5;
+                *vertices++ = detail::MakeVertex<V>({ x, y, z }, .5 + x, .5 - z * y * 2., { 0., y * 2., 0. });
+            }
+            for (uint32_t sector = 0; sector < sectors; sector++) {
+                uint32_t current = center + 1 + sector, next = center + 1 + (sector + 1) % sectors;
+                *indices++ = center;
+                *indices++ = y > 0. ? current : next;
+                *indices++ = y > 0. ? next : current;
+            }
+            center += sectors + 1;
+        }
+    }
+
+    namespace detail {
+        template<typename V, uint32_t VertexCount, uint32_t IndexCount, typename Generator>
+        constexpr Mesh<V, VertexCount, IndexCount> MakeMesh(Generator generate) {
+            Mesh<V, VertexCount, IndexCount> mesh;
+            generate(mesh.vertices.data(), mesh.indices.data());
+            return mesh;
+        }
+        template<typename V, typename Generator>
+        MeshData<V> MakeMeshData(uint32_t vertexCount, uint32_t indexCount, Generator generate) {
+            MeshData<V> mesh{ std::vector<V>(vertexCount), std::vector<uint32_t>(indexCount) };
+            generate(mesh.vertices.data(), mesh.indices.data());
+            return mesh;
+        }
+    }
+
+    // Compile time generators, the tessellation is part of the type
+    template<uint32_t Segments = 1, typename V = Vertex>
+    constexpr auto Cube() {
+        return detail::MakeMesh<V, CubeVertexCount(Segments), CubeIndexCount(Segments)>([](V* vertices, uint32_t* indices) {
+            GenerateCube(Segments, vertices, indices);
+        });
+    }
+    template<uint32_t Columns, uint32_t Rows, typename V = Vertex>
+    constexpr auto Grid() {
+        return detail::MakeMesh<V, GridVertexCount(Columns, Rows), GridIndexCount(Columns, Rows)>([](V* vertices, uint32_t* indices) {
+            GenerateGrid(Columns, Rows, vertices, indices);
+        });
+    }
+    template<uint32_t Segments = 1, typename V = Vertex>
+    constexpr auto Plane() {
+        return detail::MakeMesh<V, GridVertexCount(Segments, Segments), GridIndexCount(Segments, Segments)>([](V* vertices, uint32_t* indices) {
+            GeneratePlane(Segments, vertices, indices);
+        });
+    }
+    template<uint32_t Rings, uint32_t Sectors, typename V = Vertex>
+    constexpr auto UvSphere() {
+        static_assert(Rings >= 2 && Sectors >= 3, "a uv sphere needs at least 2 rings and 3 sectors");
+        return detail::MakeMesh<V, UvSphereVertexCount(Rings, Sectors), UvSphereIndexCount(Rings, Sectors)>([](V* vertices, uint32_t* indices) {
+            GenerateUvSphere(Rings, Sectors, vertices, indices);
+        });
+    }
+    template<uint32_t Subdivisions, typename V = Vertex>
+    constexpr auto IcoSphere() {
+        return detail::MakeMesh<V, IcoSphereVertexCount(Subdivisions), IcoSphereIndexCount(Subdivisions)>([](V* vertices, uint32_t* indices) {
+            GenerateIcoSphere(Subdivisions, vertices, indices);
+        });
+    }
+    template<uint32_t Sectors, uint32_t Stacks = 1, typename V = Vertex>
+    constexpr auto Cylinder() {
+        static_assert(Sectors >= 3 && Stacks >= 1, "a cylinder needs at least 3 sectors and 1 stack");
+        return detail::MakeMesh<V, CylinderVertexCount(Sectors, Stacks), CylinderIndexCount(Sectors, Stacks)>([](V* vertices, uint32_t* indices) {
+            GenerateCylinder(Sectors, Stacks, vertices, indices);
+        });
+    }
+
+    // Runtime generators, for tessellations chosen at runtime or too large to generate at compile time
+    template<typename V = Vertex>
+    MeshData<V> Cube(uint32_t segments) {
+        return detail::MakeMeshData<V>(CubeVertexCount(segments), CubeIndexCount(segments), [&](V* vertices, uint32_t* indices) {
+            GenerateCube(segments, vertices, indices);
+        });
+    }
+    template<typename V = Vertex>
+    MeshData<V> Grid(uint32_t columns, uint32_t rows) {
+        return detail::MakeMeshData<V>(GridVertexCount(columns, rows), GridIndexCount(columns, rows), [&](V* vertices, uint32_t* indices) {
+            GenerateGrid(columns, rows, vertices, indices);
+        });
+    }
+    template<typename V = Vertex>
+    MeshData<V> Plane(uint32_t segments) {
+        return detail::MakeMeshData<V>(GridVertexCount(segments, segments), GridIndexCount(segments, segments), [&](V* vertices, uint32_t* indices) {
+            GeneratePlane(segments, vertices, indices);
+        });
+    }
+    template<typename V = Vertex>
+    MeshData<V> UvSphere(uint32_t rings, uint32_t sectors) {
+        rings = rings < 2 ? 2 : rings;
+        sectors = sectors < 3 ? 3 : sectors;
+        return detail::MakeMeshData<V>(UvSphereVertexCount(rings, sectors), UvSphereIndexCount(rings, sectors), [&](V* vertices, uint32_t* indices) {
+            GenerateUvSphere(rings, sectors, vertices, indices);
+        });
+    }
+    template<typename V = Vertex>
+    MeshData<V> IcoSphere(uint32_t subdivisions) {
+        return detail::MakeMeshData<V>(IcoSphereVertexCount(subdivisions), IcoSphereIndexCount(subdivisions), [&](V* vertices, uint32_t* indices) {
+            GenerateIcoSphere(subdivisions, vertices, indices);
+        });
+    }
+    template<typename V = Vertex>
+    MeshData<V> Cylinder(uint32_t sectors, uint32_t stacks = 1) {
+        sectors = sectors < 3 ? 3 : sectors;
+        stacks = stacks < 1 ? 1 : stacks;
+        return detail::MakeMeshData<V>(CylinderVertexCount(sectors, stacks), CylinderIndexCount(sectors, stacks), [&](V* vertices, uint32_t* indices) {
+            GenerateCylinder(sectors, stacks, vertices, indices);
+        });
+    }
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstdint>
+#include <iterator>
+#include <map>
+
+// The range allocator class
+// Hands out ranges of a linear space, e.g. elements of a buffer, from a free list sorted by offset. An allocation
+// takes the first free range that fits and freeing merges the range with its free neighbours, so the list only
+// holds the actual holes. Nothing is stored in the managed space itself.
+class RangeAllocator {
+public:
+    static constexpr uint32_t INVALID_OFFSET = UINT32_MAX;
+    explicit RangeAllocator(uint32_t capacity = 0) {
+        Reset(0, capacity);
+    }
+    // The offset of a free range of size elements, INVALID_OFFSET when no range is large enough
+    uint32_t Allocate(uint32_t size) {
+        if (size == 0) {
+            return INVALID_OFFSET;
+        }
+        for (auto it = m_FreeRanges.begin(); it != m_FreeRanges.end(); ++it) {
+            if (it->second < size) {
+                continue;
+            }
+            uint32_t offset = it->first;
+            uint32_t remaining = it->second - size;
+            m_FreeRanges.erase(it);
+            if (remaining > 0) {
+                m_FreeRanges.emplace(offset + size, remaining);
+            }
+            m_FreeSize -= size;
+            return offset;
+        }
+        return INVALID_OFFSET;
+    }
+    // Returns a range handed out by Allocate
+    void Free(uint32_t offset, uint32_t size) {
+        if (offset == INVALID_OFFSET || size == 0) {
+            return;
+        }
+        m_FreeSize += size;
+        auto next = m_FreeRanges.lower_bound(offset);
+        if (next != m_FreeRanges.begin()) {
+            auto previous = std::prev(next);
+            if (previous->first + previous->second == offset) {
+                offset = previous->first;
+                size += previous->second;
+                m_FreeRanges.erase(previous);
+            }
+        }
+        if (next != m_FreeRanges.end() && offset + size == next->first) {
+            size += next->second;
+            m_FreeRanges.erase(next);
+        }
+        m_FreeRanges.emplace(offset, size);
+    }
+    // Forgets every allocation, the first used elements stay allocated (the live data after compacting)
+    void Reset(uint32_t used, uint32_t capacity) {
+        m_FreeRanges.clear();
+        m_Capacity = capacity;
+        m_FreeSize = capacity > used ? capacity - used : 0;
+        if (m_FreeSize > 0) {
+            m_FreeRanges.emplace(used, m_FreeSize);
+        }
+    }
+    // Extends the space at its end, allocations keep their offsets
+    void Grow(uint32_t capacity) {
+        if (capacity <= m_Capacity) {
+            return;
+        }
+        uint32_t previous = m_Capacity;
+        m_Capacity = capacity;
+        Free(previous, capacity - previous);
+    }
+    uint32_t GetCapacity() const {
+        return m_Capacity;
+    }
+    uint32_t GetFreeSize() const {
+        return m_FreeSize;
+    }
+    uint32_t GetLargestFreeRange() const {
+        uint32_t largest = 0;
+        for (const auto& [offset, size] : m_FreeRanges) {
+            largest = size > largest ? size : largest;
+        }
+        return largest;
+    }
+    // Number of holes, 1 when all free space is in one piece
+    size_t GetFreeRangeCount() const {
+        return m_FreeRanges.size();
+    }
+private:
+    // Offset to size of every free range
+    std::map<uint32_t, uint32_t> m_FreeRanges;
+    uint32_t m_Capacity{};
+    uint32_t m_FreeSize{};
+};
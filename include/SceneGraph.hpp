@@ -0,0 +1,206 @@
+#pragma once
+
+#include <JobSystem.hpp>
+#include <TransformStorage.hpp>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// The scene graph class
+// Nodes are kept in depth first order in contiguous arrays so every subtree is a contiguous range that starts
+// with its root. Moving a node only marks it dirty, Update then recomputes the world matrices of the dirty
+// subtrees and nothing else, so the cost scales with what moved and not with the size of the scene.
+class SceneGraph {
+public:
+    // Handles stay valid while nodes are added and removed, unlike indices
+    typedef uint32_t NodeHandle;
+    static constexpr NodeHandle INVALID_NODE = UINT32_MAX;
+    // A range of depth first indices whose world matrices changed in the last Update
+    struct Range {
+        size_t begin;
+        size_t end;
+    };
+    /// <summary>Adds a node as the last child of parent</summary>
+    /// <param name="parent">The parent node or INVALID_NODE to add a root</param>
+    NodeHandle AddNode(NodeHandle parent = INVALID_NODE, const glm::vec3& position = glm::vec3(0.f), const glm::quat& rotation = glm::quat(1.f, 0.f, 0.f, 0.f), const glm::vec3& scale = glm::vec3(1.f)) {
+        size_t parentIndex = parent == INVALID_NODE ? NO_INDEX : m_HandleToIndex[parent];
+        // The new node goes right after the parent's last descendant (or at the end for roots)
+        size_t index = parentIndex == NO_INDEX ? m_Parent.size() : parentIndex + m_SubtreeSize[parentIndex];
+        for (size_t& p : m_Parent) {
+            if (p != NO_INDEX && p >= index) {
+                p++;
+            }
+        }
+        m_Parent.insert(m_Parent.begin() + index, parentIndex);
+        m_SubtreeSize.insert(m_SubtreeSize.begin() + index, 1);
+        m_Local.Insert(index, position, rotation, scale);
+        m_World.insert(m_World.begin() + index, glm::mat4(1.f));
+        for (size_t p = parentIndex; p != NO_INDEX; p = m_Parent[p]) {
+            m_SubtreeSize[p]++;
+        }
+        NodeHandle handle;
+        if (!m_FreeHandles.empty()) {
+            handle = m_FreeHandles.back();
+            m_FreeHandles.pop_back();
+        }
+        else {
+            handle = (NodeHandle)m_HandleToIndex.size();
+            m_HandleToIndex.push_back(0);
+        }
+        m_IndexToHandle.insert(m_IndexToHandle.begin() + index, handle);
+        RemapHandles(index);
+        m_Dirty.push_back(handle);
+        return handle;
+    }
+    // Removes the node with all of its descendants
+    void RemoveNode(NodeHandle node) {
+        size_t begin = m_HandleToIndex[node];
+        size_t count = m_SubtreeSize[begin];
+        size_t end = begin + count;
+        for (size_t p = m_Parent[begin]; p != NO_INDEX; p = m_Parent[p]) {
+            m_SubtreeSize[p] -= count;
+        }
+        for (size_t i = begin; i < end; i++) {
+            m_FreeHandles.push_back(m_IndexToHandle[i]);
+            m_HandleToIndex[m_IndexToHandle[i]] = NO_INDEX;
+        }
+        m_Parent.erase(m_Parent.begin() + begin, m_Parent.begin() + end);
+        m_SubtreeSize.erase(m_SubtreeSize.begin() + begin, m_SubtreeSize.begin() + end);
+        m_Local.Erase(begin, end);
+        m_World.erase(m_World.begin() + begin, m_World.begin() + end);
+        m_IndexToHandle.erase(m_IndexToHandle.begin() + begin, m_IndexToHandle.begin() + end);
+        for (size_t& p : m_Parent) {
+            if (p != NO_INDEX && p >= end) {
+                p -= count;
+            }
+        }
+        RemapHandles(begin);
+        // Dirty marks of removed nodes are dropped
+        m_Dirty.erase(std::remove_if(m_Dirty.begin(), m_Dirty.end(), [this](NodeHandle h) { return m_HandleToIndex[h] == NO_INDEX; }), m_Dirty.end());
+    }
+    glm::vec3 GetPosition(NodeHandle node) const {
+        return m_Local.GetPosition(m_HandleToIndex[node]);
+    }
+    // Sets the position relative to the parent
+    void SetPosition(NodeHandle node, const glm::vec3& position) {
+        m_Local.SetPosition(m_HandleToIndex[node], position);
+        m_Dirty.push_back(node);
+    }
+    glm::quat GetRotation(NodeHandle node) const {
+        return m_Local.GetRotation(m_HandleToIndex[node]);
+    }
+    // Sets the rotation relative to the parent
+    void SetRotation(NodeHandle node, const glm::quat& rotation) {
+        m_Local.SetRotation(m_HandleToIndex[node], rotation);
+        m_Dirty.push_back(node);
+    }
+    glm::vec3 GetScale(NodeHandle node) const {
+        return m_Local.GetScale(m_HandleToIndex[node]);
+    }
+    void SetScale(NodeHandle node, const glm::vec3& scale) {
+        m_Local.SetScale(m_HandleToIndex[node], scale);
+        m_Dirty.push_back(node);
+    }
+    // Recomputes the world matrices of the dirty nodes and their descendants, returns the number of nodes recomputed
+    // Dirty subtrees do not overlap, with a job system they are recomputed in parallel
+    size_t Update(JobSystem* jobSystem = nullptr) {
+        m_Changed.clear();
+        if (m_Dirty.empty()) {
+            return 0;
+        }
+        std::vector<size_t> dirty;
+        dirty.reserve(m_Dirty.size());
+        for (NodeHandle handle : m_Dirty) {
+            dirty.push_back(m_HandleToIndex[handle]);
+        }
+        m_Dirty.clear();
+        std::sort(dirty.begin(), dirty.end());
+        std::vector<Range> subtrees;
+        size_t updated = 0;
+        for (size_t index : dirty) {
+            // Already covered by a dirty ancestor's subtree
+            if (!subtrees.empty() && index < subtrees.back().end) {
+                continue;
+            }
+            subtrees.push_back({ index, index + m_SubtreeSize[index] });
+            updated += m_SubtreeSize[index];
+        }
+        if (jobSystem != nullptr) {
+            jobSystem->ParallelFor(subtrees.size(), 1, [this, &subtrees](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; i++) {
+                    UpdateSubtree(subtrees[i]);
+                }
+            });
+        }
+        else {
+            for (const Range& subtree : subtrees) {
+                UpdateSubtree(subtree);
+            }
+        }
+        for (const Range& subtree : subtrees) {
+            if (!m_Changed.empty() && m_Changed.back().end == subtree.begin) {
+                m_Changed.back().end = subtree.end;
+            }
+            else {
+                m_Changed.push_back(subtree);
+            }
+        }
+        return updated;
+    }
+    const glm::mat4& GetWorldMatrix(NodeHandle node) const {
+        return m_World[m_HandleToIndex[node]];
+    }
+    // The world matrices of every node in depth first order
+    const std::vector<glm::mat4>& GetWorldMatrices() const {
+        return m_World;
+    }
+    // The ranges of world matrices recomputed by the last Update (to upload only what changed)
+    const std::vector<Range>& GetChangedRanges() const {
+        return m_Changed;
+    }
+    // The depth first index of a node, the node's subtree occupies [index, index + GetSubtreeSize(node))
+    size_t GetIndex(NodeHandle node) const {
+        return m_HandleToIndex[node];
+    }
+    // The number of nodes in the subtree of node, including itself
+    size_t GetSubtreeSize(NodeHandle node) const {
+        return m_SubtreeSize[m_HandleToIndex[node]];
+    }
+    size_t Size() const {
+        return m_Parent.size();
+    }
+private:
+    // Parent of roots and index of removed handles
+    static constexpr size_t NO_INDEX = SIZE_MAX;
+    // The local matrices of the whole range are built in one batch (four at a time with simd), then parents, which come
+    // before their children, are always up to date by the time a child is multiplied with its parent's world matrix
+    void UpdateSubtree(const Range& subtree) {
+        m_Local.BuildModelMatrices(m_World.data(), subtree.begin, subtree.end);
+        for (size_t i = subtree.begin; i < subtree.end; i++) {
+            if (m_Parent[i] != NO_INDEX) {
+                m_World[i] = m_World[m_Parent[i]] * m_World[i];
+            }
+        }
+    }
+    // Updates the handle lookup of every node from index onwards after they moved
+    void RemapHandles(size_t index) {
+        for (size_t i = index; i < m_IndexToHandle.size(); i++) {
+            m_HandleToIndex[m_IndexToHandle[i]] = i;
+        }
+    }
+private:
+    // All of these are indexed by depth first index
+    std::vector<size_t> m_Parent;
+    std::vector<size_t> m_SubtreeSize;
+    TransformStorage m_Local;
+    std::vector<glm::mat4> m_World;
+    std::vector<NodeHandle> m_IndexToHandle;
+    // Indexed by handle
+    std::vector<size_t> m_HandleToIndex;
+    std::vector<NodeHandle> m_FreeHandles;
+    std::vector<NodeHandle> m_Dirty;
+    std::vector<Range> m_Changed;
+};
@@ -4,6 +4,7 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include <cmath>
 #include <cstdio>
 #include <fstream>
 #include <sstream>
@@ -24,6 +25,25 @@ static void extractTextFromFile(const std::string& file, std::string& store) {
 }
 
 namespace phong {
+    // A light stops contributing once its brightest color times its attenuation drops below this
+    constexpr float DEFAULT_ATTENUATION_THRESHOLD = 1.f / 256.f;
+    // The distance at which a light of the given peak intensity attenuates below threshold
+    inline float AttenuationRadius(float constant, float linear, float quadratic, float intensity, float threshold) {
+        // Solving constant + linear * d + quadratic * d^2 = intensity / threshold for d
+        float c = constant - intensity / threshold;
+        if (c >= 0.f) {
+            // Never bright enough
+            return 0.f;
+        }
+        if (quadratic > 0.f) {
+            return (-linear + std::sqrt(linear * linear - 4.f * quadratic * c)) / (2.f * quadratic);
+        }
+        if (linear > 0.f) {
+            return -c / linear;
+        }
+        // Never attenuates
+        return INFINITY;
+    }
     struct LightSource {
         glm::vec3 ambient;
         glm::vec3 diffuse;
@@ -38,6 +58,15 @@ namespace phong {
         float constant = 1.f;
         float linear;
         float quadratic;
+        // The brightest color channel the light can add to a surface before attenuation
+        float PeakIntensity() const {
+            glm::vec3 peak = ambient + diffuse + specular;
+            return glm::max(peak.x, glm::max(peak.y, peak.z));
+        }
+        // The distance beyond which the light can be skipped
+        float InfluenceRadius(float threshold = DEFAULT_ATTENUATION_THRESHOLD) const {
+            return AttenuationRadius(constant, linear, quadratic, PeakIntensity(), threshold);
+        }
     };
     typedef struct SpotLight : public LightSource {
         glm::vec3 position;
@@ -47,6 +76,11 @@ namespace phong {
         float constant = 1.f;
         float linear;
         float quadratic;
+        // The distance beyond which only the (unattenuated) ambient of the light is left
+        float InfluenceRadius(float threshold = DEFAULT_ATTENUATION_THRESHOLD) const {
+            glm::vec3 peak = diffuse + specular;
+            return AttenuationRadius(constant, linear, quadratic, glm::max(peak.x, glm::max(peak.y, peak.z)), threshold);
+        }
     } FlashLight;
 }
 // The shader class
@@ -73,6 +107,25 @@ public:
 		fragThread.join();
 		return Shader(vertexSource.c_str(), fragmentSource.c_str());
 	}
+	/// <summary>Loading from memory with a geometry shader between the vertex and fragment shaders</summary>
+	/// <param name="geometrySource">Source code for the geometry shader</param>
+	static Shader CreateFromSource(const char* vertexSource, const char* geometrySource, const char* fragmentSource) {
+		return Shader(vertexSource, fragmentSource, geometrySource);
+	}
+	/// <summary>Loading from file with a geometry shader between the vertex and fragment shaders</summary>
+	/// <param name="geometryFile">File path to geometry shader source code file</param>
+	static Shader LoadFromFile(const char* vertexFile, const char* geometryFile, const char* fragmentFile) {
+		std::string vertexSource;
+		std::string geometrySource;
+		std::string fragmentSource;
+		std::thread vertThread{ [&]() { extractTextFromFile(vertexFile, vertexSource); } };
+		std::thread geomThread{ [&]() { extractTextFromFile(geometryFile, geometrySource); } };
+		std::thread fragThread{ [&]() { extractTextFromFile(fragmentFile, fragmentSource); } };
+		vertThread.join();
+		geomThread.join();
+		fragThread.join();
+		return Shader(vertexSource.c_str(), fragmentSource.c_str(), geometrySource.c_str());
+	}
 	// Sets the program to be active
 	void UseProgram() const {
 		glUseProgram(m_ProgramObject);
@@ -91,7 +144,35 @@ public:
 			glUniform1f(loc, v);
 		}
 	}
-    void SetFloat3(const char* name, const glm::vec3& v3) {
+    // Sets a vec2 uniform
+    void SetFloat2(const char* name, const glm::vec2& v2) const {
+        int loc = glGetUniformLocation(m_ProgramObject, name);
+        if (loc >= 0) {
+            glUniform2fv(loc, 1, glm::value_ptr(v2));
+        }
+    }
+    // Sets an int array uniform
+    void SetInts(const char* name, const int* v, int count) const {
+        int loc = glGetUniformLocation(m_ProgramObject, name);
+        if (loc >= 0) {
+            glUniform1iv(loc, count, v);
+        }
+    }
+    // Sets an ivec3 uniform
+    void SetInt3(const char* name, const glm::ivec3& v3) const {
+        int loc = glGetUniformLocation(m_ProgramObject, name);
+        if (loc >= 0) {
+            glUniform3iv(loc, 1, glm::value_ptr(v3));
+        }
+    }
+    // Sets a vec4 uniform
+    void SetFloat4(const char* name, const glm::vec4& v4) const {
+        int loc = glGetUniformLocation(m_ProgramObject, name);
+        if (loc >= 0) {
+            glUniform4fv(loc, 1, glm::value_ptr(v4));
+        }
+    }
+    void SetFloat3(const char* name, const glm::vec3& v3) const {
         int loc = glGetUniformLocation(m_ProgramObject, name);
         if (loc >= 0) {
             glUniform3fv(loc, 1, glm::value_ptr(v3));
@@ -192,8 +273,8 @@ public:
         }
     }
 private:
-	// Shader constructor
-	Shader(const char* vertexSource, const char* fragmentSource) {
+	// Shader constructor, the geometry shader is optional
+	Shader(const char* vertexSource, const char* fragmentSource, const char* geometrySource = nullptr) {
 		m_ProgramObject = glCreateProgram();
 		GLuint vert = glCreateShader(GL_VERTEX_SHADER);
 		glShaderSource(vert, 1, &vertexSource, nullptr);
@@ -205,6 +286,18 @@ private:
 		else {
 			return;
 		}
+		if (geometrySource != nullptr) {
+			GLuint geom = glCreateShader(GL_GEOMETRY_SHADER);
+			glShaderSource(geom, 1, &geometrySource, nullptr);
+			glCompileShader(geom);
+			if (CheckCompileStatus(geom)) {
+				glAttachShader(m_ProgramObject, geom);
+				glDeleteShader(geom);
+			}
+			else {
+				return;
+			}
+		}
 		GLuint frag = glCreateShader(GL_FRAGMENT_SHADER);
 		glShaderSource(frag, 1, &fragmentSource, nullptr);
 		glCompileShader(frag);
@@ -0,0 +1,164 @@
+#pragma once
+
+#include <MeshFile.hpp>
+#include <MeshletCuller.hpp>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// The static mesh class
+// The gpu side of a converted mesh file: the vertex streams and indices are copied from the mapped file into one
+// vertex and one index buffer as they are, the stream table only tells the vertex array where each attribute starts.
+// Attributes are bound to the locations the file names (0 position, 1 texture coordinates, 2 normal).
+// Shader side, for compressed files:
+//     position  aPosition * uPositionScale + uPositionOffset, see GetPositionScale and GetPositionOffset
+//     normal    vec2, OctahedralDecode(aNormal) when HasOctahedralNormals
+class StaticMesh {
+public:
+    ~StaticMesh() {
+        glDeleteVertexArrays(1, &m_Vao);
+        glDeleteBuffers(1, &m_Vbo);
+        glDeleteBuffers(1, &m_Ebo);
+    }
+    // Uploads a mapped mesh file, the file can be unmapped afterwards
+    static StaticMesh Create(const MeshFile& file) {
+        return StaticMesh(file);
+    }
+    // Binds the vertex array, e.g. to set up instance attributes next to the mesh's
+    void Bind() const {
+        glBindVertexArray(m_Vao);
+    }
+    /// <summary>Draws one submesh, the vertex array has to be bound</summary>
+    /// <param name="instanceCount">Instances drawn, for meshes with instance attributes</param>
+    void DrawSubmesh(size_t submesh, GLsizei instanceCount = 1) const {
+        const meshfile::Submesh& range = m_Submeshes[submesh];
+        glDrawElementsInstanced(GL_TRIANGLES, (GLsizei)range.indexCount, m_IndexType,
+            reinterpret_cast<const void*>((uintptr_t)range.firstIndex * m_IndexSize), instanceCount);
+    }
+    // Binds the vertex array and draws every submesh of a level of detail
+    void Draw(uint32_t lod = 0, GLsizei instanceCount = 1) const {
+        Bind();
+        lod = std::min(lod, GetLodCount() - 1);
+        for (size_t i = m_LodStarts[lod]; i < m_LodStarts[lod + 1]; i++) {
+            DrawSubmesh(i, instanceCount);
+        }
+    }
+    /// <summary>Binds the vertex array and draws the meshlets of a level of detail the culler keeps</summary>
+    /// <remarks>Falls back to Draw for files without meshlets</remarks>
+    void DrawCulled(MeshletCuller& culler, uint32_t lod, const glm::mat4& model, const glm::mat4& viewProjection, const glm::vec3& cameraPosition) const {
+        lod = std::min(lod, GetLodCount() - 1);
+        size_t first = m_LodStarts[lod], end = m_LodStarts[lod + 1];
+        if (m_Meshlets.empty() || first == end) {
+            Draw(lod);
+            return;
+        }
+        // The meshlets of a level's submeshes follow each other like the submeshes do
+        size_t firstMeshlet = m_Submeshes[first].firstMeshlet;
+        size_t meshletEnd = m_Submeshes[end - 1].firstMeshlet + m_Submeshes[end - 1].meshletCount;
+        culler.Cull(m_Meshlets.data() + firstMeshlet, meshletEnd - firstMeshlet, model, viewProjection, cameraPosition, m_IndexSize);
+        Bind();
+        culler.Draw(m_IndexType);
+    }
+    size_t GetSubmeshCount() const {
+        return m_Submeshes.size();
+    }
+    // Levels of detail in the file, at least 1
+    uint32_t GetLodCount() const {
+        return (uint32_t)m_LodErrors.size();
+    }
+    // Object space error of each level, the input of LodSelector
+    const std::vector<float>& GetLodErrors() const {
+        return m_LodErrors;
+    }
+    const meshfile::Submesh& GetSubmesh(size_t submesh) const {
+        return m_Submeshes[submesh];
+    }
+    // Empty for files converted without meshlets
+    const std::vector<meshfile::Meshlet>& GetMeshlets() const {
+        return m_Meshlets;
+    }
+    const glm::vec3& GetBoundsMin() const {
+        return m_BoundsMin;
+    }
+    const glm::vec3& GetBoundsMax() const {
+        return m_BoundsMax;
+    }
+    // Scale and offset that restore positions quantized to the bounds, 1 and 0 for float positions
+    const glm::vec3& GetPositionScale() const {
+        return m_PositionScale;
+    }
+    const glm::vec3& GetPositionOffset() const {
+        return m_PositionOffset;
+    }
+    bool HasOctahedralNormals() const {
+        return m_OctahedralNormals;
+    }
+private:
+    // Static mesh constructor
+    StaticMesh(const MeshFile& file) {
+        glGenVertexArrays(1, &m_Vao);
+        glGenBuffers(1, &m_Vbo);
+        glGenBuffers(1, &m_Ebo);
+        if (!file.IsValid()) {
+            return;
+        }
+        const meshfile::Header& header = file.GetHeader();
+        bool quantizedPositions = false;
+        glBindVertexArray(m_Vao);
+        glBindBuffer(GL_ARRAY_BUFFER, m_Vbo);
+        glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)header.vertexDataSize, file.GetVertexData(), GL_STATIC_DRAW);
+        for (uint32_t i = 0; i < header.streamCount; i++) {
+            const meshfile::Stream& stream = file.GetStreams()[i];
+            glVertexAttribPointer(stream.attribute, (GLint)stream.components, stream.type, stream.normalized ? GL_TRUE : GL_FALSE,
+                (GLsizei)stream.stride, reinterpret_cast<const void*>((uintptr_t)stream.offset));
+            glEnableVertexAttribArray(stream.attribute);
+            quantizedPositions |= stream.attribute == meshfile::POSITION && stream.encoding == meshfile::BOUNDS;
+            m_OctahedralNormals |= stream.attribute == meshfile::NORMAL && stream.encoding == meshfile::OCTAHEDRAL;
+        }
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_Ebo);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)header.indexDataSize, file.GetIndexData(), GL_STATIC_DRAW);
+        glBindVertexArray(0);
+        m_IndexSize = header.indexSize;
+        m_IndexType = header.indexSize == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+        m_Submeshes.assign(file.GetSubmeshes(), file.GetSubmeshes() + header.submeshCount);
+        m_Meshlets.assign(file.GetMeshlets(), file.GetMeshlets() + header.meshletCount);
+        // Submeshes are sorted by level, a level's error is the largest of its submeshes
+        m_LodStarts.assign(1, 0);
+        m_LodErrors.clear();
+        for (size_t i = 0; i < m_Submeshes.size(); i++) {
+            if (m_Submeshes[i].lod >= m_LodErrors.size()) {
+                m_LodStarts.resize(m_Submeshes[i].lod + 1, i);
+                m_LodErrors.resize(m_Submeshes[i].lod + 1, m_Submeshes[i].lodError);
+            }
+            m_LodErrors.back() = std::max(m_LodErrors.back(), m_Submeshes[i].lodError);
+        }
+        if (m_LodErrors.empty()) {
+            m_LodErrors.push_back(0.f);
+        }
+        m_LodStarts.push_back(m_Submeshes.size());
+        memcpy(&m_BoundsMin, header.boundsMin, sizeof(m_BoundsMin));
+        memcpy(&m_BoundsMax, header.boundsMax, sizeof(m_BoundsMax));
+        if (quantizedPositions) {
+            m_PositionScale = m_BoundsMax - m_BoundsMin;
+            m_PositionOffset = m_BoundsMin;
+        }
+    }
+private:
+    GLuint m_Vao{};
+    GLuint m_Vbo{};
+    GLuint m_Ebo{};
+    GLenum m_IndexType{ GL_UNSIGNED_INT };
+    uint32_t m_IndexSize{ 4 };
+    std::vector<meshfile::Submesh> m_Submeshes;
+    std::vector<meshfile::Meshlet> m_Meshlets;
+    // First submesh of every level, followed by the submesh count
+    std::vector<size_t> m_LodStarts{ 0, 0 };
+    std::vector<float> m_LodErrors{ 0.f };
+    glm::vec3 m_BoundsMin{}, m_BoundsMax{};
+    glm::vec3 m_PositionScale{ 1.f }, m_PositionOffset{ 0.f };
+    bool m_OctahedralNormals{};
+};
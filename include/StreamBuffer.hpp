@@ -0,0 +1,167 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <cstdio>
+
+// The stream buffer class
+// Hands out per-frame bump allocations for dynamic data (instance data, uniforms, dynamic vertices).
+// When buffer storage is available the buffer is mapped once (persistent and coherent) and split into
+// one region per frame in flight, each guarded by a fence so the cpu never writes into a region the gpu
+// is still reading. Without buffer storage the buffer is orphaned and remapped every frame instead.
+class StreamBuffer {
+public:
+    // A block of memory handed out by Allocate
+    struct Allocation {
+        // Where the cpu writes the data
+        void* data = nullptr;
+        // The offset into the buffer object the gpu reads the data from
+        GLintptr offset = 0;
+        GLsizeiptr size = 0;
+        explicit operator bool() const {
+            return data != nullptr;
+        }
+    };
+    // Triple buffering is enough to keep the cpu from waiting on the gpu
+    static constexpr unsigned int DEFAULT_FRAME_COUNT = 3;
+    static constexpr unsigned int MAX_FRAME_COUNT = 4;
+    ~StreamBuffer() {
+        for (GLsync& fence : m_Fences) {
+            if (fence != nullptr) {
+                glDeleteSync(fence);
+            }
+        }
+        if (m_Persistent && m_Mapped != nullptr) {
+            glBindBuffer(GL_COPY_WRITE_BUFFER, m_BufferObject);
+            glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+        }
+        glDeleteBuffers(1, &m_BufferObject);
+    }
+    /// <summary>Creates a stream buffer with a region of frameSize bytes for each frame in flight</summary>
+    /// <param name="target">The target the buffer is bound to when used (GL_ARRAY_BUFFER, GL_UNIFORM_BUFFER...)</param>
+    /// <param name="frameSize">The number of bytes that can be allocated each frame</param>
+    /// <param name="frameCount">The number of frames in flight (clamped to MAX_FRAME_COUNT)</param>
+    static StreamBuffer Create(GLenum target, GLsizeiptr frameSize, unsigned int frameCount = DEFAULT_FRAME_COUNT) {
+        return StreamBuffer(target, frameSize, frameCount);
+    }
+    // Waits for the gpu to release the next region and resets the allocator, call once at the start of the frame
+    void BeginFrame() {
+        m_Offset = 0;
+        if (m_Persistent) {
+            m_Region = (m_Region + 1) % m_FrameCount;
+            WaitForFence(m_Fences[m_Region]);
+            return;
+        }
+        // Orphaning: the driver hands us fresh storage while the gpu keeps reading the old one
+        glBindBuffer(GL_COPY_WRITE_BUFFER, m_BufferObject);
+        glBufferData(GL_COPY_WRITE_BUFFER, m_FrameSize, nullptr, GL_STREAM_DRAW);
+        m_Mapped = static_cast<uint8_t*>(glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, m_FrameSize, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+    }
+    /// <summary>Allocates size bytes from the current frame's region</summary>
+    /// <param name="size">The number of bytes to allocate</param>
+    /// <param name="alignment">The alignment of the offset (GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT for uniforms), must be a power of two</param>
+    Allocation Allocate(GLsizeiptr size, GLsizeiptr alignment = 16) {
+        if (m_Mapped == nullptr) {
+            fprintf(stderr, "stream buffer allocation outside of BeginFrame/Flush\n");
+            return {};
+        }
+        GLsizeiptr offset = (m_Offset + alignment - 1) & ~(alignment - 1);
+        if (offset + size > m_FrameSize) {
+            fprintf(stderr, "stream buffer out of memory (%lld of %lld bytes requested)\n", (long long)(offset + size), (long long)m_FrameSize);
+            return {};
+        }
+        m_Offset = offset + size;
+        GLintptr base = m_Persistent ? (GLintptr)m_Region * m_FrameSize : 0;
+        return { m_Mapped + base + offset, base + offset, size };
+    }
+    // Allocates space for count elements of T, aligned to T
+    template<typename T>
+    Allocation Allocate(size_t count) {
+        return Allocate(sizeof(T) * count, alignof(T) < 4 ? 4 : alignof(T));
+    }
+    // Makes the writes of this frame visible to the gpu, call before the draw calls that source from the buffer
+    void Flush() {
+        // Coherent mappings are visible without any action
+        if (m_Persistent || m_Mapped == nullptr) {
+            return;
+        }
+        glBindBuffer(GL_COPY_WRITE_BUFFER, m_BufferObject);
+        glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+        m_Mapped = nullptr;
+    }
+    // Guards the current region with a fence, call once after the frame's draw calls were submitted
+    void EndFrame() {
+        Flush();
+        if (m_Persistent) {
+            m_Fences[m_Region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        }
+    }
+    // Binds the buffer to the target it was created with
+    void Bind() const {
+        glBindBuffer(m_Target, m_BufferObject);
+    }
+    // Binds an allocation to an indexed binding point (uniform blocks)
+    void BindRange(GLenum target, GLuint index, const Allocation& allocation) const {
+        glBindBufferRange(target, index, m_BufferObject, allocation.offset, allocation.size);
+    }
+    GLuint GetBufferObject() const {
+        return m_BufferObject;
+    }
+    // Returns true when the buffer is persistently mapped
+    bool IsPersistent() const {
+        return m_Persistent;
+    }
+private:
+    // Stream buffer constructor
+    StreamBuffer(GLenum target, GLsizeiptr frameSize, unsigned int frameCount)
+        : m_Target(target), m_FrameSize(frameSize) {
+        m_FrameCount = frameCount == 0 ? 1 : (frameCount > MAX_FRAME_COUNT ? MAX_FRAME_COUNT : frameCount);
+        // Only loaded with a 4.4 context or when the ARB_buffer_storage entry point was loaded manually
+        m_Persistent = glBufferStorage != nullptr;
+        glGenBuffers(1, &m_BufferObject);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, m_BufferObject);
+        if (m_Persistent) {
+            constexpr GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            GLsizeiptr size = m_FrameSize * m_FrameCount;
+            glBufferStorage(GL_COPY_WRITE_BUFFER, size, nullptr, flags);
+            m_Mapped = static_cast<uint8_t*>(glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, size, flags));
+            if (m_Mapped == nullptr) {
+                fprintf(stderr, "cannot persistently map stream buffer\n");
+            }
+            // BeginFrame advances the region before the first allocation
+            m_Region = m_FrameCount - 1;
+        }
+        else {
+            glBufferData(GL_COPY_WRITE_BUFFER, m_FrameSize, nullptr, GL_STREAM_DRAW);
+        }
+    }
+    // Blocks until the gpu has passed the fence and deletes it
+    static void WaitForFence(GLsync& fence) {
+        if (fence == nullptr) {
+            return;
+        }
+        // One second per wait, a region should never take longer than that to free up
+        static constexpr GLuint64 TIMEOUT_NS = 1000000000;
+        GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+        while (true) {
+            GLenum result = glClientWaitSync(fence, flags, TIMEOUT_NS);
+            if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED || result == GL_WAIT_FAILED) {
+                break;
+            }
+            flags = 0;
+        }
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+private:
+    GLuint m_BufferObject{};
+    GLenum m_Target{};
+    GLsizeiptr m_FrameSize{};
+    GLsizeiptr m_Offset{};
+    unsigned int m_FrameCount{};
+    unsigned int m_Region{};
+    bool m_Persistent{};
+    uint8_t* m_Mapped{};
+    GLsync m_Fences[MAX_FRAME_COUNT]{};
+};
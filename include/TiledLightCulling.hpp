@@ -0,0 +1,433 @@
+#pragma once
+
+#include <JobSystem.hpp>
+#include <Shader.hpp>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define TILED_LIGHT_CULLING_SSE
+#include <emmintrin.h>
+#endif
+
+// The tiled light culling class
+// Bins point and spot lights into screen tiles on the cpu for targets without compute shaders. Every light's
+// bounding sphere is projected to a screen rectangle (four lights at a time with simd), then each row of tiles
+// keeps the lights whose rectangle overlaps it and whose sphere reaches past the row's top and bottom planes, and
+// tests them against its tiles four at a time, rectangle first and sphere against the tile's side planes after.
+// The sphere tests drop the lights whose rectangle only grazes a tile with its corner. Rows are binned in parallel.
+// The binning does not touch opengl so it can run (and be benchmarked) without a context, Upload and Bind do.
+// Shader side (see tiled_phong_frag.glsl):
+//     uTileGrid          usamplerBuffer, per tile (offset, count) into uTileLightIndices
+//     uTileLightIndices  usamplerBuffer, light indices
+//     uTileLights        samplerBuffer, 6 texels per light: (position, radius) (ambient, constant) (diffuse, linear)
+//                        (specular, quadratic) (direction, innerCutoff) (outerCutoff, isSpot, 0, 0)
+//     uSpotAmbient       vec3, ambient of all spot lights, it reaches every fragment and is not part of the tiles
+class TiledLightCulling {
+public:
+    // Texels per light in uTileLights
+    static constexpr int LIGHT_TEXELS = 6;
+    /// <summary>Creates the culling state, no opengl objects are created until Upload</summary>
+    /// <param name="tileSize">Width and height of the tiles in pixels (16 or 32)</param>
+    explicit TiledLightCulling(int tileSize = 16)
+        : m_TileSize(tileSize) {
+    }
+    ~TiledLightCulling() {
+        if (m_Buffers[0] != 0) {
+            glDeleteTextures(3, m_Textures);
+            glDeleteBuffers(3, m_Buffers);
+        }
+    }
+    TiledLightCulling(const TiledLightCulling&) = delete;
+    TiledLightCulling& operator=(const TiledLightCulling&) = delete;
+    /// <summary>Bins the lights into the tiles of a screen, the results are kept until the next call</summary>
+    /// <param name="view">The camera's view matrix</param>
+    /// <param name="proj">The (symmetric perspective) projection matrix</param>
+    /// <param name="near">The near plane distance used by proj</param>
+    /// <param name="far">The far plane distance used by proj</param>
+    /// <param name="width">Screen width in pixels</param>
+    /// <param name="height">Screen height in pixels</param>
+    /// <param name="spotLights">Spot lights, indexed after the point lights</param>
+    /// <param name="jobSystem">Optional job system to bin the rows of tiles in parallel</param>
+    void Bin(const glm::mat4& view, const glm::mat4& proj, float near, float far, int width, int height,
+        const phong::PointLight* pointLights, size_t pointCount, const phong::SpotLight* spotLights, size_t spotCount, JobSystem* jobSystem = nullptr) {
+        m_TilesX = (width + m_TileSize - 1) / m_TileSize;
+        m_TilesY = (height + m_TileSize - 1) / m_TileSize;
+        size_t count = pointCount + spotCount;
+        // Padded so simd loops never need a scalar tail
+        size_t padded = (count + 3) & ~size_t(3);
+        for (std::vector<float>* v : { &m_CenterX, &m_CenterY, &m_CenterZ, &m_Radius }) {
+            v->resize(padded);
+        }
+        for (std::vector<int32_t>* v : { &m_MinX, &m_MaxX, &m_MinY, &m_MaxY }) {
+            v->resize(padded);
+        }
+        for (size_t i = 0; i < pointCount; i++) {
+            StoreSphere(i, view, pointLights[i].position, pointLights[i].InfluenceRadius());
+        }
+        for (size_t i = 0; i < spotCount; i++) {
+            glm::vec3 center;
+            float radius = SpotBoundingSphere(spotLights[i], center);
+            StoreSphere(pointCount + i, view, center, radius);
+        }
+        // Padding lights have an empty sphere that projects to an empty rectangle
+        for (size_t i = count; i < padded; i++) {
+            StoreSphere(i, view, glm::vec3(0.f), -1.f);
+        }
+        ProjectRects(proj, near, far, (float)width, (float)height, padded);
+        ComputeTilePlanes(proj, (float)width, (float)height);
+        // Binning each row of tiles on its own
+        m_Rows.resize(m_TilesY);
+        auto binRows = [&](size_t begin, size_t end) {
+            for (size_t y = begin; y < end; y++) {
+                BinRow((int)y, padded, m_Rows[y]);
+            }
+        };
+        if (jobSystem != nullptr) {
+            jobSystem->ParallelFor(m_TilesY, 1, binRows);
+        }
+        else {
+            binRows(0, m_TilesY);
+        }
+        // Flattening the lists of the rows
+        size_t indexCount = 0;
+        for (const Row& row : m_Rows) {
+            indexCount += row.offsets.back();
+        }
+        m_Grid.resize((size_t)m_TilesX * m_TilesY * 2);
+        m_Indices.resize(indexCount);
+        uint32_t offset = 0;
+        for (int y = 0; y < m_TilesY; y++) {
+            const Row& row = m_Rows[y];
+            for (int x = 0; x < m_TilesX; x++) {
+                size_t tile = (size_t)y * m_TilesX + x;
+                m_Grid[tile * 2] = offset + row.offsets[x];
+                m_Grid[tile * 2 + 1] = row.offsets[x + 1] - row.offsets[x];
+            }
+            std::copy(row.indices.begin(), row.indices.begin() + row.offsets.back(), m_Indices.begin() + offset);
+            offset += row.offsets.back();
+        }
+        PackLights(pointLights, pointCount, spotLights, spotCount);
+    }
+    // Uploads the results of the last Bin to the texture buffers
+    void Upload() {
+        if (m_Buffers[0] == 0) {
+            static constexpr GLenum FORMATS[3] = { GL_RG32UI, GL_R32UI, GL_RGBA32F };
+            glGenBuffers(3, m_Buffers);
+            glGenTextures(3, m_Textures);
+            for (int i = 0; i < 3; i++) {
+                glBindBuffer(GL_TEXTURE_BUFFER, m_Buffers[i]);
+                glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW);
+                glBindTexture(GL_TEXTURE_BUFFER, m_Textures[i]);
+                glTexBuffer(GL_TEXTURE_BUFFER, FORMATS[i], m_Buffers[i]);
+            }
+        }
+        UploadBuffer(m_Buffers[0], m_Grid.data(), m_Grid.size() * sizeof(uint32_t));
+        UploadBuffer(m_Buffers[1], m_Indices.data(), m_Indices.size() * sizeof(uint32_t));
+        UploadBuffer(m_Buffers[2], m_LightData.data(), m_LightData.size() * sizeof(glm::vec4));
+    }
+    // Binds the tile textures to three texture units starting at firstUnit and sets the shader's tile uniforms
+    void Bind(const Shader& shader, unsigned int firstUnit) const {
+        static const char* const SAMPLERS[3] = { "uTileGrid", "uTileLightIndices", "uTileLights" };
+        for (int i = 0; i < 3; i++) {
+            glActiveTexture(GL_TEXTURE0 + firstUnit + i);
+            glBindTexture(GL_TEXTURE_BUFFER, m_Textures[i]);
+            shader.SetInt(SAMPLERS[i], firstUnit + i);
+        }
+        shader.SetInt("uTileSize", m_TileSize);
+        shader.SetInt("uTilesX", m_TilesX);
+        shader.SetFloat3("uSpotAmbient", m_SpotAmbient);
+    }
+    int GetTilesX() const {
+        return m_TilesX;
+    }
+    int GetTilesY() const {
+        return m_TilesY;
+    }
+    // Number of light indices in all tiles of the last Bin
+    size_t GetIndexCount() const {
+        return m_Indices.size();
+    }
+    // The lights binned into a tile by the last Bin, points first then spots
+    const uint32_t* GetTileLights(int x, int y, uint32_t& count) const {
+        size_t tile = (size_t)y * m_TilesX + x;
+        count = m_Grid[tile * 2 + 1];
+        return m_Indices.data() + m_Grid[tile * 2];
+    }
+    // The smallest sphere around the spot light's cone, returns the radius
+    static float SpotBoundingSphere(const phong::SpotLight& light, glm::vec3& center) {
+        float range = light.InfluenceRadius();
+        if (!std::isfinite(range)) {
+            center = light.position;
+            return range;
+        }
+        float cosAngle = light.outerCutoff;
+        glm::vec3 direction = glm::normalize(light.direction);
+        // Wide cones are bounded by the sphere through the rim of their base, narrow ones by the one through apex and rim
+        if (cosAngle < 0.70710678f) {
+            center = light.position + direction * range * cosAngle;
+            return range * std::sqrt(1.f - cosAngle * cosAngle);
+        }
+        float radius = range / (2.f * cosAngle);
+        center = light.position + direction * radius;
+        return radius;
+    }
+private:
+    // The binning results of one row of tiles
+    struct Row {
+        // Lights overlapping the row, with their tile column ranges and spheres copied next to each other for simd
+        std::vector<uint32_t> lights;
+        std::vector<int32_t> minX;
+        std::vector<int32_t> maxX;
+        std::vector<float> centerX;
+        std::vector<float> centerZ;
+        std::vector<float> radius;
+        // offsets[x] to offsets[x + 1] are the lights of tile x in indices
+        std::vector<uint32_t> offsets;
+        std::vector<uint32_t> indices;
+    };
+    void StoreSphere(size_t i, const glm::mat4& view, const glm::vec3& position, float radius) {
+        glm::vec3 center = glm::vec3(view * glm::vec4(position, 1.f));
+        m_CenterX[i] = center.x;
+        m_CenterY[i] = center.y;
+        m_CenterZ[i] = center.z;
+        m_Radius[i] = radius;
+    }
+    // The side planes of the tiles' frusta, all through the eye: a column of tiles is bounded by planes containing the
+    // view space y axis, a row by planes containing the x axis, so each plane only has two non zero components.
+    // Stored as (left x, left z, right x, right z) per column and (bottom y, bottom z, top y, top z) per row with unit
+    // normals pointing into the tiles, a sphere misses a tile when it is further than its radius behind one of them.
+    void ComputeTilePlanes(const glm::mat4& proj, float width, float height) {
+        auto planes = [](std::vector<float>& out, int count, float p, float ndcPerTile) {
+            out.resize((size_t)count * 4);
+            for (int i = 0; i < count; i++) {
+                // A view space point is at ndc p * x / -z, so the boundary at ndc a is the plane p * x + a * z = 0
+                float low = i * ndcPerTile - 1.f, high = (i + 1) * ndcPerTile - 1.f;
+                float lowLength = std::sqrt(p * p + low * low), highLength = std::sqrt(p * p + high * high);
+                out[i * 4] = p / lowLength;
+                out[i * 4 + 1] = low / lowLength;
+                out[i * 4 + 2] = -p / highLength;
+                out[i * 4 + 3] = -high / highLength;
+            }
+        };
+        planes(m_ColumnPlanes, m_TilesX, proj[0][0], 2.f * m_TileSize / width);
+        planes(m_RowPlanes, m_TilesY, proj[1][1], 2.f * m_TileSize / height);
+    }
+    // Projects every sphere to a conservative range of tiles, empty (min > max) when the sphere cannot be seen
+    void ProjectRects(const glm::mat4& proj, float near, float far, float width, float height, size_t count) {
+        const float px = proj[0][0], py = proj[1][1];
+        const float lastX = (float)(m_TilesX - 1), lastY = (float)(m_TilesY - 1);
+        const float toTileX = .5f * width / m_TileSize, toTileY = .5f * height / m_TileSize;
+        size_t i = 0;
+#ifdef TILED_LIGHT_CULLING_SSE
+        const __m128 nearV = _mm_set1_ps(near), farV = _mm_set1_ps(far);
+        const __m128 pxV = _mm_set1_ps(px), pyV = _mm_set1_ps(py);
+        const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.f), minusOne = _mm_set1_ps(-1.f);
+        const __m128 lastXV = _mm_set1_ps(lastX), lastYV = _mm_set1_ps(lastY);
+        const __m128 toTileXV = _mm_set1_ps(toTileX), toTileYV = _mm_set1_ps(toTileY);
+        for (; i + 4 <= count; i += 4) {
+            __m128 cx = _mm_loadu_ps(&m_CenterX[i]);
+            __m128 cy = _mm_loadu_ps(&m_CenterY[i]);
+            __m128 depth = _mm_sub_ps(zero, _mm_loadu_ps(&m_CenterZ[i]));
+            __m128 r = _mm_loadu_ps(&m_Radius[i]);
+            __m128 closest = _mm_sub_ps(depth, r);
+            __m128 farthest = _mm_add_ps(depth, r);
+            // In front of the near plane, not past the far plane and not an empty padding sphere
+            __m128 visible = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(farthest, nearV), _mm_cmple_ps(closest, farV)), _mm_cmpge_ps(r, zero));
+            __m128 invClosest = _mm_div_ps(one, _mm_max_ps(closest, nearV));
+            __m128 invFarthest = _mm_div_ps(one, _mm_min_ps(farthest, farV));
+            // x * p / depth is monotonic in x and depth once the depth is positive, the extremes are at the corners
+            __m128 lowX = _mm_mul_ps(_mm_sub_ps(cx, r), pxV), highX = _mm_mul_ps(_mm_add_ps(cx, r), pxV);
+            __m128 lowY = _mm_mul_ps(_mm_sub_ps(cy, r), pyV), highY = _mm_mul_ps(_mm_add_ps(cy, r), pyV);
+            __m128 ndcMinX = _mm_min_ps(_mm_mul_ps(lowX, invClosest), _mm_mul_ps(lowX, invFarthest));
+            __m128 ndcMaxX = _mm_max_ps(_mm_mul_ps(highX, invClosest), _mm_mul_ps(highX, invFarthest));
+            __m128 ndcMinY = _mm_min_ps(_mm_mul_ps(lowY, invClosest), _mm_mul_ps(lowY, invFarthest));
+            __m128 ndcMaxY = _mm_max_ps(_mm_mul_ps(highY, invClosest), _mm_mul_ps(highY, invFarthest));
+            visible = _mm_and_ps(visible, _mm_and_ps(_mm_cmpge_ps(ndcMaxX, minusOne), _mm_cmple_ps(ndcMinX, one)));
+            visible = _mm_and_ps(visible, _mm_and_ps(_mm_cmpge_ps(ndcMaxY, minusOne), _mm_cmple_ps(ndcMinY, one)));
+            // From ndc to tile coordinates, clamped to the screen (truncation equals floor after clamping to >= 0)
+            __m128 minX = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_add_ps(ndcMinX, one), toTileXV), zero), lastXV);
+            __m128 maxX = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_add_ps(ndcMaxX, one), toTileXV), zero), lastXV);
+            __m128 minY = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_add_ps(ndcMinY, one), toTileYV), zero), lastYV);
+            __m128 maxY = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_add_ps(ndcMaxY, one), toTileYV), zero), lastYV);
+            // Invisible lights get the empty range [1, -1]
+            __m128i visibleI = _mm_castps_si128(visible);
+            __m128i emptyMin = _mm_andnot_si128(visibleI, _mm_set1_epi32(1));
+            __m128i emptyMax = _mm_andnot_si128(visibleI, _mm_set1_epi32(-1));
+            _mm_storeu_si128((__m128i*)&m_MinX[i], _mm_or_si128(_mm_and_si128(visibleI, _mm_cvttps_epi32(minX)), emptyMin));
+            _mm_storeu_si128((__m128i*)&m_MaxX[i], _mm_or_si128(_mm_and_si128(visibleI, _mm_cvttps_epi32(maxX)), emptyMax));
+            _mm_storeu_si128((__m128i*)&m_MinY[i], _mm_or_si128(_mm_and_si128(visibleI, _mm_cvttps_epi32(minY)), emptyMin));
+            _mm_storeu_si128((__m128i*)&m_MaxY[i], _mm_or_si128(_mm_and_si128(visibleI, _mm_cvttps_epi32(maxY)), emptyMax));
+        }
+#endif
+        for (; i < count; i++) {
+            float depth = -m_CenterZ[i], r = m_Radius[i];
+            float closest = depth - r, farthest = depth + r;
+            m_MinX[i] = m_MinY[i] = 1;
+            m_MaxX[i] = m_MaxY[i] = -1;
+            if (farthest < near || closest > far || r < 0.f) {
+                continue;
+            }
+            float invClosest = 1.f / std::max(closest, near), invFarthest = 1.f / std::min(farthest, far);
+            float lowX = (m_CenterX[i] - r) * px, highX = (m_CenterX[i] + r) * px;
+            float lowY = (m_CenterY[i] - r) * py, highY = (m_CenterY[i] + r) * py;
+            float ndcMinX = std::min(lowX * invClosest, lowX * invFarthest), ndcMaxX = std::max(highX * invClosest, highX * invFarthest);
+            float ndcMinY = std::min(lowY * invClosest, lowY * invFarthest), ndcMaxY = std::max(highY * invClosest, highY * invFarthest);
+            if (ndcMaxX < -1.f || ndcMinX > 1.f || ndcMaxY < -1.f || ndcMinY > 1.f) {
+                continue;
+            }
+            m_MinX[i] = (int32_t)std::clamp((ndcMinX + 1.f) * toTileX, 0.f, lastX);
+            m_MaxX[i] = (int32_t)std::clamp((ndcMaxX + 1.f) * toTileX, 0.f, lastX);
+            m_MinY[i] = (int32_t)std::clamp((ndcMinY + 1.f) * toTileY, 0.f, lastY);
+            m_MaxY[i] = (int32_t)std::clamp((ndcMaxY + 1.f) * toTileY, 0.f, lastY);
+        }
+    }
+    // Finds the lights overlapping row y, then the lights of each of its tiles
+    void BinRow(int y, size_t count, Row& row) const {
+        row.lights.clear();
+        row.minX.clear();
+        row.maxX.clear();
+        row.centerX.clear();
+        row.centerZ.clear();
+        row.radius.clear();
+        row.indices.clear();
+        row.offsets.assign(m_TilesX + 1, 0);
+        const float bottomY = m_RowPlanes[y * 4], bottomZ = m_RowPlanes[y * 4 + 1];
+        const float topY = m_RowPlanes[y * 4 + 2], topZ = m_RowPlanes[y * 4 + 3];
+        size_t i = 0;
+#ifdef TILED_LIGHT_CULLING_SSE
+        const __m128i yV = _mm_set1_epi32(y);
+        const __m128 bottomYV = _mm_set1_ps(bottomY), bottomZV = _mm_set1_ps(bottomZ);
+        const __m128 topYV = _mm_set1_ps(topY), topZV = _mm_set1_ps(topZ);
+        for (; i + 4 <= count; i += 4) {
+            __m128i minY = _mm_loadu_si128((const __m128i*)&m_MinY[i]);
+            __m128i maxY = _mm_loadu_si128((const __m128i*)&m_MaxY[i]);
+            // minY <= y <= maxY
+            __m128i inside = _mm_andnot_si128(_mm_or_si128(_mm_cmpgt_epi32(minY, yV), _mm_cmplt_epi32(maxY, yV)), _mm_set1_epi32(-1));
+            __m128 cy = _mm_loadu_ps(&m_CenterY[i]);
+            __m128 cz = _mm_loadu_ps(&m_CenterZ[i]);
+            __m128 minusR = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&m_Radius[i]));
+            __m128 reaches = _mm_and_ps(_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(bottomYV, cy), _mm_mul_ps(bottomZV, cz)), minusR),
+                _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(topYV, cy), _mm_mul_ps(topZV, cz)), minusR));
+            inside = _mm_and_si128(inside, _mm_castps_si128(reaches));
+            for (int mask = _mm_movemask_ps(_mm_castsi128_ps(inside)); mask != 0; mask &= mask - 1) {
+                AddRowLight(row, i + std::countr_zero((unsigned)mask));
+            }
+        }
+#endif
+        for (; i < count; i++) {
+            if (m_MinY[i] <= y && y <= m_MaxY[i] && bottomY * m_CenterY[i] + bottomZ * m_CenterZ[i] >= -m_Radius[i]
+                && topY * m_CenterY[i] + topZ * m_CenterZ[i] >= -m_Radius[i]) {
+                AddRowLight(row, i);
+            }
+        }
+        // Padding the row's ranges with empty ones
+        size_t rowCount = row.lights.size();
+        while (row.minX.size() % 4 != 0) {
+            row.minX.push_back(1);
+            row.maxX.push_back(-1);
+            row.centerX.push_back(0.f);
+            row.centerZ.push_back(0.f);
+            row.radius.push_back(0.f);
+        }
+        // Every row light lands in the tiles of its column range, which bounds the size of the lists
+        size_t total = 0;
+        for (size_t j = 0; j < rowCount; j++) {
+            total += row.maxX[j] - row.minX[j] + 1;
+        }
+        row.indices.resize(total);
+        uint32_t* out = row.indices.data();
+        for (int x = 0; x < m_TilesX; x++) {
+            const float leftX = m_ColumnPlanes[x * 4], leftZ = m_ColumnPlanes[x * 4 + 1];
+            const float rightX = m_ColumnPlanes[x * 4 + 2], rightZ = m_ColumnPlanes[x * 4 + 3];
+            size_t j = 0;
+#ifdef TILED_LIGHT_CULLING_SSE
+            const __m128i xV = _mm_set1_epi32(x);
+            const __m128 leftXV = _mm_set1_ps(leftX), leftZV = _mm_set1_ps(leftZ);
+            const __m128 rightXV = _mm_set1_ps(rightX), rightZV = _mm_set1_ps(rightZ);
+            for (; j + 4 <= row.minX.size(); j += 4) {
+                __m128i minX = _mm_loadu_si128((const __m128i*)&row.minX[j]);
+                __m128i maxX = _mm_loadu_si128((const __m128i*)&row.maxX[j]);
+                __m128i inside = _mm_andnot_si128(_mm_or_si128(_mm_cmpgt_epi32(minX, xV), _mm_cmplt_epi32(maxX, xV)), _mm_set1_epi32(-1));
+                __m128 cx = _mm_loadu_ps(&row.centerX[j]);
+                __m128 cz = _mm_loadu_ps(&row.centerZ[j]);
+                __m128 minusR = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&row.radius[j]));
+                __m128 reaches = _mm_and_ps(_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(leftXV, cx), _mm_mul_ps(leftZV, cz)), minusR),
+                    _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(rightXV, cx), _mm_mul_ps(rightZV, cz)), minusR));
+                inside = _mm_and_si128(inside, _mm_castps_si128(reaches));
+                for (int mask = _mm_movemask_ps(_mm_castsi128_ps(inside)); mask != 0; mask &= mask - 1) {
+                    *out++ = row.lights[j + std::countr_zero((unsigned)mask)];
+                }
+            }
+#endif
+            for (; j < rowCount; j++) {
+                if (row.minX[j] <= x && x <= row.maxX[j] && leftX * row.centerX[j] + leftZ * row.centerZ[j] >= -row.radius[j]
+                    && rightX * row.centerX[j] + rightZ * row.centerZ[j] >= -row.radius[j]) {
+                    *out++ = row.lights[j];
+                }
+            }
+            row.offsets[x + 1] = (uint32_t)(out - row.indices.data());
+        }
+    }
+    void AddRowLight(Row& row, size_t light) const {
+        row.lights.push_back((uint32_t)light);
+        row.minX.push_back(m_MinX[light]);
+        row.maxX.push_back(m_MaxX[light]);
+        row.centerX.push_back(m_CenterX[light]);
+        row.centerZ.push_back(m_CenterZ[light]);
+        row.radius.push_back(m_Radius[light]);
+    }
+    void PackLights(const phong::PointLight* pointLights, size_t pointCount, const phong::SpotLight* spotLights, size_t spotCount) {
+        m_LightData.resize((pointCount + spotCount) * LIGHT_TEXELS);
+        m_SpotAmbient = glm::vec3(0.f);
+        glm::vec4* data = m_LightData.data();
+        for (size_t i = 0; i < pointCount; i++) {
+            const phong::PointLight& light = pointLights[i];
+            *data++ = glm::vec4(light.position, m_Radius[i]);
+            *data++ = glm::vec4(light.ambient, light.constant);
+            *data++ = glm::vec4(light.diffuse, light.linear);
+            *data++ = glm::vec4(light.specular, light.quadratic);
+            *data++ = glm::vec4(0.f);
+            *data++ = glm::vec4(0.f);
+        }
+        for (size_t i = 0; i < spotCount; i++) {
+            const phong::SpotLight& light = spotLights[i];
+            m_SpotAmbient += light.ambient;
+            *data++ = glm::vec4(light.position, light.InfluenceRadius());
+            *data++ = glm::vec4(light.ambient, light.constant);
+            *data++ = glm::vec4(light.diffuse, light.linear);
+            *data++ = glm::vec4(light.specular, light.quadratic);
+            *data++ = glm::vec4(light.direction, light.innerCutoff);
+            *data++ = glm::vec4(light.outerCutoff, 1.f, 0.f, 0.f);
+        }
+    }
+    // Replaces the contents of a buffer, orphaning the old storage so the gpu can keep reading it
+    static void UploadBuffer(GLuint buffer, const void* data, size_t size) {
+        glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+        glBufferData(GL_TEXTURE_BUFFER, std::max<size_t>(size, 16), nullptr, GL_STREAM_DRAW);
+        if (size > 0) {
+            glBufferSubData(GL_TEXTURE_BUFFER, 0, size, data);
+        }
+    }
+private:
+    int m_TileSize{};
+    int m_TilesX{}, m_TilesY{};
+    // View space bounding spheres and their tile ranges, one entry per light
+    std::vector<float> m_CenterX, m_CenterY, m_CenterZ, m_Radius;
+    std::vector<int32_t> m_MinX, m_MaxX, m_MinY, m_MaxY;
+    // Side planes of the tiles, see ComputeTilePlanes
+    std::vector<float> m_ColumnPlanes, m_RowPlanes;
+    glm::vec3 m_SpotAmbient{ 0.f };
+    std::vector<Row> m_Rows;
+    std::vector<uint32_t> m_Grid;
+    std::vector<uint32_t> m_Indices;
+    std::vector<glm::vec4> m_LightData;
+    GLuint m_Buffers[3]{};
+    GLuint m_Textures[3]{};
+};
@@ -0,0 +1,192 @@
+#pragma once
+
+#include <JobSystem.hpp>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <cstddef>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define TRANSFORM_STORAGE_SSE
+#include <xmmintrin.h>
+#endif
+
+// The transform storage class
+// Keeps the positions, rotations and scales of many objects as separate arrays per component (structure of arrays)
+// so the model matrices of all of them can be built four at a time with simd
+class TransformStorage {
+public:
+    // Adds a transform and returns its index
+    size_t Add(const glm::vec3& position, const glm::quat& rotation = glm::quat(1.f, 0.f, 0.f, 0.f), const glm::vec3& scale = glm::vec3(1.f)) {
+        for (int i = 0; i < 3; i++) {
+            m_Position[i].push_back(position[i]);
+            m_Scale[i].push_back(scale[i]);
+        }
+        m_Rotation[0].push_back(rotation.x);
+        m_Rotation[1].push_back(rotation.y);
+        m_Rotation[2].push_back(rotation.z);
+        m_Rotation[3].push_back(rotation.w);
+        return Size() - 1;
+    }
+    // Inserts a transform so it ends up at index, the transforms from index onwards move up by one
+    void Insert(size_t index, const glm::vec3& position, const glm::quat& rotation = glm::quat(1.f, 0.f, 0.f, 0.f), const glm::vec3& scale = glm::vec3(1.f)) {
+        for (int i = 0; i < 3; i++) {
+            m_Position[i].insert(m_Position[i].begin() + index, position[i]);
+            m_Scale[i].insert(m_Scale[i].begin() + index, scale[i]);
+        }
+        const float components[4] = { rotation.x, rotation.y, rotation.z, rotation.w };
+        for (int i = 0; i < 4; i++) {
+            m_Rotation[i].insert(m_Rotation[i].begin() + index, components[i]);
+        }
+    }
+    // Removes the transforms in [begin, end), the ones after them move down
+    void Erase(size_t begin, size_t end) {
+        for (int i = 0; i < 3; i++) {
+            m_Position[i].erase(m_Position[i].begin() + begin, m_Position[i].begin() + end);
+            m_Scale[i].erase(m_Scale[i].begin() + begin, m_Scale[i].begin() + end);
+        }
+        for (int i = 0; i < 4; i++) {
+            m_Rotation[i].erase(m_Rotation[i].begin() + begin, m_Rotation[i].begin() + end);
+        }
+    }
+    void Reserve(size_t capacity) {
+        for (int i = 0; i < 3; i++) {
+            m_Position[i].reserve(capacity);
+            m_Scale[i].reserve(capacity);
+        }
+        for (int i = 0; i < 4; i++) {
+            m_Rotation[i].reserve(capacity);
+        }
+    }
+    void Clear() {
+        for (int i = 0; i < 3; i++) {
+            m_Position[i].clear();
+            m_Scale[i].clear();
+        }
+        for (int i = 0; i < 4; i++) {
+            m_Rotation[i].clear();
+        }
+    }
+    // Number of transforms stored
+    size_t Size() const {
+        return m_Position[0].size();
+    }
+    glm::vec3 GetPosition(size_t index) const {
+        return { m_Position[0][index], m_Position[1][index], m_Position[2][index] };
+    }
+    void SetPosition(size_t index, const glm::vec3& position) {
+        for (int i = 0; i < 3; i++) {
+            m_Position[i][index] = position[i];
+        }
+    }
+    glm::quat GetRotation(size_t index) const {
+        return glm::quat(m_Rotation[3][index], m_Rotation[0][index], m_Rotation[1][index], m_Rotation[2][index]);
+    }
+    // Sets the rotation, the quaternion is expected to be normalized
+    void SetRotation(size_t index, const glm::quat& rotation) {
+        m_Rotation[0][index] = rotation.x;
+        m_Rotation[1][index] = rotation.y;
+        m_Rotation[2][index] = rotation.z;
+        m_Rotation[3][index] = rotation.w;
+    }
+    glm::vec3 GetScale(size_t index) const {
+        return { m_Scale[0][index], m_Scale[1][index], m_Scale[2][index] };
+    }
+    void SetScale(size_t index, const glm::vec3& scale) {
+        for (int i = 0; i < 3; i++) {
+            m_Scale[i][index] = scale[i];
+        }
+    }
+    /// <summary>Builds translate * rotate * scale model matrices for the transforms in [begin, end)</summary>
+    /// <param name="out">Receives the matrices, out[i] is the matrix of transform i</param>
+    void BuildModelMatrices(glm::mat4* out, size_t begin, size_t end) const {
+        size_t i = begin;
+#ifdef TRANSFORM_STORAGE_SSE
+        for (; i + 4 <= end; i += 4) {
+            BuildModelMatrices4(out + i, i);
+        }
+#endif
+        for (; i < end; i++) {
+            out[i] = BuildModelMatrix(i);
+        }
+    }
+    // Builds the model matrices of every transform
+    void BuildModelMatrices(glm::mat4* out) const {
+        BuildModelMatrices(out, 0, Size());
+    }
+    // Builds the model matrices of every transform in parallel chunks of grainSize transforms
+    void BuildModelMatrices(glm::mat4* out, JobSystem& jobSystem, size_t grainSize = 4096) const {
+        jobSystem.ParallelFor(Size(), grainSize, [this, out](size_t begin, size_t end) {
+            BuildModelMatrices(out, begin, end);
+        });
+    }
+    // Builds the model matrix of a single transform
+    glm::mat4 BuildModelMatrix(size_t index) const {
+        float x = m_Rotation[0][index], y = m_Rotation[1][index], z = m_Rotation[2][index], w = m_Rotation[3][index];
+        float sx = m_Scale[0][index], sy = m_Scale[1][index], sz = m_Scale[2][index];
+        glm::mat4 m;
+        m[0] = glm::vec4(1.f - 2.f * (y * y + z * z), 2.f * (x * y + w * z), 2.f * (x * z - w * y), 0.f) * sx;
+        m[1] = glm::vec4(2.f * (x * y - w * z), 1.f - 2.f * (x * x + z * z), 2.f * (y * z + w * x), 0.f) * sy;
+        m[2] = glm::vec4(2.f * (x * z + w * y), 2.f * (y * z - w * x), 1.f - 2.f * (x * x + y * y), 0.f) * sz;
+        m[3] = glm::vec4(m_Position[0][index], m_Position[1][index], m_Position[2][index], 1.f);
+        return m;
+    }
+private:
+#ifdef TRANSFORM_STORAGE_SSE
+    // Builds the matrices of four consecutive transforms, each sse lane handles one transform
+    void BuildModelMatrices4(glm::mat4* out, size_t index) const {
+        const __m128 one = _mm_set1_ps(1.f);
+        const __m128 two = _mm_set1_ps(2.f);
+        __m128 x = _mm_loadu_ps(&m_Rotation[0][index]);
+        __m128 y = _mm_loadu_ps(&m_Rotation[1][index]);
+        __m128 z = _mm_loadu_ps(&m_Rotation[2][index]);
+        __m128 w = _mm_loadu_ps(&m_Rotation[3][index]);
+        __m128 sx = _mm_loadu_ps(&m_Scale[0][index]);
+        __m128 sy = _mm_loadu_ps(&m_Scale[1][index]);
+        __m128 sz = _mm_loadu_ps(&m_Scale[2][index]);
+        __m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+        __m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+        __m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+        // Rows of each column, one transform per lane
+        __m128 c0[4] = {
+            _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), sx),
+            _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), sx),
+            _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), sx),
+            _mm_setzero_ps(),
+        };
+        __m128 c1[4] = {
+            _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), sy),
+            _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), sy),
+            _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), sy),
+            _mm_setzero_ps(),
+        };
+        __m128 c2[4] = {
+            _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), sz),
+            _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), sz),
+            _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), sz),
+            _mm_setzero_ps(),
+        };
+        __m128 c3[4] = {
+            _mm_loadu_ps(&m_Position[0][index]),
+            _mm_loadu_ps(&m_Position[1][index]),
+            _mm_loadu_ps(&m_Position[2][index]),
+            one,
+        };
+        // Transposing turns the lanes into columns of the four matrices
+        __m128* columns[4] = { c0, c1, c2, c3 };
+        for (int c = 0; c < 4; c++) {
+            __m128* v = columns[c];
+            _MM_TRANSPOSE4_PS(v[0], v[1], v[2], v[3]);
+            for (int m = 0; m < 4; m++) {
+                _mm_storeu_ps(&out[m][c][0], v[m]);
+            }
+        }
+    }
+#endif
+private:
+    std::vector<float> m_Position[3];
+    // Quaternion components in x, y, z, w order
+    std::vector<float> m_Rotation[4];
+    std::vector<float> m_Scale[3];
+};
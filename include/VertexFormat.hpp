@@ -0,0 +1,162 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+// The vertex format class
+// Describes the attributes of one interleaved vertex buffer, each with its own component type, so vertices can be
+// stored as half floats or normalized integers instead of 32 bit floats. Pack converts float values into an
+// attribute's type and Apply points the bound vertex array at the buffer with the matching glVertexAttribPointer.
+// Normalized integers are read by the shader as floats in [0, 1] (unsigned) or [-1, 1] (signed).
+class VertexFormat {
+public:
+    struct Attribute {
+        GLuint location;
+        GLint components;
+        GLenum type;
+        bool normalized;
+        uint32_t offset;
+    };
+    /// <summary>Appends an attribute after the previous one</summary>
+    /// <param name="type">GL_FLOAT, GL_HALF_FLOAT or an 8 or 16 bit integer type</param>
+    VertexFormat& Add(GLuint location, GLint components, GLenum type, bool normalized = false) {
+        m_Attributes.push_back({ location, components, type, normalized, m_Stride });
+        // Attributes start 4 byte aligned, some drivers fall back to a slow path otherwise
+        m_Stride = Align(m_Stride + components * GetTypeSize(type));
+        return *this;
+    }
+    // Sets up the bound vertex array for the bound array buffer, baseOffset is where the vertices start in it
+    void Apply(size_t baseOffset = 0) const {
+        for (const Attribute& attribute : m_Attributes) {
+            glVertexAttribPointer(attribute.location, attribute.components, attribute.type, attribute.normalized ? GL_TRUE : GL_FALSE,
+                (GLsizei)m_Stride, reinterpret_cast<const void*>(baseOffset + attribute.offset));
+            glEnableVertexAttribArray(attribute.location);
+        }
+    }
+    /// <summary>Writes one attribute of one vertex into a buffer laid out with this format</summary>
+    /// <param name="values">One float per component, normalized attributes clamp them to their range</param>
+    void Pack(void* vertices, size_t vertex, size_t attribute, const float* values) const {
+        const Attribute& description = m_Attributes[attribute];
+        char* destination = static_cast<char*>(vertices) + vertex * m_Stride + description.offset;
+        for (GLint i = 0; i < description.components; i++) {
+            PackComponent(destination + i * GetTypeSize(description.type), description.type, description.normalized, values[i]);
+        }
+    }
+    uint32_t GetStride() const {
+        return m_Stride;
+    }
+    const std::vector<Attribute>& GetAttributes() const {
+        return m_Attributes;
+    }
+    static uint32_t GetTypeSize(GLenum type) {
+        switch (type) {
+        case GL_FLOAT:
+        case GL_INT:
+        case GL_UNSIGNED_INT:
+            return 4;
+        case GL_HALF_FLOAT:
+        case GL_SHORT:
+        case GL_UNSIGNED_SHORT:
+            return 2;
+        case GL_BYTE:
+        case GL_UNSIGNED_BYTE:
+            return 1;
+        }
+        fprintf(stderr, "unsupported vertex attribute type 0x%x\n", type);
+        return 4;
+    }
+private:
+    static void PackComponent(char* destination, GLenum type, bool normalized, float value) {
+        switch (type) {
+        case GL_FLOAT:
+            memcpy(destination, &value, 4);
+            break;
+        case GL_HALF_FLOAT: {
+            uint16_t half = glm::packHalf1x16(value);
+            memcpy(destination, &half, 2);
+            break;
+        }
+        case GL_UNSIGNED_SHORT: {
+            uint16_t packed = normalized ? glm::packUnorm1x16(value) : (uint16_t)value;
+            memcpy(destination, &packed, 2);
+            break;
+        }
+        case GL_SHORT: {
+            int16_t packed = normalized ? (int16_t)glm::packSnorm1x16(value) : (int16_t)value;
+            memcpy(destination, &packed, 2);
+            break;
+        }
+        case GL_UNSIGNED_BYTE:
+            *reinterpret_cast<uint8_t*>(destination) = normalized ? (uint8_t)std::round(glm::clamp(value, 0.f, 1.f) * 255.f) : (uint8_t)value;
+            break;
+        case GL_BYTE:
+            *reinterpret_cast<int8_t*>(destination) = normalized ? (int8_t)std::round(glm::clamp(value, -1.f, 1.f) * 127.f) : (int8_t)value;
+            break;
+        case GL_INT:
+        case GL_UNSIGNED_INT: {
+            uint32_t packed = type == GL_INT ? (uint32_t)(int32_t)value : (uint32_t)value;
+            memcpy(destination, &packed, 4);
+            break;
+        }
+        }
+    }
+    static uint32_t Align(uint32_t offset) {
+        return (offset + 3u) & ~3u;
+    }
+private:
+    std::vector<Attribute> m_Attributes;
+    uint32_t m_Stride{};
+};
+
+// Encodings that map attributes into the range of normalized integers
+namespace vertexcompression {
+    // Folds the unit sphere onto an octahedron and unfolds it to [-1, 1]^2, read back with OctahedralDecode in glsl
+    inline glm::vec2 OctahedralEncode(glm::vec3 normal) {
+        normal /= std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+        glm::vec2 encoded{ normal.x, normal.y };
+        if (normal.z < 0.f) {
+            encoded = glm::vec2((1.f - std::abs(normal.y)) * (normal.x >= 0.f ? 1.f : -1.f), (1.f - std::abs(normal.x)) * (normal.y >= 0.f ? 1.f : -1.f));
+        }
+        return encoded;
+    }
+    inline glm::vec3 OctahedralDecode(glm::vec2 encoded) {
+        glm::vec3 normal{ encoded.x, encoded.y, 1.f - std::abs(encoded.x) - std::abs(encoded.y) };
+        if (normal.z < 0.f) {
+            normal = glm::vec3((1.f - std::abs(encoded.y)) * (encoded.x >= 0.f ? 1.f : -1.f), (1.f - std::abs(encoded.x)) * (encoded.y >= 0.f ? 1.f : -1.f), normal.z);
+        }
+        return glm::normalize(normal);
+    }
+    // Maps a position inside the bounds to [0, 1]^3, the shader restores it with boundsMin + value * (boundsMax - boundsMin)
+    inline glm::vec3 QuantizeToBounds(const glm::vec3& position, const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+        glm::vec3 extent = boundsMax - boundsMin;
+        return glm::vec3(extent.x > 0.f ? (position.x - boundsMin.x) / extent.x : 0.f,
+            extent.y > 0.f ? (position.y - boundsMin.y) / extent.y : 0.f,
+            extent.z > 0.f ? (position.z - boundsMin.z) / extent.z : 0.f);
+    }
+    // The smallest index type that addresses every vertex
+    inline GLenum SelectIndexType(size_t vertexCount) {
+        return vertexCount <= 0x10000 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    }
+    // Indices in the type SelectIndexType picks
+    inline std::vector<char> PackIndices(const uint32_t* indices, size_t indexCount, size_t vertexCount) {
+        bool shortIndices = SelectIndexType(vertexCount) == GL_UNSIGNED_SHORT;
+        std::vector<char> packed(indexCount * (shortIndices ? 2 : 4));
+        for (size_t i = 0; i < indexCount; i++) {
+            if (shortIndices) {
+                uint16_t index = (uint16_t)indices[i];
+                memcpy(packed.data() + i * 2, &index, 2);
+            }
+            else {
+                memcpy(packed.data() + i * 4, &indices[i], 4);
+            }
+        }
+        return packed;
+    }
+}
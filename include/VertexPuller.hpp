@@ -0,0 +1,336 @@
+#pragma once
+
+#include <RangeAllocator.hpp>
+#include <Shader.hpp>
+#include <VertexFormat.hpp>
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// The vertex puller class
+// Draws meshes without vertex attributes: the vertices of every mesh, whatever their format, are stored as raw 32 bit
+// words in one buffer read through a buffer texture, and the vertex shader fetches and decodes them itself. Each
+// index holds the vertex's format id in its top 4 bits and the word address of the vertex below, so gl_VertexID alone
+// locates a vertex: one empty vertex array with the index buffer serves all meshes, and meshes of different formats
+// can be merged into a single draw by concatenating their indices. Instance matrices are read the same way from any
+// buffer (e.g. a StreamBuffer) through a second buffer texture.
+// Shader side: LoadShader inserts the generated decoder after the #version line of the vertex shader, which provides
+//     vec4 PullAttribute(int location)  the attribute at a location of the vertex's format, (0, 0, 0, 1) when missing
+//     mat4 PullInstanceMatrix()         the instance's matrix, starting at the offset given to Bind
+class VertexPuller {
+public:
+    using MeshHandle = uint32_t;
+    static constexpr MeshHandle INVALID_MESH = UINT32_MAX;
+    static constexpr uint32_t MAX_FORMATS = 16;
+    // Bits of an index holding the word address, the rest is the format id
+    static constexpr uint32_t ADDRESS_BITS = 28;
+    static constexpr uint32_t MAX_WORDS = 1u << ADDRESS_BITS;
+    // Where a mesh lives in the buffers, in 32 bit words and indices
+    struct Mesh {
+        uint32_t firstWord;
+        uint32_t wordCount;
+        uint32_t firstIndex;
+        uint32_t indexCount;
+    };
+    ~VertexPuller() {
+        glDeleteVertexArrays(1, &m_Vao);
+        glDeleteBuffers(1, &m_Vbo);
+        glDeleteBuffers(1, &m_Ebo);
+        glDeleteTextures(2, m_Textures);
+    }
+    /// <summary>Creates an empty puller</summary>
+    /// <param name="vertexCapacity">Bytes of vertex data the buffer starts with, it grows when meshes do not fit</param>
+    /// <param name="indexCapacity">Indices the index buffer starts with</param>
+    static VertexPuller Create(uint32_t vertexCapacity, uint32_t indexCapacity) {
+        return VertexPuller(vertexCapacity, indexCapacity);
+    }
+    // Registers a vertex format and returns its id, formats have to be added before the shaders are generated
+    uint32_t AddFormat(const VertexFormat& format) {
+        if (m_Formats.size() == MAX_FORMATS) {
+            fprintf(stderr, "vertex puller supports at most %u formats\n", MAX_FORMATS);
+            return 0;
+        }
+        m_Formats.push_back(format);
+        return (uint32_t)m_Formats.size() - 1;
+    }
+    /// <summary>Uploads a mesh</summary>
+    /// <param name="format">The id AddFormat returned for the vertices' format</param>
+    /// <param name="indices">Indices relative to the mesh's first vertex</param>
+    MeshHandle Add(uint32_t format, const void* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount) {
+        if (format >= m_Formats.size() || vertexCount == 0 || indexCount == 0) {
+            return INVALID_MESH;
+        }
+        // VertexFormat keeps strides 4 byte aligned
+        uint32_t strideWords = m_Formats[format].GetStride() / 4;
+        uint32_t firstWord = Allocate(m_Words, vertexCount * strideWords, m_Vbo, 4);
+        uint32_t firstIndex = Allocate(m_Indices, indexCount, m_Ebo, 4);
+        if (firstWord == RangeAllocator::INVALID_OFFSET || firstIndex == RangeAllocator::INVALID_OFFSET) {
+            m_Words.Free(firstWord, vertexCount * strideWords);
+            m_Indices.Free(firstIndex, indexCount);
+            return INVALID_MESH;
+        }
+        glBindBuffer(GL_COPY_WRITE_BUFFER, m_Vbo);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)firstWord * 4, (GLsizeiptr)vertexCount * strideWords * 4, vertices);
+        std::vector<uint32_t> encoded(indexCount);
+        for (uint32_t i = 0; i < indexCount; i++) {
+            encoded[i] = format << ADDRESS_BITS | (firstWord + indices[i] * strideWords);
+        }
+        glBindBuffer(GL_COPY_WRITE_BUFFER, m_Ebo);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)firstIndex * 4, (GLsizeiptr)indexCount * 4, encoded.data());
+        return Store({ firstWord, vertexCount * strideWords, firstIndex, indexCount });
+    }
+    // A mesh drawing all of the given meshes in one call, it shares their vertices so it has to be removed first
+    MeshHandle Merge(const MeshHandle* meshes, size_t count) {
+        uint32_t indexCount = 0;
+        for (size_t i = 0; i < count; i++) {
+            indexCount += IsLive(meshes[i]) ? m_Meshes[meshes[i]].indexCount : 0;
+        }
+        uint32_t firstIndex = Allocate(m_Indices, indexCount, m_Ebo, 4);
+        if (firstIndex == RangeAllocator::INVALID_OFFSET) {
+            return INVALID_MESH;
+        }
+        // Indices are absolute so merging is a copy
+        glBindBuffer(GL_COPY_READ_BUFFER, m_Ebo);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, m_Ebo);
+        uint32_t indexEnd = firstIndex;
+        for (size_t i = 0; i < count; i++) {
+            if (IsLive(meshes[i])) {
+                const Mesh& mesh = m_Meshes[meshes[i]];
+                glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, (GLintptr)mesh.firstIndex * 4, (GLintptr)indexEnd * 4,
+                    (GLsizeiptr)mesh.indexCount * 4);
+                indexEnd += mesh.indexCount;
+            }
+        }
+        return Store({ 0, 0, firstIndex, indexCount });
+    }
+    // Frees a mesh's space, the handle may be reused by a later Add or Merge
+    void Remove(MeshHandle handle) {
+        if (!IsLive(handle)) {
+            return;
+        }
+        const Mesh& mesh = m_Meshes[handle];
+        m_Words.Free(mesh.firstWord, mesh.wordCount);
+        m_Indices.Free(mesh.firstIndex, mesh.indexCount);
+        m_Live[handle] = false;
+        m_FreeHandles.push_back(handle);
+    }
+    /// <summary>Binds the empty vertex array and the buffer textures and sets the shader's pulling uniforms</summary>
+    /// <param name="firstUnit">The vertex data goes to this texture unit and the instance data to the next</param>
+    /// <param name="instanceBuffer">The buffer the instance matrices are read from</param>
+    /// <param name="instanceOffset">Byte offset of the first instance's matrix in it, a multiple of 16</param>
+    void Bind(const Shader& shader, unsigned int firstUnit, GLuint instanceBuffer, GLintptr instanceOffset) const {
+        glBindVertexArray(m_Vao);
+        glActiveTexture(GL_TEXTURE0 + firstUnit);
+        glBindTexture(GL_TEXTURE_BUFFER, m_Textures[0]);
+        shader.SetInt("uVertexData", firstUnit);
+        glActiveTexture(GL_TEXTURE0 + firstUnit + 1);
+        glBindTexture(GL_TEXTURE_BUFFER, m_Textures[1]);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, instanceBuffer);
+        shader.SetInt("uInstanceData", firstUnit + 1);
+        shader.SetInt("uInstanceOffset", (int)(instanceOffset / 16));
+    }
+    // Draws a mesh, the puller has to be bound
+    void Draw(MeshHandle handle, GLsizei instanceCount = 1) const {
+        const Mesh& mesh = m_Meshes[handle];
+        glDrawElementsInstanced(GL_TRIANGLES, (GLsizei)mesh.indexCount, GL_UNSIGNED_INT,
+            reinterpret_cast<const void*>((uintptr_t)mesh.firstIndex * 4), instanceCount);
+    }
+    // Compiles a program whose vertex shader pulls its vertices, the decoder is inserted after its #version line
+    Shader LoadShader(const char* vertexFile, const char* fragmentFile) const {
+        std::string vertexSource, fragmentSource;
+        extractTextFromFile(vertexFile, vertexSource);
+        extractTextFromFile(fragmentFile, fragmentSource);
+        size_t version = vertexSource.find("#version");
+        size_t insert = version == std::string::npos ? 0 : vertexSource.find('\n', version);
+        insert = insert == std::string::npos ? vertexSource.size() : insert + 1;
+        vertexSource.insert(insert, GenerateSource());
+        return Shader::CreateFromSource(vertexSource.c_str(), fragmentSource.c_str());
+    }
+    // The glsl decoding the registered formats, a vertex's format id picks the decoder
+    std::string GenerateSource() const {
+        std::stringstream ss;
+        ss << "// Generated by VertexPuller: " << m_Formats.size() << " vertex formats\n"
+            "uniform usamplerBuffer uVertexData;\n"
+            "uniform samplerBuffer uInstanceData;\n"
+            "// Texel of the first instance's matrix\n"
+            "uniform int uInstanceOffset;\n"
+            "uint PullWord(int address) {\n"
+            "    return texelFetch(uVertexData, address).r;\n"
+            "}\n"
+            "float PullHalf(uint h) {\n"
+            "    uint signBit = (h & 0x8000u) << 16;\n"
+            "    uint exponent = (h >> 10) & 0x1Fu;\n"
+            "    uint mantissa = h & 0x3FFu;\n"
+            "    if (exponent == 0u) {\n"
+            "        return (signBit != 0u ? -1. : 1.) * float(mantissa) * exp2(-24.);\n"
+            "    }\n"
+            "    return uintBitsToFloat(signBit | (exponent == 31u ? 0x7F800000u : (exponent + 112u) << 23) | mantissa << 13);\n"
+            "}\n"
+            "int PullSigned(uint value, int bits) {\n"
+            "    return int(value << uint(32 - bits)) >> (32 - bits);\n"
+            "}\n";
+        for (size_t format = 0; format < m_Formats.size(); format++) {
+            ss << "vec4 PullFormat" << format << "(int location, int address) {\n";
+            for (const VertexFormat::Attribute& attribute : m_Formats[format].GetAttributes()) {
+                uint32_t size = VertexFormat::GetTypeSize(attribute.type);
+                uint32_t firstWord = attribute.offset / 4, lastWord = (attribute.offset + attribute.components * size - 1) / 4;
+                ss << "    if (location == " << attribute.location << ") {\n";
+                for (uint32_t word = firstWord; word <= lastWord; word++) {
+                    ss << "        uint w" << word - firstWord << " = PullWord(address + " << word << ");\n";
+                }
+                ss << "        return vec4(";
+                for (int component = 0; component < 4; component++) {
+                    if (component < attribute.components) {
+                        uint32_t byte = attribute.offset + component * size;
+                        ss << DecodeComponent(attribute, "w" + std::to_string(byte / 4 - firstWord), byte % 4 * 8);
+                    }
+                    else {
+                        ss << (component == 3 ? "1." : "0.");
+                    }
+                    ss << (component == 3 ? ");\n" : ", ");
+                }
+                ss << "    }\n";
+            }
+            ss << "    return vec4(0., 0., 0., 1.);\n"
+                "}\n";
+        }
+        ss << "vec4 PullAttribute(int location) {\n"
+            "    uint id = uint(gl_VertexID);\n"
+            "    int address = int(id & " << MAX_WORDS - 1 << "u);\n";
+        for (size_t format = 0; format < m_Formats.size(); format++) {
+            ss << "    if (id >> " << ADDRESS_BITS << " == " << format << "u) {\n"
+                "        return PullFormat" << format << "(location, address);\n"
+                "    }\n";
+        }
+        ss << "    return vec4(0., 0., 0., 1.);\n"
+            "}\n"
+            "mat4 PullInstanceMatrix() {\n"
+            "    int texel = uInstanceOffset + gl_InstanceID * 4;\n"
+            "    return mat4(texelFetch(uInstanceData, texel), texelFetch(uInstanceData, texel + 1),\n"
+            "        texelFetch(uInstanceData, texel + 2), texelFetch(uInstanceData, texel + 3));\n"
+            "}\n";
+        return ss.str();
+    }
+    uint32_t GetFormatCount() const {
+        return (uint32_t)m_Formats.size();
+    }
+    const Mesh& GetMesh(MeshHandle handle) const {
+        return m_Meshes[handle];
+    }
+    const RangeAllocator& GetWordAllocator() const {
+        return m_Words;
+    }
+    const RangeAllocator& GetIndexAllocator() const {
+        return m_Indices;
+    }
+private:
+    // Vertex puller constructor
+    VertexPuller(uint32_t vertexCapacity, uint32_t indexCapacity)
+        : m_Words(std::clamp<uint32_t>(vertexCapacity / 4, 1, MAX_WORDS)), m_Indices(std::max<uint32_t>(indexCapacity, 1)) {
+        glGenVertexArrays(1, &m_Vao);
+        glGenBuffers(1, &m_Vbo);
+        glGenBuffers(1, &m_Ebo);
+        glGenTextures(2, m_Textures);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, m_Vbo);
+        glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)m_Words.GetCapacity() * 4, nullptr, GL_STATIC_DRAW);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, m_Ebo);
+        glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)m_Indices.GetCapacity() * 4, nullptr, GL_STATIC_DRAW);
+        AttachBuffers();
+    }
+    // Points the vertex array and the vertex texture at the current buffers
+    void AttachBuffers() {
+        GLint previous;
+        glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &previous);
+        glBindVertexArray(m_Vao);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_Ebo);
+        glBindVertexArray((GLuint)previous);
+        glBindTexture(GL_TEXTURE_BUFFER, m_Textures[0]);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, m_Vbo);
+    }
+    // Allocates from a buffer's allocator, doubling the buffer when the range does not fit. Growing copies the buffer
+    // as it is: indices hold absolute word addresses, so the data cannot move.
+    uint32_t Allocate(RangeAllocator& allocator, uint32_t size, GLuint& buffer, uint32_t elementSize) {
+        uint32_t offset = allocator.Allocate(size);
+        if (offset != RangeAllocator::INVALID_OFFSET || size == 0) {
+            return offset;
+        }
+        uint64_t capacity = std::max<uint64_t>((uint64_t)allocator.GetCapacity() * 2, (uint64_t)allocator.GetCapacity() + size);
+        if (&allocator == &m_Words && capacity > MAX_WORDS) {
+            if ((uint64_t)allocator.GetCapacity() + size > MAX_WORDS) {
+                fprintf(stderr, "vertex puller out of addressable vertex data (%u words)\n", MAX_WORDS);
+                return RangeAllocator::INVALID_OFFSET;
+            }
+            capacity = MAX_WORDS;
+        }
+        GLuint grown;
+        glGenBuffers(1, &grown);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, grown);
+        glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)capacity * elementSize, nullptr, GL_STATIC_DRAW);
+        glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, (GLsizeiptr)allocator.GetCapacity() * elementSize);
+        glDeleteBuffers(1, &buffer);
+        buffer = grown;
+        allocator.Grow((uint32_t)capacity);
+        AttachBuffers();
+        return allocator.Allocate(size);
+    }
+    MeshHandle Store(const Mesh& mesh) {
+        MeshHandle handle;
+        if (!m_FreeHandles.empty()) {
+            handle = m_FreeHandles.back();
+            m_FreeHandles.pop_back();
+        }
+        else {
+            handle = (MeshHandle)m_Meshes.size();
+            m_Meshes.emplace_back();
+            m_Live.push_back(false);
+        }
+        m_Meshes[handle] = mesh;
+        m_Live[handle] = true;
+        return handle;
+    }
+    bool IsLive(MeshHandle handle) const {
+        return handle < m_Meshes.size() && m_Live[handle];
+    }
+    // The glsl reading one component from a fetched word, shift is the component's bit offset in it
+    static std::string DecodeComponent(const VertexFormat::Attribute& attribute, const std::string& word, uint32_t shift) {
+        std::string bits = shift == 0 ? word : "(" + word + " >> " + std::to_string(shift) + "u)";
+        switch (attribute.type) {
+        case GL_FLOAT:
+            return "uintBitsToFloat(" + word + ")";
+        case GL_INT:
+            return "float(int(" + word + "))";
+        case GL_UNSIGNED_INT:
+            return "float(" + word + ")";
+        case GL_HALF_FLOAT:
+            return "PullHalf(" + bits + " & 0xFFFFu)";
+        case GL_UNSIGNED_SHORT:
+            return attribute.normalized ? "(float(" + bits + " & 0xFFFFu) / 65535.)" : "float(" + bits + " & 0xFFFFu)";
+        case GL_SHORT:
+            return attribute.normalized ? "max(float(PullSigned(" + bits + ", 16)) / 32767., -1.)" : "float(PullSigned(" + bits + ", 16))";
+        case GL_UNSIGNED_BYTE:
+            return attribute.normalized ? "(float(" + bits + " & 0xFFu) / 255.)" : "float(" + bits + " & 0xFFu)";
+        case GL_BYTE:
+            return attribute.normalized ? "max(float(PullSigned(" + bits + ", 8)) / 127., -1.)" : "float(PullSigned(" + bits + ", 8))";
+        }
+        return "0.";
+    }
+private:
+    GLuint m_Vao{};
+    GLuint m_Vbo{};
+    GLuint m_Ebo{};
+    // Vertex data and instance data buffer textures
+    GLuint m_Textures[2]{};
+    std::vector<VertexFormat> m_Formats;
+    // Vertex data in 32 bit words and indices
+    RangeAllocator m_Words;
+    RangeAllocator m_Indices;
+    std::vector<Mesh> m_Meshes;
+    std::vector<bool> m_Live;
+    std::vector<MeshHandle> m_FreeHandles;
+};
@@ -1,3 +1,9 @@
+-- The converter links assimp, which is built on its own (see MeshConverter/premake5.lua), so it is left out unless asked for
+newoption {
+    trigger = "with-meshconverter",
+    description = "Adds the MeshConverter project, needs assimp built into vendors/assimp/build",
+}
+
 workspace "Graphics Basics"
 	platforms "x64"
 	configurations { "Debug", "Release" }
@@ -7,9 +13,14 @@ workspace "Graphics Basics"
     IncludeDirs["GLAD"] = "%{wks.location}/vendors/glad/include"
     IncludeDirs["STB"] = "%{wks.location}/vendors/stb"
     IncludeDirs["GLM"] = "%{wks.location}/vendors/glm"
+    IncludeDirs["ASSIMP"] = "%{wks.location}/vendors/assimp/include"
 
 	include "GettingStarted"
     include "Lighting"
+    include "Benchmarks"
+    if _OPTIONS["with-meshconverter"] then
+        include "MeshConverter"
+    end
 
     project "glfw"
         kind "StaticLib"